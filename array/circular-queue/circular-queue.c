@@ -3,33 +3,50 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 
-typedef struct {
-  int* queue; 
-  int size; 
-  int capacity; 
-  int front; 
-  int rear;
-} CircularQueue;
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: The ring buffer itself lives in circular-queue.h, programLoop() is one client of it 
+//  NOTE: Run ./circular-queue --test for the tests and benchmarks (the benchmarks compare against array/queue/queue.h) 
+
+#include "circular-queue.h"
+#include "../queue/queue.h"
 
 void show(CircularQueue* queue); 
 void enqueue(CircularQueue* queue); 
 void dequeue(CircularQueue* queue); 
 void peek(CircularQueue* queue); 
 void showIsEmpty(CircularQueue* queue); 
-void showIsFull(CircularQueue* queue); 
 void front(CircularQueue* queue); 
 void rear(CircularQueue* queue);
 void programLoop(); 
 void printMenu(); 
 void printError(); 
 bool validateUserInput(char* bufferPointer);
-bool getIsFull(CircularQueue* queue); 
 bool getIsEmpty(CircularQueue* queue); 
 int getUserInput(char promptText[]); 
-CircularQueue initializeQueue(int capacity); 
 
-int main() {
+void run_tests(); 
+void run_benchmarks(); 
+
+int main(int argc, char** argv) {
+  if (argc > 1 && strcmp(argv[1], "--test") == 0) {
+    run_tests(); 
+
+    if (RUN_BENCHMARKS) run_benchmarks(); 
+
+    return 0; 
+  }
+
   programLoop();
   return 0; 
 }
@@ -60,7 +77,10 @@ void programLoop() {
     return; 
   }
 
-  CircularQueue queue = initializeQueue(queueCapacity); 
+  // Rounded up to a power of two, and only a starting capacity - the queue grows when it fills up 
+  CircularQueue queue; 
+
+  if(!circular_queue_initialize(&queue, (size_t) queueCapacity)) return; 
 
   while(true) {
     printMenu(); 
@@ -73,7 +93,7 @@ void programLoop() {
         show(&queue);
         break; 
       case 2 : 
-        printf("The current size of your queue is %d\n\n", queue.size);
+        printf("The current size of your queue is %zu\n\n", circular_queue_size(&queue));
         break;
       case 3 : 
         enqueue(&queue);
@@ -82,7 +102,7 @@ void programLoop() {
         dequeue(&queue);
         break; 
       case 5 : 
-        printf("The capacity of yoru queue is %d\n\n", queue.capacity);
+        printf("The capacity of yoru queue is %zu\n\n", queue.capacity);
         break; 
       case 6 : 
         front(&queue);
@@ -93,6 +113,7 @@ void programLoop() {
       case 0 : 
         printf("Ending the program...\n"); 
         printf("Goodbye!\n\n"); 
+        circular_queue_free(&queue); 
         exit(0);
         break;
       default : 
@@ -102,7 +123,7 @@ void programLoop() {
 
   }
 
-  free(queue.queue); 
+  circular_queue_free(&queue); 
 
 }
 
@@ -160,17 +181,6 @@ bool validateUserInput(char *bufferPointer) {
   return true; 
 }
 
-CircularQueue initializeQueue(int capacity) {
-  CircularQueue queue; 
-  queue.size = 0; 
-  queue.capacity = capacity; 
-  queue.front = 0; 
-  queue.rear = -1; 
-  queue.queue = (int*) malloc(capacity * sizeof(int)); 
-
-  return queue; 
-}
-
 void show(CircularQueue* queue) {
   bool isEmpty = getIsEmpty(queue); 
 
@@ -179,33 +189,23 @@ void show(CircularQueue* queue) {
     return; 
   }
 
-  if(queue->size == 1) {
-    printf("[%d]\n\n", queue->queue[queue->front]); 
+  size_t size = circular_queue_size(queue); 
+
+  if(size == 1) {
+    printf("[%d]\n\n", queue->queue[queue->head & queue->mask]); 
     return; 
   }
 
-
-  int currentIdx = queue->front; 
-  int i; 
+  size_t i; 
   printf("["); 
-  for(i = 0; i < queue->size - 1; i++) {
-    printf("%d, ", queue->queue[currentIdx]);
-    currentIdx = (currentIdx + 1) % queue->capacity; 
+  for(i = 0; i < size - 1; i++) {
+    printf("%d, ", queue->queue[(queue->head + i) & queue->mask]);
   }
 
-  printf("%d]\n\n", queue->queue[queue->rear]);
+  printf("%d]\n\n", queue->queue[(queue->tail - 1) & queue->mask]);
 }
 
 void enqueue(CircularQueue* queue) {
-  bool isFull = getIsFull(queue); 
-
-  if(isFull) {
-    printf("Cannot enqueue any more items as your queue is full\n\n"); 
-    return; 
-  }
-  
-  queue->rear = queue->rear == (queue->capacity - 1) ? 0 : queue->rear + 1; 
-
   char textPrompt[] = "Please enter the number you would like to add to the queue: "; 
   int numToAdd = getUserInput(textPrompt);
 
@@ -214,13 +214,15 @@ void enqueue(CircularQueue* queue) {
     return;
   }
 
-  queue->queue[queue->rear] = numToAdd; 
-  queue->size += 1; 
+  if(!circular_queue_enqueue(queue, numToAdd)) {
+    printf("Cannot enqueue any more items as your queue could not grow\n\n"); 
+    return; 
+  }
 
   printf("%d added to the queue\n", numToAdd); 
-  printf("Your queue now consists of %d items\n", queue->size); 
-  printf("The actual front of your queue is at index: %d\n", queue->front); 
-  printf("The actual rear of your queue is at index: %d\n\n", queue->rear);
+  printf("Your queue now consists of %zu items\n", circular_queue_size(queue)); 
+  printf("The actual front of your queue is at index: %zu\n", queue->head & queue->mask); 
+  printf("The actual rear of your queue is at index: %zu\n\n", (queue->tail - 1) & queue->mask);
 }
 
 void dequeue(CircularQueue* queue) {
@@ -232,22 +234,18 @@ void dequeue(CircularQueue* queue) {
     return; 
   }
 
-  int prevFront = queue->queue[queue->front];
+  int prevFront; 
+  circular_queue_dequeue(queue, &prevFront); 
   printf("The item removed is %d\n", prevFront);
-  queue->size -= 1; 
   
-  if(queue->size == 0) {
-    queue->front = 0; 
-    queue->rear = -1;
-
+  if(getIsEmpty(queue)) {
     printf("Your queue is now empty\n\n");
     return;
   }
 
-  queue->front = queue->front == (queue->capacity - 1) ? 0 : queue->front + 1; 
-  printf("Your new queue size is now %d\n", queue->size);
-  printf("The actual front of your queue is at index: %d\n", queue->front); 
-  printf("The actual rear of your queue is at index: %d\n\n", queue->rear);
+  printf("Your new queue size is now %zu\n", circular_queue_size(queue));
+  printf("The actual front of your queue is at index: %zu\n", queue->head & queue->mask); 
+  printf("The actual rear of your queue is at index: %zu\n\n", (queue->tail - 1) & queue->mask);
 }
 
 void isEmpty(CircularQueue* queue) {
@@ -258,18 +256,7 @@ void isEmpty(CircularQueue* queue) {
     return; 
   }
 
-  printf("Your queue is not empty, there are %d items in your queue\n\n", queue->size); 
-}
-
-void isFull(CircularQueue* queue) {
-  bool queueIsFull = getIsFull(queue);  
-
-  if(queueIsFull) {
-    printf("Your queue is at capacity\n\n"); 
-    return; 
-  }
-
-  printf("Your queue is not full...\n\n");
+  printf("Your queue is not empty, there are %zu items in your queue\n\n", circular_queue_size(queue)); 
 }
 
 void front(CircularQueue* queue) {
@@ -280,9 +267,9 @@ void front(CircularQueue* queue) {
     return; 
   }
 
-  int front = queue->queue[queue->front];
+  int front = queue->queue[queue->head & queue->mask];
   printf("The front item of this queue is %d\n", front);
-  printf("The front index of the queue is %d\n\n", queue->front); 
+  printf("The front index of the queue is %zu\n\n", queue->head & queue->mask); 
 }
 
 void rear(CircularQueue* queue) {
@@ -293,15 +280,234 @@ void rear(CircularQueue* queue) {
     return; 
   }
 
-  int rear = queue->queue[queue->rear];
+  int rear = queue->queue[(queue->tail - 1) & queue->mask];
   printf("The rear item of this queue is %d\n", rear);
-  printf("The rear index of the queue is %d\n\n", queue->rear); 
+  printf("The rear index of the queue is %zu\n\n", (queue->tail - 1) & queue->mask); 
 }
 
 bool getIsEmpty(CircularQueue* queue) {
-  return queue->size == 0; 
+  return circular_queue_is_empty(queue); 
+}
+
+/**
+ * ===================================
+ * ||             Tests             ||
+ * ===================================
+ */
+
+void test_wrap_and_grow() {
+  printf("==================\n");
+  printf("|| Wrap + Grow  ||\n"); 
+  printf("==================\n\n");
+
+  CircularQueue queue; 
+  if (!circular_queue_initialize(&queue, 5)) return; 
+
+  bool matched = true; 
+  int next_in = 0; 
+  int next_out = 0; 
+  int front; 
+
+  printf("Capacity 5 rounds up to: %zu\n", queue.capacity); 
+
+  // Move the head part way round so the items wrap, then fill past the capacity to grow a wrapped ring 
+  for (int i = 0; i < 6; i++) circular_queue_enqueue(&queue, next_in++); 
+  for (int i = 0; i < 5; i++) {
+    if (!circular_queue_dequeue(&queue, &front) || front != next_out++) matched = false; 
+  }
+
+  for (int i = 0; i < 20; i++) circular_queue_enqueue(&queue, next_in++); 
+
+  printf("Capacity after growing a wrapped ring: %zu\n", queue.capacity); 
+
+  while (!circular_queue_is_empty(&queue)) {
+    circular_queue_dequeue(&queue, &front); 
+    if (front != next_out++) matched = false; 
+  }
+
+  printf("Items came out in FIFO order: %s\n", matched ? "true" : "false"); 
+  printf("Dequeue from empty fails: %s\n\n", circular_queue_dequeue(&queue, NULL) ? "false" : "true"); 
+
+  circular_queue_free(&queue); 
+}
+
+void test_enqueue_n_dequeue_n() {
+  printf("==================\n");
+  printf("|| Enqueue N    ||\n"); 
+  printf("==================\n\n");
+
+  CircularQueue queue; 
+  if (!circular_queue_initialize(&queue, 64)) return; 
+
+  int data[100]; 
+  int out[100]; 
+  bool matched = true; 
+
+  for (int i = 0; i < 100; i++) data[i] = i * 7; 
+
+  // Every block starts at a different offset so some wrap and some don't 
+  for (int round = 0; round < 1000; round++) {
+    size_t n = (size_t) (round % 50) + 1; 
+
+    circular_queue_enqueue_n(&queue, data, n); 
+    size_t dequeued = circular_queue_dequeue_n(&queue, out, n); 
+
+    for (size_t i = 0; i < dequeued; i++) {
+      if (out[i] != data[i]) matched = false; 
+    }
+
+    if (dequeued != n) matched = false; 
+  }
+
+  printf("Blocks wrapping the end came back intact: %s\n", matched ? "true" : "false"); 
+
+  circular_queue_enqueue_n(&queue, data, 100); 
+  printf("100 items into a queue of 64 grew it to: %zu\n", queue.capacity); 
+  printf("Asked for 200, got %zu\n\n", circular_queue_dequeue_n(&queue, out, 200)); 
+
+  circular_queue_free(&queue); 
+}
+
+void test_counter_overflow() {
+  printf("==================\n");
+  printf("|| Overflow     ||\n"); 
+  printf("==================\n\n");
+
+  CircularQueue queue; 
+  if (!circular_queue_initialize(&queue, 8)) return; 
+
+  bool matched = true; 
+  int front; 
+
+  // Start the counters just short of wrapping round to 0 
+  queue.head = queue.tail = SIZE_MAX - 3; 
+
+  for (int i = 0; i < 20; i++) circular_queue_enqueue(&queue, i); 
+  for (int i = 0; i < 20; i++) {
+    if (!circular_queue_dequeue(&queue, &front) || front != i) matched = false; 
+  }
+
+  printf("FIFO order across the counters wrapping: %s\n\n", matched ? "true" : "false"); 
+
+  circular_queue_free(&queue); 
+}
+
+void test_reserve_shrink() {
+  printf("==================\n");
+  printf("|| Reserve      ||\n"); 
+  printf("==================\n\n");
+
+  CircularQueue queue; 
+  if (!circular_queue_initialize(&queue, 0)) return; 
+
+  circular_queue_reserve(&queue, 1000); 
+  size_t reserved = queue.capacity; 
+
+  for (int i = 0; i < 1000; i++) circular_queue_enqueue(&queue, i); 
+
+  printf("Capacity after reserve(1000): %zu, after 1000 enqueues: %zu\n", reserved, queue.capacity); 
+
+  // Dequeuing doesn't give back memory that was reserved 
+  circular_queue_dequeue_n(&queue, NULL, 990); 
+  circular_queue_dequeue(&queue, NULL); 
+  printf("Capacity at %zu items: %zu\n", circular_queue_size(&queue), queue.capacity); 
+
+  circular_queue_shrink_to_fit(&queue); 
+  printf("Capacity after shrink_to_fit: %zu\n", queue.capacity); 
+
+  // Without a reservation dequeuing to a quarter full halves the ring 
+  circular_queue_free(&queue); 
+  if (!circular_queue_initialize(&queue, 0)) return; 
+
+  for (int i = 0; i < 1000; i++) circular_queue_enqueue(&queue, i); 
+  printf("Capacity at %zu items: %zu\n", circular_queue_size(&queue), queue.capacity); 
+
+  circular_queue_dequeue_n(&queue, NULL, 744); 
+  int front = 0; 
+  circular_queue_peek(&queue, &front); 
+  printf("Capacity at %zu items: %zu (front is %d)\n\n", circular_queue_size(&queue), queue.capacity, front); 
+
+  circular_queue_free(&queue); 
+}
+
+void run_tests() {
+  test_wrap_and_grow(); 
+
+  test_enqueue_n_dequeue_n(); 
+
+  test_counter_overflow(); 
+
+  test_reserve_shrink(); 
+
+}
+
+/**
+ * ===================================
+ * ||           Benchmarks          ||
+ * ===================================
+ */
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9; 
+}
+
+// A queue holding 1000 items with BENCHMARK_SIZE going through, then fill and drain in blocks of 4096 - the ring against the Queue 
+
+void bench_ring() {
+  printf("==================\n");
+  printf("|| Ring         ||\n"); 
+  printf("==================\n\n");
+
+  int* data = (int*) malloc(sizeof(int) * 4096); 
+  CircularQueue ring; 
+  Queue queue; 
+  struct timespec start, end; 
+  long long checksum = 0; 
+  int front = 0; 
+
+  if (data == NULL || !circular_queue_initialize(&ring, 0) || !queue_initialize(&queue, 0)) return; 
+
+  for (int i = 0; i < 4096; i++) data[i] = i; 
+  for (int i = 0; i < 1000; i++) {
+    circular_queue_enqueue(&ring, i); 
+    queue_enqueue(&queue, i); 
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  for (int i = 0; i < BENCHMARK_SIZE; i++) {
+    circular_queue_enqueue(&ring, i); 
+    circular_queue_dequeue(&ring, &front); 
+    checksum += front; 
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double ring_time = elapsed_seconds(start, end); 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  for (int i = 0; i < BENCHMARK_SIZE; i++) {
+    queue_enqueue(&queue, i); 
+    queue_dequeue(&queue, &front); 
+    checksum -= front; 
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double queue_time = elapsed_seconds(start, end); 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  for (int round = 0; round < BENCHMARK_SIZE / 4096; round++) {
+    circular_queue_enqueue_n(&ring, data, 4096); 
+    circular_queue_dequeue_n(&ring, data, 4096); 
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+
+  printf("Steady state, CircularQueue:  %.2f Mops/s\n", 2.0 * BENCHMARK_SIZE / ring_time / 1e6); 
+  printf("Steady state, Queue:          %.2f Mops/s\n", 2.0 * BENCHMARK_SIZE / queue_time / 1e6); 
+  printf("enqueue_n + dequeue_n (4096): %.2f Mops/s\n", 2.0 * (BENCHMARK_SIZE / 4096) * 4096 / elapsed_seconds(start, end) / 1e6); 
+  printf("(checksum %lld)\n\n", checksum); 
+
+  circular_queue_free(&ring); 
+  queue_free(&queue); 
+  free(data); 
 }
 
-bool getIsFull(CircularQueue* queue) {
-  return queue->size == queue->capacity;  
+void run_benchmarks() {
+  bench_ring(); 
 }
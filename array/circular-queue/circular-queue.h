@@ -0,0 +1,290 @@
+/**
+ * *------------------------------------------*
+ * * Growable Ring Buffer (circular-queue.h)  *
+ * *------------------------------------------*
+ *
+ * The circular queue from circular-queue.c as a library. The capacity is always a power of two so wrapping an index is
+ * a mask (idx & (capacity - 1)) rather than a compare and branch, and head/tail are free running counters:
+ *
+ * - head -> How many items have ever been dequeued
+ * - tail -> How many items have ever been enqueued
+ * - size is just tail - head, and the slot for a counter is counter & mask
+ *
+ * Because head and tail never wrap themselves there is no "is rear behind front" case to handle and a full queue
+ * (tail - head == capacity) can't be mistaken for an empty one (tail == head). Unsigned overflow of the counters is fine
+ * as the subtraction wraps the same way.
+ *
+ * - circular_queue_initialize(queue, capacity) / circular_queue_free(queue)
+ * - circular_queue_enqueue(queue, data) / circular_queue_dequeue(queue, &out) / circular_queue_peek(queue, &out)
+ * - circular_queue_enqueue_n(queue, data, n) / circular_queue_dequeue_n(queue, out, n) -> at most two memcpys each
+ * - circular_queue_reserve(queue, n) / circular_queue_shrink_to_fit(queue)
+ *
+ * A full queue grows to the next power of two rather than turning items away. The items may wrap past the end of the
+ * old array, so growing copies the part from head to the end and then the wrapped part from the start - two memcpys
+ * and the items are in order from slot 0 of the new array.
+ *
+ * Dequeuing never shrinks below what circular_queue_initialize(...)/circular_queue_reserve(...) asked for (rounded up
+ * to a power of two), only circular_queue_shrink_to_fit(...) does.
+ */
+
+#ifndef CIRCULAR_QUEUE_H
+#define CIRCULAR_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef CIRCULAR_QUEUE_MIN_CAPACITY
+#define CIRCULAR_QUEUE_MIN_CAPACITY 8
+#endif
+
+#ifndef CIRCULAR_QUEUE_SHRINK_THRESHOLD
+#define CIRCULAR_QUEUE_SHRINK_THRESHOLD 4
+#endif
+
+#ifndef DEBUG_PRINT
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+typedef struct {
+  int* queue;
+  size_t head;
+  size_t tail;
+  size_t capacity;
+  size_t mask;
+  size_t reserved;
+} CircularQueue;
+
+// The smallest power of two >= n (and >= CIRCULAR_QUEUE_MIN_CAPACITY), 0 if there isn't one
+
+static inline size_t circular_queue_round_up(size_t n) {
+  size_t capacity = CIRCULAR_QUEUE_MIN_CAPACITY;
+
+  while (capacity < n) {
+    if (capacity > SIZE_MAX / 2) return 0;
+    capacity *= 2;
+  }
+
+  return capacity;
+}
+
+static inline size_t circular_queue_size(CircularQueue* queue) {
+  return queue->tail - queue->head;
+}
+
+static inline bool circular_queue_is_empty(CircularQueue* queue) {
+  return queue->tail == queue->head;
+}
+
+/**
+ * Copies `n` items starting at counter `from` out of the ring into `out` - the run up to the end of the array, then the
+ * wrapped run from slot 0
+ */
+
+static inline void circular_queue_copy_out(CircularQueue* queue, size_t from, int* out, size_t n) {
+  size_t start = from & queue->mask;
+  size_t first = queue->capacity - start < n ? queue->capacity - start : n;
+
+  memcpy(out, queue->queue + start, first * sizeof(int));
+  if (n > first) memcpy(out + first, queue->queue, (n - first) * sizeof(int));
+}
+
+static inline void circular_queue_copy_in(CircularQueue* queue, size_t to, const int* data, size_t n) {
+  size_t start = to & queue->mask;
+  size_t first = queue->capacity - start < n ? queue->capacity - start : n;
+
+  memcpy(queue->queue + start, data, first * sizeof(int));
+  if (n > first) memcpy(queue->queue, data + first, (n - first) * sizeof(int));
+}
+
+// Move the items into a new array of `capacity` (rounded up to a power of two, never below the current size)
+
+static inline bool circular_queue_resize(CircularQueue* queue, size_t capacity) {
+  size_t size = circular_queue_size(queue);
+
+  capacity = circular_queue_round_up(capacity < size ? size : capacity);
+  if (capacity == 0) return false;
+  if (capacity == queue->capacity) return true;
+
+  int* resized = (int*) malloc(capacity * sizeof(int));
+
+  if (resized == NULL) {
+    DEBUG_PRINT("Error reallocating the queue to %zu slots\n", capacity);
+    return false;
+  }
+
+  if (size > 0) circular_queue_copy_out(queue, queue->head, resized, size);
+  free(queue->queue);
+
+  queue->queue = resized;
+  queue->head = 0;
+  queue->tail = size;
+  queue->capacity = capacity;
+  queue->mask = capacity - 1;
+
+  return true;
+}
+
+/**
+ * @param: queue -> The queue to set up
+ * @param: capacity -> How many items to make room for up front (rounded up to a power of two)
+ */
+
+static inline bool circular_queue_initialize(CircularQueue* queue, size_t capacity) {
+  queue->queue = NULL;
+  queue->head = 0;
+  queue->tail = 0;
+  queue->capacity = 0;
+  queue->mask = 0;
+  queue->reserved = 0;
+
+  if (!circular_queue_resize(queue, capacity)) {
+    DEBUG_PRINT("Error Allocating memory for the queue\n\n", NULL);
+    return false;
+  }
+
+  queue->reserved = queue->capacity;
+  return true;
+}
+
+static inline void circular_queue_free(CircularQueue* queue) {
+  free(queue->queue);
+  queue->queue = NULL;
+  queue->head = 0;
+  queue->tail = 0;
+  queue->capacity = 0;
+  queue->mask = 0;
+  queue->reserved = 0;
+}
+
+/**
+ * Grows the queue to hold at least `capacity` items - call it before a big load so it only reallocates once. Dequeuing
+ * won't shrink it back below `capacity` until circular_queue_shrink_to_fit(...)
+ *
+ * @param: queue -> The queue to grow
+ * @param: capacity -> The number of items it should be able to hold
+ */
+
+static inline bool circular_queue_reserve(CircularQueue* queue, size_t capacity) {
+  if (capacity > queue->capacity && !circular_queue_resize(queue, capacity)) return false;
+
+  size_t rounded = circular_queue_round_up(capacity);
+  if (rounded > queue->reserved) queue->reserved = rounded;
+
+  return true;
+}
+
+// Gives back every unused slot and drops any reservation
+
+static inline bool circular_queue_shrink_to_fit(CircularQueue* queue) {
+  queue->reserved = 0;
+  return circular_queue_resize(queue, circular_queue_size(queue));
+}
+
+// Room for `extra` more items - doubles until they fit
+
+static inline bool circular_queue_make_room(CircularQueue* queue, size_t extra) {
+  size_t size = circular_queue_size(queue);
+
+  if (extra > SIZE_MAX - size) return false;
+  if (size + extra <= queue->capacity) return true;
+
+  return circular_queue_resize(queue, size + extra);
+}
+
+/**
+ * Halve the capacity once the queue drops to a quarter full, but never below the reservation (both are powers of two so
+ * half of a bigger capacity is still >= it). A failed shrink is fine - the queue is just bigger than it needs to be
+ */
+
+static inline void circular_queue_maybe_shrink(CircularQueue* queue) {
+  if (queue->capacity <= CIRCULAR_QUEUE_MIN_CAPACITY || queue->capacity <= queue->reserved) return;
+  if (circular_queue_size(queue) > queue->capacity / CIRCULAR_QUEUE_SHRINK_THRESHOLD) return;
+
+  circular_queue_resize(queue, queue->capacity / 2);
+}
+
+static inline bool circular_queue_enqueue(CircularQueue* queue, int data) {
+  if (queue->tail - queue->head == queue->capacity && !circular_queue_make_room(queue, 1)) {
+    DEBUG_PRINT("Error: Cannot enqueue as the queue could not grow\n\n", NULL);
+    return false;
+  }
+
+  queue->queue[queue->tail++ & queue->mask] = data;
+  return true;
+}
+
+/**
+ * @param: queue -> The queue to take the front item from
+ * @param: out -> Where to put the item (can be NULL to just drop it)
+ */
+
+static inline bool circular_queue_dequeue(CircularQueue* queue, int* out) {
+  if (queue->tail == queue->head) {
+    DEBUG_PRINT("Error: Cannot dequeue from an empty queue\n\n", NULL);
+    return false;
+  }
+
+  int front = queue->queue[queue->head++ & queue->mask];
+  if (out != NULL) *out = front;
+
+  circular_queue_maybe_shrink(queue);
+
+  return true;
+}
+
+static inline bool circular_queue_peek(CircularQueue* queue, int* out) {
+  if (queue->tail == queue->head) return false;
+
+  *out = queue->queue[queue->head & queue->mask];
+  return true;
+}
+
+/**
+ * Enqueues data[0] ... data[n - 1] (data[0] comes out first) with at most one growth and two memcpys
+ *
+ * @param: queue -> The queue to add to
+ * @param: data -> The items to enqueue
+ * @param: n -> How many items
+ */
+
+static inline bool circular_queue_enqueue_n(CircularQueue* queue, const int* data, size_t n) {
+  if (n == 0) return true;
+
+  if (!circular_queue_make_room(queue, n)) {
+    DEBUG_PRINT("Error: Cannot enqueue %zu items as the queue could not grow\n\n", n);
+    return false;
+  }
+
+  circular_queue_copy_in(queue, queue->tail, data, n);
+  queue->tail += n;
+
+  return true;
+}
+
+/**
+ * Dequeues up to n items from the front with at most two memcpys, in the order they were enqueued
+ *
+ * @param: queue -> The queue to take from
+ * @param: out -> Room for at least n items (can be NULL to just drop them)
+ * @param: n -> How many items to dequeue
+ *
+ * Returns how many items were dequeued (less than n if the queue ran out)
+ */
+
+static inline size_t circular_queue_dequeue_n(CircularQueue* queue, int* out, size_t n) {
+  size_t size = circular_queue_size(queue);
+
+  if (n > size) n = size;
+  if (n == 0) return 0;
+
+  if (out != NULL) circular_queue_copy_out(queue, queue->head, out, n);
+  queue->head += n;
+
+  circular_queue_maybe_shrink(queue);
+
+  return n;
+}
+
+#endif
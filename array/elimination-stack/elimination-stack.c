@@ -0,0 +1,468 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: The stack underneath is the Treiber stack from array/treiber-stack, this file adds the elimination array in front of it
+//  NOTE: Build with gcc -O2 -pthread elimination-stack.c
+
+#include "../treiber-stack/treiber-stack.h"
+
+#define MAX_THREADS 64
+
+// The most slots a thread will spread over, each one on its own cache line
+
+#define ELIMINATION_SLOTS 16
+
+// How many times a waiting thread checks its slot for a partner before giving up and going back to the stack
+
+#define ELIMINATION_SPINS 128
+
+/**
+ * A slot is one 64 bit word so every change to it is a single CAS:
+ *
+ * - bits 0 - 31 -> The value being handed over
+ * - bits 32 - 33 -> The state: EMPTY, WAITING (one thread is parked here) or BUSY (a partner arrived)
+ * - bit 34 -> The parked thread's operation (push or pop), so only opposite operations pair up
+ */
+
+#define SLOT_EMPTY 0
+#define SLOT_WAITING 1
+#define SLOT_BUSY 2
+
+#define OP_PUSH 0
+#define OP_POP 1
+
+#define SLOT_WORD(state, op, value) (((uint64_t) (op) << 34) | ((uint64_t) (state) << 32) | (uint32_t) (value))
+#define SLOT_STATE(word) ((int) (((word) >> 32) & 3))
+#define SLOT_OP(word) ((int) (((word) >> 34) & 1))
+#define SLOT_VALUE(word) ((int) (uint32_t) (word))
+
+typedef struct {
+  _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t word;
+} EliminationSlot;
+
+typedef struct {
+  TreiberStack stack;
+  EliminationSlot slots[ELIMINATION_SLOTS];
+} EliminationStack;
+
+/**
+ * A thread's handle - its Treiber handle plus how wide it currently spreads over the elimination array.
+ *
+ * - range -> Slots [0, range) are tried. It grows when a thread keeps finding partners (or collides with other threads)
+ *            and shrinks when it times out waiting, so the array sizes itself to how much contention there is
+ * - eliminated -> How many of this thread's operations never touched the stack
+ */
+
+typedef struct {
+  TreiberThread* thread;
+  size_t range;
+  uint32_t seed;
+  size_t eliminated;
+} EliminationThread;
+
+/**
+ * ===================================
+ * ||       Elimination Stack       ||
+ * ===================================
+ */
+
+bool elimination_stack_initialize(EliminationStack* stack) {
+  for (size_t i = 0; i < ELIMINATION_SLOTS; i++) atomic_init(&stack->slots[i].word, SLOT_WORD(SLOT_EMPTY, 0, 0));
+
+  return treiber_stack_initialize(&stack->stack);
+}
+
+void elimination_stack_free(EliminationStack* stack) {
+  treiber_stack_free(&stack->stack);
+}
+
+/**
+ * @param: stack -> The stack the thread is going to use
+ * @param: handle -> Filled in with the thread's handle
+ * @param: seed -> Seed for picking slots - anything different per thread
+ */
+
+bool elimination_stack_register(EliminationStack* stack, EliminationThread* handle, uint32_t seed) {
+  handle->thread = treiber_stack_register(&stack->stack);
+  handle->range = 1;
+  handle->seed = seed | 1;
+  handle->eliminated = 0;
+
+  return handle->thread != NULL;
+}
+
+static inline uint32_t elimination_random(EliminationThread* handle) {
+  handle->seed ^= handle->seed << 13;
+  handle->seed ^= handle->seed >> 17;
+  handle->seed ^= handle->seed << 5;
+
+  return handle->seed;
+}
+
+static inline void elimination_grow(EliminationThread* handle) {
+  if (handle->range < ELIMINATION_SLOTS) handle->range++;
+}
+
+static inline void elimination_shrink(EliminationThread* handle) {
+  if (handle->range > 1) handle->range--;
+}
+
+/**
+ * Tries to meet a thread doing the opposite operation in a random slot and swap values with it
+ *
+ * @param: stack -> The stack whose elimination array to use
+ * @param: handle -> The calling thread's handle
+ * @param: op -> OP_PUSH or OP_POP
+ * @param: value -> The value to push in, the popped value out (only for OP_POP)
+ *
+ * Returns true if a partner was found, in which case the operation is finished
+ */
+
+bool elimination_exchange(EliminationStack* stack, EliminationThread* handle, int op, int* value) {
+  EliminationSlot* slot = &stack->slots[elimination_random(handle) % handle->range];
+  uint64_t word = atomic_load(&slot->word);
+
+  // Someone is parked here waiting for the opposite operation - take their place in one CAS
+  if (SLOT_STATE(word) == SLOT_WAITING && SLOT_OP(word) != op) {
+    if (atomic_compare_exchange_strong(&slot->word, &word, SLOT_WORD(SLOT_BUSY, op, *value))) {
+      if (op == OP_POP) *value = SLOT_VALUE(word);
+      elimination_grow(handle);
+      return true;
+    }
+
+    elimination_grow(handle);
+    return false;
+  }
+
+  // Busy, or parked by the same operation - spread out
+  if (SLOT_STATE(word) != SLOT_EMPTY) {
+    elimination_grow(handle);
+    return false;
+  }
+
+  uint64_t waiting = SLOT_WORD(SLOT_WAITING, op, *value);
+
+  if (!atomic_compare_exchange_strong(&slot->word, &word, waiting)) {
+    elimination_grow(handle);
+    return false;
+  }
+
+  for (int i = 0; i < ELIMINATION_SPINS; i++) {
+    word = atomic_load(&slot->word);
+    if (SLOT_STATE(word) == SLOT_BUSY) break;
+
+    // On a machine with fewer cores than threads a partner can only turn up if we give up the core
+    if (i % 32 == 31) sched_yield();
+  }
+
+  // Nobody came - withdraw. If the CAS fails a partner arrived at the last moment and the swap happened
+  if (SLOT_STATE(word) != SLOT_BUSY && atomic_compare_exchange_strong(&slot->word, &waiting, SLOT_WORD(SLOT_EMPTY, 0, 0))) {
+    elimination_shrink(handle);
+    return false;
+  }
+
+  word = atomic_load(&slot->word);
+  if (op == OP_POP) *value = SLOT_VALUE(word);
+
+  // Only the parked thread empties a BUSY slot, so no one can reuse it until the value is read
+  atomic_store(&slot->word, SLOT_WORD(SLOT_EMPTY, 0, 0));
+  elimination_grow(handle);
+
+  return true;
+}
+
+/**
+ * @param: stack -> The stack to push onto
+ * @param: handle -> The calling thread's handle from elimination_stack_register(...)
+ * @param: data -> The item to push
+ */
+
+bool elimination_stack_push(EliminationStack* stack, EliminationThread* handle, int data) {
+  while (true) {
+    TreiberResult result = treiber_stack_try_push(&stack->stack, handle->thread, data);
+    if (result != TREIBER_CONTENDED) return result == TREIBER_OK;
+
+    // Lost the CAS on the head - back off into the elimination array rather than straight back at the head
+    if (elimination_exchange(stack, handle, OP_PUSH, &data)) {
+      handle->eliminated++;
+      return true;
+    }
+  }
+}
+
+/**
+ * @param: stack -> The stack to pop from
+ * @param: handle -> The calling thread's handle from elimination_stack_register(...)
+ * @param: out -> Where to put the popped item
+ *
+ * Returns false if the stack was empty
+ */
+
+bool elimination_stack_pop(EliminationStack* stack, EliminationThread* handle, int* out) {
+  while (true) {
+    TreiberResult result = treiber_stack_try_pop(&stack->stack, handle->thread, out);
+    if (result != TREIBER_CONTENDED) return result == TREIBER_OK;
+
+    if (elimination_exchange(stack, handle, OP_POP, out)) {
+      handle->eliminated++;
+      return true;
+    }
+  }
+}
+
+/**
+ * ===================================
+ * ||             Tests             ||
+ * ===================================
+ */
+
+void test_push_pop() {
+  printf("==================\n");
+  printf("|| Push and Pop ||\n");
+  printf("==================\n\n");
+
+  EliminationStack stack;
+  EliminationThread handle;
+  bool matched = true;
+  int popped;
+
+  if (!elimination_stack_initialize(&stack) || !elimination_stack_register(&stack, &handle, 1)) return;
+
+  for (int i = 0; i < 10000; i++) elimination_stack_push(&stack, &handle, i);
+
+  for (int i = 9999; i >= 0; i--) {
+    if (!elimination_stack_pop(&stack, &handle, &popped) || popped != i) matched = false;
+  }
+
+  printf("Popped in LIFO order: %s\n", matched ? "true" : "false");
+  printf("Pop from empty fails: %s\n\n", elimination_stack_pop(&stack, &handle, &popped) ? "false" : "true");
+
+  elimination_stack_free(&stack);
+}
+
+// Park a push in a slot by hand, then check a pop that loses its CAS picks the value up without touching the stack
+
+void test_exchange() {
+  printf("==================\n");
+  printf("|| Exchange     ||\n");
+  printf("==================\n\n");
+
+  EliminationStack stack;
+  EliminationThread handle;
+  int value = 0;
+
+  if (!elimination_stack_initialize(&stack) || !elimination_stack_register(&stack, &handle, 1)) return;
+
+  atomic_store(&stack.slots[0].word, SLOT_WORD(SLOT_WAITING, OP_PUSH, 42));
+
+  bool exchanged = elimination_exchange(&stack, &handle, OP_POP, &value);
+  uint64_t word = atomic_load(&stack.slots[0].word);
+
+  printf("Pop met the parked push: %s (got %d)\n", exchanged ? "true" : "false", value);
+  printf("Slot marked BUSY for the parked push to see: %s\n", SLOT_STATE(word) == SLOT_BUSY ? "true" : "false");
+
+  // A parked pop doesn't pair with another pop
+  atomic_store(&stack.slots[0].word, SLOT_WORD(SLOT_WAITING, OP_POP, 0));
+  handle.range = 1;
+  printf("Pop does not pair with a parked pop: %s\n\n", elimination_exchange(&stack, &handle, OP_POP, &value) ? "false" : "true");
+
+  elimination_stack_free(&stack);
+}
+
+typedef struct {
+  EliminationStack* stack;
+  int id;
+  int count;
+  _Atomic int* seen;
+  size_t eliminated;
+} TestContext;
+
+void* test_worker(void* arg) {
+  TestContext* context = (TestContext*) arg;
+  EliminationThread handle;
+  int popped;
+
+  if (!elimination_stack_register(context->stack, &handle, (uint32_t) context->id + 1)) return NULL;
+
+  for (int i = 0; i < context->count; i++) {
+    elimination_stack_push(context->stack, &handle, context->id * context->count + i);
+
+    if (i % 2 == 0 && elimination_stack_pop(context->stack, &handle, &popped)) atomic_fetch_add(&context->seen[popped], 1);
+  }
+
+  while (elimination_stack_pop(context->stack, &handle, &popped)) atomic_fetch_add(&context->seen[popped], 1);
+
+  context->eliminated = handle.eliminated;
+
+  return NULL;
+}
+
+void test_concurrent() {
+  printf("==================\n");
+  printf("|| Concurrent   ||\n");
+  printf("==================\n\n");
+
+  int thread_count = 8;
+  int count = 50000;
+  EliminationStack stack;
+  pthread_t threads[8];
+  TestContext contexts[8];
+  _Atomic int* seen = (_Atomic int*) calloc((size_t) thread_count * count, sizeof(_Atomic int));
+  size_t eliminated = 0;
+
+  if (seen == NULL || !elimination_stack_initialize(&stack)) return;
+
+  for (int i = 0; i < thread_count; i++) {
+    contexts[i] = (TestContext) { &stack, i, count, seen, 0 };
+    pthread_create(&threads[i], NULL, test_worker, &contexts[i]);
+  }
+
+  for (int i = 0; i < thread_count; i++) {
+    pthread_join(threads[i], NULL);
+    eliminated += contexts[i].eliminated;
+  }
+
+  bool exactly_once = true;
+  for (int i = 0; i < thread_count * count; i++) {
+    if (atomic_load(&seen[i]) != 1) exactly_once = false;
+  }
+
+  printf("%d threads pushed %d values each (%zu operations eliminated)\n", thread_count, count, eliminated);
+  printf("Every value popped exactly once: %s\n", exactly_once ? "true" : "false");
+  printf("Stack empty at the end: %s\n\n", treiber_stack_is_empty(&stack.stack) ? "true" : "false");
+
+  free(seen);
+  elimination_stack_free(&stack);
+}
+
+void run_tests() {
+  test_push_pop();
+
+  test_exchange();
+
+  test_concurrent();
+
+}
+
+/**
+ * ===================================
+ * ||           Benchmarks          ||
+ * ===================================
+ */
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+typedef struct {
+  EliminationStack* stack;
+  _Atomic bool* go;
+  int ops;
+  int id;
+  bool eliminate;
+  size_t eliminated;
+} BenchContext;
+
+// Symmetric load - every thread does push/pop pairs, the case where pushes and pops are most likely to meet
+
+void* bench_worker(void* arg) {
+  BenchContext* context = (BenchContext*) arg;
+  EliminationThread handle;
+  int popped;
+
+  if (!elimination_stack_register(context->stack, &handle, (uint32_t) context->id * 2654435761u + 1)) return NULL;
+
+  while (!atomic_load(context->go)) sched_yield();
+
+  for (int i = 0; i < context->ops; i++) {
+    if (context->eliminate) {
+      elimination_stack_push(context->stack, &handle, i);
+      elimination_stack_pop(context->stack, &handle, &popped);
+    } else {
+      treiber_stack_push(&context->stack->stack, handle.thread, i);
+      treiber_stack_pop(&context->stack->stack, handle.thread, &popped);
+    }
+  }
+
+  context->eliminated = handle.eliminated;
+
+  return NULL;
+}
+
+double bench_run(int thread_count, bool eliminate, size_t* eliminated) {
+  EliminationStack stack;
+  pthread_t threads[MAX_THREADS];
+  BenchContext contexts[MAX_THREADS];
+  _Atomic bool go = false;
+  struct timespec start, end;
+
+  if (!elimination_stack_initialize(&stack)) return 0;
+
+  for (int i = 0; i < thread_count; i++) {
+    contexts[i] = (BenchContext) { &stack, &go, BENCHMARK_SIZE / thread_count, i, eliminate, 0 };
+    pthread_create(&threads[i], NULL, bench_worker, &contexts[i]);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  atomic_store(&go, true);
+
+  *eliminated = 0;
+  for (int i = 0; i < thread_count; i++) {
+    pthread_join(threads[i], NULL);
+    *eliminated += contexts[i].eliminated;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  elimination_stack_free(&stack);
+
+  return 2.0 * (BENCHMARK_SIZE / thread_count) * thread_count / elapsed_seconds(start, end) / 1e6;
+}
+
+// BENCHMARK_SIZE push/pop pairs over 1 to MAX_THREADS threads, on the bare Treiber stack and with elimination in front
+
+void bench_scaling() {
+  printf("==================\n");
+  printf("|| Scaling      ||\n");
+  printf("==================\n\n");
+
+  printf("Threads   Treiber (Mops/s)   Elimination (Mops/s)   Eliminated\n");
+
+  for (int thread_count = 1; thread_count <= MAX_THREADS; thread_count *= 2) {
+    size_t eliminated;
+    double treiber = bench_run(thread_count, false, &eliminated);
+    double elimination = bench_run(thread_count, true, &eliminated);
+
+    printf("%-9d %-18.2f %-22.2f %.2f%%\n", thread_count, treiber, elimination, 100.0 * eliminated / (2.0 * BENCHMARK_SIZE));
+  }
+
+  printf("\n");
+}
+
+void run_benchmarks() {
+  bench_scaling();
+}
+
+int main() {
+  run_tests();
+
+  if (RUN_BENCHMARKS) run_benchmarks();
+
+  return 0;
+}
@@ -0,0 +1,314 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: The queue itself is in mpmc-queue.h, this file tests it and benchmarks it against a mutex around the CircularQueue
+//  NOTE: Build with gcc -O2 -pthread mpmc-queue.c
+
+#include "mpmc-queue.h"
+#include "../circular-queue/circular-queue.h"
+
+#define QUEUE_CAPACITY 1024
+#define BATCH_SIZE 32
+#define MAX_THREADS 64
+
+/**
+ * ===================================
+ * ||             Tests             ||
+ * ===================================
+ */
+
+void test_full_empty() {
+  printf("==================\n");
+  printf("|| Full + Empty ||\n");
+  printf("==================\n\n");
+
+  MpmcQueue queue;
+  if (!mpmc_queue_initialize(&queue, 10)) return;
+
+  int out;
+  int enqueued = 0;
+  bool matched = true;
+
+  while (mpmc_queue_try_enqueue(&queue, enqueued)) enqueued++;
+
+  printf("Capacity 10 rounds up to %zu, enqueued %d before full\n", queue.capacity, enqueued);
+
+  for (int i = 0; i < enqueued; i++) {
+    if (!mpmc_queue_try_dequeue(&queue, &out) || out != i) matched = false;
+  }
+
+  printf("Dequeued in FIFO order: %s\n", matched ? "true" : "false");
+  printf("Dequeue from empty fails: %s\n", mpmc_queue_try_dequeue(&queue, &out) ? "false" : "true");
+
+  // Batches wrap round the end and stop at full/ empty
+  int data[20];
+  int block[20];
+  for (int i = 0; i < 20; i++) data[i] = i;
+
+  mpmc_queue_try_enqueue_n(&queue, data, 5);
+  mpmc_queue_try_dequeue_n(&queue, block, 5);
+
+  size_t in = mpmc_queue_try_enqueue_n(&queue, data, 20);
+  size_t out_count = mpmc_queue_try_dequeue_n(&queue, block, 20);
+
+  matched = in == out_count;
+  for (size_t i = 0; i < out_count; i++) {
+    if (block[i] != data[i]) matched = false;
+  }
+
+  printf("Batch of 20 into 16 slots took %zu, came back intact: %s\n\n", in, matched ? "true" : "false");
+
+  mpmc_queue_free(&queue);
+}
+
+typedef struct {
+  MpmcQueue* queue;
+  int id;
+  int count;
+  bool batch;
+  _Atomic int* seen;
+} TestContext;
+
+void* test_producer(void* arg) {
+  TestContext* context = (TestContext*) arg;
+  int block[BATCH_SIZE];
+  int spins = 0;
+
+  for (int i = 0; i < context->count;) {
+    if (!context->batch) {
+      mpmc_queue_enqueue(context->queue, context->id * context->count + i++);
+      continue;
+    }
+
+    int n = context->count - i < BATCH_SIZE ? context->count - i : BATCH_SIZE;
+    for (int j = 0; j < n; j++) block[j] = context->id * context->count + i + j;
+
+    size_t sent = mpmc_queue_try_enqueue_n(context->queue, block, (size_t) n);
+    i += (int) sent;
+    if (sent == 0) mpmc_queue_backoff(&spins);
+  }
+
+  return NULL;
+}
+
+void* test_consumer(void* arg) {
+  TestContext* context = (TestContext*) arg;
+  int block[BATCH_SIZE];
+  int spins = 0;
+
+  for (int i = 0; i < context->count;) {
+    if (!context->batch) {
+      atomic_fetch_add(&context->seen[mpmc_queue_dequeue(context->queue)], 1);
+      i++;
+      continue;
+    }
+
+    size_t received = mpmc_queue_try_dequeue_n(context->queue, block, (size_t) (context->count - i < BATCH_SIZE ? context->count - i : BATCH_SIZE));
+    for (size_t j = 0; j < received; j++) atomic_fetch_add(&context->seen[block[j]], 1);
+
+    i += (int) received;
+    if (received == 0) mpmc_queue_backoff(&spins);
+  }
+
+  return NULL;
+}
+
+// 4 producers and 4 consumers, every value should come out exactly once
+
+bool run_exactly_once(bool batch) {
+  int pairs = 4;
+  int count = 100000;
+  MpmcQueue queue;
+  pthread_t threads[8];
+  TestContext contexts[8];
+  _Atomic int* seen = (_Atomic int*) calloc((size_t) pairs * count, sizeof(_Atomic int));
+  bool exactly_once = true;
+
+  if (seen == NULL || !mpmc_queue_initialize(&queue, 64)) return false;
+
+  for (int i = 0; i < pairs; i++) {
+    contexts[i] = (TestContext) { &queue, i, count, batch, seen };
+    contexts[pairs + i] = (TestContext) { &queue, i, count, batch, seen };
+    pthread_create(&threads[i], NULL, test_producer, &contexts[i]);
+    pthread_create(&threads[pairs + i], NULL, test_consumer, &contexts[pairs + i]);
+  }
+
+  for (int i = 0; i < 2 * pairs; i++) pthread_join(threads[i], NULL);
+
+  for (int i = 0; i < pairs * count; i++) {
+    if (atomic_load(&seen[i]) != 1) exactly_once = false;
+  }
+
+  free(seen);
+  mpmc_queue_free(&queue);
+
+  return exactly_once;
+}
+
+void test_concurrent() {
+  printf("==================\n");
+  printf("|| Concurrent   ||\n");
+  printf("==================\n\n");
+
+  printf("4 producers, 4 consumers, every value exactly once: %s\n", run_exactly_once(false) ? "true" : "false");
+  printf("Same again in batches of %d: %s\n\n", BATCH_SIZE, run_exactly_once(true) ? "true" : "false");
+}
+
+void run_tests() {
+  test_full_empty();
+
+  test_concurrent();
+
+}
+
+/**
+ * ===================================
+ * ||           Benchmarks          ||
+ * ===================================
+ */
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// The CircularQueue with a mutex around it, capped at QUEUE_CAPACITY so it's bounded like the MPMC queue
+
+typedef struct {
+  pthread_mutex_t lock;
+  CircularQueue queue;
+} MutexQueue;
+
+bool mutex_queue_try_enqueue(MutexQueue* queue, int data) {
+  pthread_mutex_lock(&queue->lock);
+  bool room = circular_queue_size(&queue->queue) < QUEUE_CAPACITY && circular_queue_enqueue(&queue->queue, data);
+  pthread_mutex_unlock(&queue->lock);
+
+  return room;
+}
+
+bool mutex_queue_try_dequeue(MutexQueue* queue, int* out) {
+  pthread_mutex_lock(&queue->lock);
+  bool got = !circular_queue_is_empty(&queue->queue) && circular_queue_dequeue(&queue->queue, out);
+  pthread_mutex_unlock(&queue->lock);
+
+  return got;
+}
+
+typedef struct {
+  MpmcQueue* mpmc;
+  MutexQueue* mutex;
+  int count;
+  bool producer;
+} BenchContext;
+
+void* bench_mpmc_worker(void* arg) {
+  BenchContext* context = (BenchContext*) arg;
+  int spins = 0;
+  int out;
+
+  for (int i = 0; i < context->count;) {
+    bool done = context->producer ? mpmc_queue_try_enqueue(context->mpmc, i) : mpmc_queue_try_dequeue(context->mpmc, &out);
+
+    if (done) {
+      i++;
+    } else {
+      mpmc_queue_backoff(&spins);
+    }
+  }
+
+  return NULL;
+}
+
+void* bench_mutex_worker(void* arg) {
+  BenchContext* context = (BenchContext*) arg;
+  int spins = 0;
+  int out;
+
+  for (int i = 0; i < context->count;) {
+    bool done = context->producer ? mutex_queue_try_enqueue(context->mutex, i) : mutex_queue_try_dequeue(context->mutex, &out);
+
+    if (done) {
+      i++;
+    } else {
+      mpmc_queue_backoff(&spins);
+    }
+  }
+
+  return NULL;
+}
+
+// Half the threads produce and half consume, BENCHMARK_SIZE items in total. Returns millions of items a second
+
+double bench_run(void* (*worker)(void*), MpmcQueue* mpmc, MutexQueue* mutex, int thread_count) {
+  pthread_t threads[MAX_THREADS];
+  BenchContext contexts[MAX_THREADS];
+  int pairs = thread_count / 2;
+  struct timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < thread_count; i++) {
+    contexts[i] = (BenchContext) { mpmc, mutex, BENCHMARK_SIZE / pairs, i < pairs };
+    pthread_create(&threads[i], NULL, worker, &contexts[i]);
+  }
+  for (int i = 0; i < thread_count; i++) pthread_join(threads[i], NULL);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  return (double) (BENCHMARK_SIZE / pairs) * pairs / elapsed_seconds(start, end) / 1e6;
+}
+
+void bench_scaling() {
+  printf("==================\n");
+  printf("|| Scaling      ||\n");
+  printf("==================\n\n");
+
+  printf("Threads   MPMC (M items/s)   Mutex (M items/s)\n");
+
+  for (int thread_count = 2; thread_count <= MAX_THREADS; thread_count *= 2) {
+    MpmcQueue mpmc;
+    MutexQueue mutex;
+
+    if (!mpmc_queue_initialize(&mpmc, QUEUE_CAPACITY)) return;
+    if (!circular_queue_initialize(&mutex.queue, QUEUE_CAPACITY)) return;
+    pthread_mutex_init(&mutex.lock, NULL);
+
+    double mpmc_rate = bench_run(bench_mpmc_worker, &mpmc, &mutex, thread_count);
+    double mutex_rate = bench_run(bench_mutex_worker, &mpmc, &mutex, thread_count);
+
+    printf("%-9d %-18.2f %.2f\n", thread_count, mpmc_rate, mutex_rate);
+
+    mpmc_queue_free(&mpmc);
+    circular_queue_free(&mutex.queue);
+    pthread_mutex_destroy(&mutex.lock);
+  }
+
+  printf("\n");
+}
+
+void run_benchmarks() {
+  bench_scaling();
+}
+
+int main() {
+  run_tests();
+
+  if (RUN_BENCHMARKS) run_benchmarks();
+
+  return 0;
+}
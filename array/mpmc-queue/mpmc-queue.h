@@ -0,0 +1,280 @@
+/**
+ * *-------------------------------------------*
+ * * Bounded MPMC Queue (mpmc-queue.h)         *
+ * *-------------------------------------------*
+ *
+ * A fixed size ring for any number of producer and consumer threads (Dmitry Vyukov's bounded MPMC queue).
+ * It's the circular queue's power of two ring and free running counters again, but every slot also carries a sequence
+ * number which says whose turn it is to use the slot:
+ *
+ * - sequence == pos         -> The slot is free for the producer claiming position pos
+ * - sequence == pos + 1     -> The slot holds the item for the consumer claiming position pos
+ * - After the consumer is done it sets sequence = pos + capacity, which is the producer's pos one lap later
+ *
+ * A producer reads enqueue_pos, checks the slot's sequence, and claims the position with one CAS on enqueue_pos.
+ * Consumers do the same on dequeue_pos. Producers and consumers never CAS the same counter, and once a thread owns
+ * a position nobody else touches that slot until it publishes the new sequence, so the item itself needs no atomics.
+ *
+ * - mpmc_queue_try_enqueue(...)/mpmc_queue_try_dequeue(...) -> false straight away if the queue is full/ empty
+ * - mpmc_queue_enqueue(...)/mpmc_queue_dequeue(...) -> wait (spin then yield) until there is room/ an item
+ * - mpmc_queue_try_enqueue_n(...)/mpmc_queue_try_dequeue_n(...) -> claim a run of consecutive positions with one CAS
+ *
+ * Compile with -pthread (sched_yield).
+ */
+
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef MPMC_QUEUE_MIN_CAPACITY
+#define MPMC_QUEUE_MIN_CAPACITY 2
+#endif
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+// How many times the waiting enqueue/ dequeue retry before giving the core up
+#ifndef MPMC_QUEUE_SPINS
+#define MPMC_QUEUE_SPINS 64
+#endif
+
+#ifndef DEBUG_PRINT
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+typedef struct {
+  _Atomic size_t sequence;
+  int data;
+} MpmcSlot;
+
+typedef struct {
+  _Alignas(CACHE_LINE_SIZE) MpmcSlot* slots;
+  size_t capacity;
+  size_t mask;
+
+  _Alignas(CACHE_LINE_SIZE) _Atomic size_t enqueue_pos;
+  _Alignas(CACHE_LINE_SIZE) _Atomic size_t dequeue_pos;
+} MpmcQueue;
+
+/**
+ * @param: queue -> The queue to set up (before any thread uses it)
+ * @param: capacity -> How many items it holds, rounded up to a power of two
+ */
+
+static inline bool mpmc_queue_initialize(MpmcQueue* queue, size_t capacity) {
+  size_t rounded = MPMC_QUEUE_MIN_CAPACITY;
+
+  while (rounded < capacity) {
+    if (rounded > SIZE_MAX / 2 / sizeof(MpmcSlot)) return false;
+    rounded *= 2;
+  }
+
+  queue->slots = (MpmcSlot*) malloc(rounded * sizeof(MpmcSlot));
+
+  if (queue->slots == NULL) {
+    DEBUG_PRINT("Error Allocating memory for the queue\n\n", NULL);
+    return false;
+  }
+
+  for (size_t i = 0; i < rounded; i++) atomic_init(&queue->slots[i].sequence, i);
+
+  queue->capacity = rounded;
+  queue->mask = rounded - 1;
+  atomic_init(&queue->enqueue_pos, 0);
+  atomic_init(&queue->dequeue_pos, 0);
+
+  return true;
+}
+
+static inline void mpmc_queue_free(MpmcQueue* queue) {
+  free(queue->slots);
+  queue->slots = NULL;
+  queue->capacity = 0;
+  queue->mask = 0;
+}
+
+/**
+ * Returns false if the queue is full. Only retries while other producers are winning the CAS, never waits for room
+ *
+ * @param: queue -> The queue to add to
+ * @param: data -> The item to enqueue
+ */
+
+static inline bool mpmc_queue_try_enqueue(MpmcQueue* queue, int data) {
+  size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+  MpmcSlot* slot;
+
+  while (true) {
+    slot = &queue->slots[pos & queue->mask];
+    size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      // The slot still holds the item from a lap ago - full
+      return false;
+    } else {
+      // Another producer has claimed pos already
+      pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    }
+  }
+
+  slot->data = data;
+  atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+
+  return true;
+}
+
+/**
+ * Returns false if the queue is empty
+ *
+ * @param: queue -> The queue to take from
+ * @param: out -> Where to put the item
+ */
+
+static inline bool mpmc_queue_try_dequeue(MpmcQueue* queue, int* out) {
+  size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+  MpmcSlot* slot;
+
+  while (true) {
+    slot = &queue->slots[pos & queue->mask];
+    size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    intptr_t diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      // Nothing has been published at pos yet - empty
+      return false;
+    } else {
+      pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    }
+  }
+
+  *out = slot->data;
+  atomic_store_explicit(&slot->sequence, pos + queue->capacity, memory_order_release);
+
+  return true;
+}
+
+static inline void mpmc_queue_backoff(int* spins) {
+  if (++*spins < MPMC_QUEUE_SPINS) return;
+
+  *spins = 0;
+  sched_yield();
+}
+
+// Waits until there is room
+
+static inline void mpmc_queue_enqueue(MpmcQueue* queue, int data) {
+  int spins = 0;
+
+  while (!mpmc_queue_try_enqueue(queue, data)) mpmc_queue_backoff(&spins);
+}
+
+// Waits until there is an item
+
+static inline int mpmc_queue_dequeue(MpmcQueue* queue) {
+  int spins = 0;
+  int out;
+
+  while (!mpmc_queue_try_dequeue(queue, &out)) mpmc_queue_backoff(&spins);
+
+  return out;
+}
+
+/**
+ * Enqueues as many of data[0] ... data[n - 1] as there are free slots in a row, claiming them all with one CAS.
+ * Only producers fill a free slot and they have to win enqueue_pos first, so slots seen free before the CAS are
+ * still free after it
+ *
+ * @param: queue -> The queue to add to
+ * @param: data -> The items to enqueue
+ * @param: n -> How many items
+ *
+ * Returns how many items were enqueued (0 if the queue is full)
+ */
+
+static inline size_t mpmc_queue_try_enqueue_n(MpmcQueue* queue, const int* data, size_t n) {
+  size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+  size_t count;
+
+  while (true) {
+    for (count = 0; count < n; count++) {
+      size_t sequence = atomic_load_explicit(&queue->slots[(pos + count) & queue->mask].sequence, memory_order_acquire);
+      if (sequence != pos + count) break;
+    }
+
+    if (count == 0) {
+      // Either full, or another producer got pos first and we have a stale pos
+      size_t current = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+      if (current == pos) return 0;
+
+      pos = current;
+      continue;
+    }
+
+    if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + count,
+                                              memory_order_relaxed, memory_order_relaxed)) break;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    MpmcSlot* slot = &queue->slots[(pos + i) & queue->mask];
+    slot->data = data[i];
+    atomic_store_explicit(&slot->sequence, pos + i + 1, memory_order_release);
+  }
+
+  return count;
+}
+
+/**
+ * Dequeues up to n items that are ready in a row, claiming them all with one CAS
+ *
+ * @param: queue -> The queue to take from
+ * @param: out -> Room for at least n items
+ * @param: n -> How many items to dequeue
+ *
+ * Returns how many items were dequeued (0 if the queue is empty)
+ */
+
+static inline size_t mpmc_queue_try_dequeue_n(MpmcQueue* queue, int* out, size_t n) {
+  size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+  size_t count;
+
+  while (true) {
+    for (count = 0; count < n; count++) {
+      size_t sequence = atomic_load_explicit(&queue->slots[(pos + count) & queue->mask].sequence, memory_order_acquire);
+      if (sequence != pos + count + 1) break;
+    }
+
+    if (count == 0) {
+      size_t current = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+      if (current == pos) return 0;
+
+      pos = current;
+      continue;
+    }
+
+    if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + count,
+                                              memory_order_relaxed, memory_order_relaxed)) break;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    MpmcSlot* slot = &queue->slots[(pos + i) & queue->mask];
+    out[i] = slot->data;
+    atomic_store_explicit(&slot->sequence, pos + i + queue->capacity, memory_order_release);
+  }
+
+  return count;
+}
+
+#endif
@@ -3,28 +3,46 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 #include <unistd.h>
 
-typedef struct {
-  int* queue; 
-  int size;
-  int capacity; 
-} Queue;
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: The queue itself lives in queue.h - queue_enqueue(...), queue_dequeue(...) etc. never touch stdin/stdout 
+//  NOTE: programLoop() is just one client of it. Run ./queue --test for the tests and benchmarks 
+
+#include "queue.h"
 
 void show(Queue* queue); 
 void enqueue(Queue* queue); 
 void dequeue(Queue* queue); 
 void peek(Queue* queue); 
-void isFull(Queue* queue); 
 void isEmpty(Queue* queue); 
 void programLoop(); 
 void printMenu(); 
-Queue initializeQueue(int capacity); 
 int validateUserInput(char text[]); 
 bool getIsEmpty(Queue* queue); 
-bool getIsFull(Queue* queue); 
 
-int main() {
+void run_tests(); 
+void run_benchmarks(); 
+
+int main(int argc, char** argv) {
+  if (argc > 1 && strcmp(argv[1], "--test") == 0) {
+    run_tests(); 
+
+    if (RUN_BENCHMARKS) run_benchmarks(); 
+
+    return 0; 
+  }
+
   programLoop(); 
   return 0; 
 }
@@ -54,7 +72,10 @@ void programLoop() {
     return; 
   }
 
-  Queue queue = initializeQueue(capacity);
+  // The size is only a starting capacity now, the queue grows past it 
+  Queue queue; 
+
+  if (!queue_initialize(&queue, (size_t) capacity)) return; 
 
   while(true) {
     printMenu();  
@@ -67,7 +88,7 @@ void programLoop() {
         show(&queue);  
         break; 
       case 2 : 
-        printf("Current queue length is: %d items\n\n", queue.size); 
+        printf("Current queue length is: %zu items\n\n", queue.size); 
         break; 
       case 3 : 
         enqueue(&queue); 
@@ -76,9 +97,10 @@ void programLoop() {
         dequeue(&queue);
         break; 
       case 5 : 
-        printf("Your queue capacity is: %d items\n\n", queue.capacity);
+        printf("Your queue capacity is: %zu items\n\n", queue.capacity);
         break; 
       case 0 : 
+        queue_free(&queue); 
         exit(0); 
         break;
       default: 
@@ -87,7 +109,7 @@ void programLoop() {
     }
   }
 
-  free(queue.queue); 
+  queue_free(&queue); 
 }
 
 void show(Queue* queue) {
@@ -97,28 +119,25 @@ void show(Queue* queue) {
     return; 
   }
 
+  int* front = queue->queue + queue->head; 
+
   if(queue->size == 1) {
-    printf("[%d]\n\n", queue->queue[0]); 
+    printf("[%d]\n\n", front[0]); 
     return; 
   }
 
-  int i;
+  size_t i;
   printf("["); 
 
   for(i = 0; i < queue->size - 1; i++) {
-    printf("%d, ", queue->queue[i]);  
+    printf("%d, ", front[i]);  
   }
 
-  printf("%d]\n\n", queue->queue[queue->size - 1]); 
+  printf("%d]\n\n", front[queue->size - 1]); 
   
 }
 
 void enqueue(Queue* queue) {
-  if(getIsFull(queue)) {
-    printf("You cannot enqueue any more items as the queue is full. Dickhead!\n\n");  
-    return; 
-  }
-
   char textPrompt[] = "Enter the number you would like to add to the queue"; 
   int numToAdd = validateUserInput(textPrompt); 
 
@@ -127,9 +146,10 @@ void enqueue(Queue* queue) {
     return;
   }
 
-  int size = queue->size; 
-  queue->queue[size] = numToAdd; 
-  queue->size += 1;
+  if(!queue_enqueue(queue, numToAdd)) {
+    printf("You cannot enqueue any more items as the queue could not grow\n\n");  
+    return; 
+  }
 
   printf("Item added at the back of the queue, loser. Item: %d\n\n", numToAdd); 
 }
@@ -141,18 +161,11 @@ void dequeue(Queue* queue) {
     return; 
   }
 
-  int i; 
-  int frontItem = queue->queue[0]; 
+  int frontItem; 
+  queue_dequeue(queue, &frontItem); 
 
   printf("Dequeuing the item at the front of the queue: %d\n\n", frontItem); 
-
-  for(i = 0; i < queue->size; i++) {
-    queue->queue[i] = queue->queue[i + 1]; 
-  }
-
-  queue-> size -= 1;
-
-  printf("Item sucessully dequeued, your current queue size is %d\n\n", queue->size); 
+  printf("Item sucessully dequeued, your current queue size is %zu\n\n", queue->size); 
 }
 
 void peek(Queue* queue) {
@@ -163,25 +176,14 @@ void peek(Queue* queue) {
      return; 
    }
 
-   printf("The front of your queue is: %d\n\n", queue->queue[0]); 
-}
-
-void isFull(Queue* queue) {
-  bool queueIsFull = getIsFull(queue);  
-
-  if(!queueIsFull) {
-    printf("Your queue is not full. There are %d items in your queue!\n\n", queue->size); 
-    return;  
-  }
-
-  printf("Your queue is completley full, stop trying to put more items in dickhead\n\n"); 
+   printf("The front of your queue is: %d\n\n", queue->queue[queue->head]); 
 }
 
 void isEmpty(Queue* queue) {
   bool queueIsEmpty = getIsEmpty(queue);  
 
   if(!queueIsEmpty) {
-    printf("Your queue is not empty, there are %d items in your queue!\n\n", queue->size); 
+    printf("Your queue is not empty, there are %zu items in your queue!\n\n", queue->size); 
     return; 
   }
 
@@ -189,26 +191,13 @@ void isEmpty(Queue* queue) {
 }
 
 bool getIsEmpty(Queue* queue) {
-  return queue->size <= 0; 
-}
-
-bool getIsFull(Queue* queue) {
-  return queue->size == queue->capacity; 
+  return queue->size == 0; 
 }
 
 void printError() {
   printf("Too many incorrect entries - We are expecting an integer\n\n");  
 }
 
-Queue initializeQueue(int capacity) {
-  Queue queue; 
-  queue.size = 0; 
-  queue.capacity = capacity; 
-  queue.queue = (int*) malloc(capacity * sizeof(int)); 
-  
-  return queue; 
-}
-
 bool stringIsValid(char* p) {
     bool isValid = false; 
     while(*p) {
@@ -255,3 +244,211 @@ int validateUserInput(char text[]) {
   return userInput; 
 }
 
+/**
+ * ===================================
+ * ||             Tests             ||
+ * ===================================
+ */
+
+void test_enqueue_dequeue() {
+  printf("==================\n");
+  printf("|| FIFO         ||\n"); 
+  printf("==================\n\n");
+
+  Queue queue; 
+  if (!queue_initialize(&queue, 0)) return; 
+
+  bool matched = true; 
+  int next_out = 0; 
+  int next_in = 0; 
+  int front; 
+
+  // Keep the queue between 100 and 200 items while 100000 go through, so it compacts rather than grows 
+  for (int round = 0; round < 1000; round++) {
+    while (queue.size < 200) queue_enqueue(&queue, next_in++); 
+
+    for (int i = 0; i < 100; i++) {
+      if (!queue_dequeue(&queue, &front) || front != next_out++) matched = false; 
+    }
+  }
+
+  printf("%d items through in FIFO order: %s\n", next_in, matched ? "true" : "false"); 
+  printf("Capacity stayed at: %zu\n", queue.capacity); 
+
+  while (queue.size > 0) {
+    queue_dequeue(&queue, &front); 
+    if (front != next_out++) matched = false; 
+  }
+
+  printf("Drained in order: %s\n\n", matched ? "true" : "false"); 
+
+  queue_free(&queue); 
+}
+
+void test_enqueue_n_dequeue_n() {
+  printf("==================\n");
+  printf("|| Enqueue N    ||\n"); 
+  printf("==================\n\n");
+
+  Queue queue; 
+  if (!queue_initialize(&queue, 0)) return; 
+
+  int data[5000]; 
+  int out[5000]; 
+  bool matched = true; 
+
+  for (int i = 0; i < 5000; i++) data[i] = i * 7; 
+
+  queue_enqueue(&queue, -1); 
+  queue_enqueue_n(&queue, data, 5000); 
+  queue_dequeue(&queue, NULL); 
+
+  size_t dequeued = queue_dequeue_n(&queue, out, 3000); 
+  dequeued += queue_dequeue_n(&queue, out + 3000, 5000); 
+
+  for (size_t i = 0; i < dequeued; i++) {
+    if (out[i] != data[i]) matched = false; 
+  }
+
+  printf("Dequeued %zu items, same as enqueued: %s\n", dequeued, matched ? "true" : "false"); 
+  printf("Dequeue from empty fails: %s\n", queue_dequeue(&queue, NULL) ? "false" : "true"); 
+
+  // A freed queue has no capacity left to grow from 
+  queue_free(&queue); 
+  printf("Enqueue after free: %s\n\n", queue_enqueue(&queue, 1) && queue.size == 1 ? "true" : "false"); 
+
+  queue_free(&queue); 
+}
+
+void test_reserve_shrink() {
+  printf("==================\n");
+  printf("|| Reserve      ||\n"); 
+  printf("==================\n\n");
+
+  Queue queue; 
+  if (!queue_initialize(&queue, 0)) return; 
+
+  queue_reserve(&queue, 1000); 
+  size_t reserved = queue.capacity; 
+
+  for (int i = 0; i < 1000; i++) queue_enqueue(&queue, i); 
+
+  printf("Capacity after reserve(1000): %zu, after 1000 enqueues: %zu\n", reserved, queue.capacity); 
+
+  // Dequeuing doesn't give back memory that was reserved 
+  queue_dequeue_n(&queue, NULL, 990); 
+  printf("Capacity at %zu items: %zu\n", queue.size, queue.capacity); 
+
+  queue_shrink_to_fit(&queue); 
+  printf("Capacity after shrink_to_fit: %zu\n", queue.capacity); 
+
+  // Without a reservation dequeuing to just under half doesn't shrink, a quarter does 
+  queue_free(&queue); 
+  if (!queue_initialize(&queue, 0)) return; 
+
+  for (int i = 0; i < 1000; i++) queue_enqueue(&queue, i); 
+  printf("Capacity at %zu items: %zu\n", queue.size, queue.capacity); 
+
+  queue_dequeue_n(&queue, NULL, 501); 
+  printf("Capacity at %zu items: %zu\n", queue.size, queue.capacity); 
+
+  queue_dequeue_n(&queue, NULL, 250); 
+  printf("Capacity at %zu items: %zu (front is %d)\n\n", queue.size, queue.capacity, queue.queue[queue.head]); 
+
+  queue_free(&queue); 
+}
+
+void run_tests() {
+  test_enqueue_dequeue(); 
+
+  test_enqueue_n_dequeue_n(); 
+
+  test_reserve_shrink(); 
+
+}
+
+/**
+ * ===================================
+ * ||           Benchmarks          ||
+ * ===================================
+ */
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9; 
+}
+
+// The old dequeue - shift everything down one slot 
+
+void shifting_dequeue(Queue* queue) {
+  for (size_t i = 0; i + 1 < queue->size; i++) queue->queue[i] = queue->queue[i + 1]; 
+  queue->size--; 
+}
+
+// Fill then drain, one at a time and in blocks of 4096, plus a steady queue of 1000 items with BENCHMARK_SIZE going through 
+
+void bench_queue() {
+  printf("==================\n");
+  printf("|| Queue        ||\n"); 
+  printf("==================\n\n");
+
+  int* data = (int*) malloc(sizeof(int) * BENCHMARK_SIZE); 
+  Queue queue; 
+  struct timespec start, end; 
+  long long checksum = 0; 
+  int front = 0; 
+
+  if (data == NULL || !queue_initialize(&queue, 0)) return; 
+
+  for (int i = 0; i < BENCHMARK_SIZE; i++) data[i] = i; 
+
+  // Only 20000 for the old dequeue - it's O(n) per item 
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  for (int i = 0; i < 20000; i++) queue_enqueue(&queue, i); 
+  while (queue.size > 0) shifting_dequeue(&queue); 
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double shifting_time = elapsed_seconds(start, end); 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  for (int i = 0; i < BENCHMARK_SIZE; i++) queue_enqueue(&queue, data[i]); 
+  while (queue.size > 0) {
+    queue_dequeue(&queue, &front); 
+    checksum += front; 
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double single_time = elapsed_seconds(start, end); 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  for (size_t i = 0; i < BENCHMARK_SIZE; i += 4096) {
+    size_t n = BENCHMARK_SIZE - i < 4096 ? BENCHMARK_SIZE - i : 4096; 
+    queue_enqueue_n(&queue, data + i, n); 
+  }
+  while (queue.size > 0) {
+    size_t n = queue_dequeue_n(&queue, data, 4096); 
+    checksum += data[n - 1]; 
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double block_time = elapsed_seconds(start, end); 
+
+  for (int i = 0; i < 1000; i++) queue_enqueue(&queue, i); 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  for (int i = 0; i < BENCHMARK_SIZE; i++) {
+    queue_enqueue(&queue, i); 
+    queue_dequeue(&queue, &front); 
+    checksum += front; 
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+
+  printf("Shifting dequeue, 20000 items:      %.2f ms\n", shifting_time * 1e3); 
+  printf("enqueue + dequeue, %d items:   %.2f ms\n", BENCHMARK_SIZE, single_time * 1e3); 
+  printf("enqueue_n + dequeue_n (4096):       %.2f ms\n", block_time * 1e3); 
+  printf("Steady state at 1000 items:         %.2f Mops/s\n", 2.0 * BENCHMARK_SIZE / elapsed_seconds(start, end) / 1e6); 
+  printf("(checksum %lld)\n\n", checksum); 
+
+  queue_free(&queue); 
+  free(data); 
+}
+
+void run_benchmarks() {
+  bench_queue(); 
+}
@@ -0,0 +1,260 @@
+/**
+ * *--------------------------*
+ * * Growable Queue (queue.h) *
+ * *--------------------------*
+ *
+ * The int queue from queue.c as a library. Dequeue used to copy every item down a slot, so draining n items was O(n^2).
+ * Now the items sit in queue[head .. head + size) and dequeue just moves head along:
+ *
+ * - queue_initialize(queue, capacity) / queue_free(queue)
+ * - queue_enqueue(queue, data) / queue_dequeue(queue, &out) / queue_peek(queue, &out)
+ * - queue_enqueue_n(queue, data, n) / queue_dequeue_n(queue, out, n) -> move a block of items with one memcpy
+ * - queue_reserve(queue, n) / queue_shrink_to_fit(queue)
+ *
+ * The dead slots in front of head are reclaimed lazily - only when an enqueue hits the end of the array:
+ *
+ * - If at least half the array is dead the live items are moved back to the front (compaction). Every item moved
+ *   has had an item dequeued in front of it since the last compaction, so each dequeue pays for one move - O(1) amortized
+ * - Otherwise the array grows by QUEUE_GROWTH_FACTOR (copying only the live items) like the Stack
+ *
+ * The queue shrinks once it is 1 / QUEUE_SHRINK_THRESHOLD full, leaving a gap to the growth point so it doesn't thrash.
+ * Dequeuing never shrinks below what queue_initialize(...)/queue_reserve(...) asked for, only queue_shrink_to_fit(...) does.
+ * The items are always contiguous, which keeps enqueue_n/dequeue_n to a single memcpy.
+ */
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef QUEUE_MIN_CAPACITY
+#define QUEUE_MIN_CAPACITY 8
+#endif
+
+#ifndef QUEUE_GROWTH_FACTOR
+#define QUEUE_GROWTH_FACTOR 2
+#endif
+
+#ifndef QUEUE_SHRINK_THRESHOLD
+#define QUEUE_SHRINK_THRESHOLD 4
+#endif
+
+#ifndef DEBUG_PRINT
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+typedef struct {
+  int* queue;
+  size_t head;
+  size_t size;
+  size_t capacity;
+  size_t reserved;
+} Queue;
+
+// Move the live items into a fresh array of `capacity` slots (never below the current size), starting at slot 0
+
+static inline bool queue_resize(Queue* queue, size_t capacity) {
+  if (capacity < queue->size) capacity = queue->size;
+  if (capacity < QUEUE_MIN_CAPACITY) capacity = QUEUE_MIN_CAPACITY;
+  if (capacity == queue->capacity && queue->head == 0) return true;
+
+  int* resized = (int*) malloc(capacity * sizeof(int));
+
+  if (resized == NULL) {
+    DEBUG_PRINT("Error reallocating the queue to %zu slots\n", capacity);
+    return false;
+  }
+
+  if (queue->size > 0) memcpy(resized, queue->queue + queue->head, queue->size * sizeof(int));
+  free(queue->queue);
+
+  queue->queue = resized;
+  queue->head = 0;
+  queue->capacity = capacity;
+
+  return true;
+}
+
+/**
+ * @param: queue -> The queue to set up
+ * @param: capacity -> How many items to make room for up front (at least QUEUE_MIN_CAPACITY)
+ */
+
+static inline bool queue_initialize(Queue* queue, size_t capacity) {
+  queue->queue = NULL;
+  queue->head = 0;
+  queue->size = 0;
+  queue->capacity = 0;
+  queue->reserved = 0;
+
+  if (!queue_resize(queue, capacity)) {
+    DEBUG_PRINT("Error Allocating memory for the queue\n\n", NULL);
+    return false;
+  }
+
+  queue->reserved = capacity;
+
+  return true;
+}
+
+static inline void queue_free(Queue* queue) {
+  free(queue->queue);
+  queue->queue = NULL;
+  queue->head = 0;
+  queue->size = 0;
+  queue->capacity = 0;
+  queue->reserved = 0;
+}
+
+/**
+ * Grows the queue to hold at least `capacity` items - call it before a big load so it only reallocates once
+ * Dequeuing won't shrink it back below `capacity` until queue_shrink_to_fit(...)
+ *
+ * @param: queue -> The queue to grow
+ * @param: capacity -> The number of items it should be able to hold
+ */
+
+static inline bool queue_reserve(Queue* queue, size_t capacity) {
+  if (capacity > queue->reserved) queue->reserved = capacity;
+  if (capacity <= queue->capacity) return true;
+
+  return queue_resize(queue, capacity);
+}
+
+// Gives back every unused slot and drops any reservation
+
+static inline bool queue_shrink_to_fit(Queue* queue) {
+  queue->reserved = 0;
+
+  return queue_resize(queue, queue->size);
+}
+
+// Room for `extra` more items after the last one - compact if half the array is dead, otherwise grow
+// A freed queue has no capacity to multiply, so growth starts again from QUEUE_MIN_CAPACITY
+
+static inline bool queue_make_room(Queue* queue, size_t extra) {
+  if (extra > SIZE_MAX - queue->size) return false;
+  if (queue->head + queue->size + extra <= queue->capacity) return true;
+
+  if (queue->size + extra <= queue->capacity / 2) {
+    memmove(queue->queue, queue->queue + queue->head, queue->size * sizeof(int));
+    queue->head = 0;
+    return true;
+  }
+
+  size_t needed = queue->size + extra;
+  size_t capacity = queue->capacity < QUEUE_MIN_CAPACITY ? QUEUE_MIN_CAPACITY : queue->capacity;
+
+  while (capacity < needed) {
+    if (capacity > SIZE_MAX / QUEUE_GROWTH_FACTOR) {
+      capacity = needed;
+      break;
+    }
+
+    capacity *= QUEUE_GROWTH_FACTOR;
+  }
+
+  return queue_resize(queue, capacity);
+}
+
+// Halve the capacity once the queue drops to a quarter full, but not below the reservation. A failed shrink is fine - the
+// queue is just bigger than it needs to be
+
+static inline void queue_maybe_shrink(Queue* queue) {
+  if (queue->capacity <= QUEUE_MIN_CAPACITY || queue->capacity <= queue->reserved) return;
+  if (queue->size > queue->capacity / QUEUE_SHRINK_THRESHOLD) return;
+
+  size_t capacity = queue->capacity / QUEUE_GROWTH_FACTOR;
+  if (capacity < queue->reserved) capacity = queue->reserved;
+
+  queue_resize(queue, capacity);
+}
+
+static inline bool queue_enqueue(Queue* queue, int data) {
+  if (queue->head + queue->size == queue->capacity && !queue_make_room(queue, 1)) {
+    DEBUG_PRINT("Error: Cannot enqueue as the queue could not grow\n\n", NULL);
+    return false;
+  }
+
+  queue->queue[queue->head + queue->size++] = data;
+  return true;
+}
+
+/**
+ * @param: queue -> The queue to take the front item from
+ * @param: out -> Where to put the item (can be NULL to just drop it)
+ */
+
+static inline bool queue_dequeue(Queue* queue, int* out) {
+  if (queue->size == 0) {
+    DEBUG_PRINT("Error: Cannot dequeue from an empty queue\n\n", NULL);
+    return false;
+  }
+
+  if (out != NULL) *out = queue->queue[queue->head];
+
+  queue->size--;
+  queue->head = queue->size == 0 ? 0 : queue->head + 1;
+
+  queue_maybe_shrink(queue);
+
+  return true;
+}
+
+static inline bool queue_peek(Queue* queue, int* out) {
+  if (queue->size == 0) return false;
+
+  *out = queue->queue[queue->head];
+  return true;
+}
+
+/**
+ * Enqueues data[0] ... data[n - 1] (data[0] comes out first) with at most one compaction/ growth and one memcpy
+ *
+ * @param: queue -> The queue to add to
+ * @param: data -> The items to enqueue
+ * @param: n -> How many items
+ */
+
+static inline bool queue_enqueue_n(Queue* queue, const int* data, size_t n) {
+  if (n == 0) return true;
+
+  if (!queue_make_room(queue, n)) {
+    DEBUG_PRINT("Error: Cannot enqueue %zu items as the queue could not grow\n\n", n);
+    return false;
+  }
+
+  memcpy(queue->queue + queue->head + queue->size, data, n * sizeof(int));
+  queue->size += n;
+
+  return true;
+}
+
+/**
+ * Dequeues up to n items from the front with one memcpy, in the order they were enqueued
+ *
+ * @param: queue -> The queue to take from
+ * @param: out -> Room for at least n items (can be NULL to just drop them)
+ * @param: n -> How many items to dequeue
+ *
+ * Returns how many items were dequeued (less than n if the queue ran out)
+ */
+
+static inline size_t queue_dequeue_n(Queue* queue, int* out, size_t n) {
+  if (n > queue->size) n = queue->size;
+  if (n == 0) return 0;
+
+  if (out != NULL) memcpy(out, queue->queue + queue->head, n * sizeof(int));
+
+  queue->size -= n;
+  queue->head = queue->size == 0 ? 0 : queue->head + n;
+
+  queue_maybe_shrink(queue);
+
+  return n;
+}
+
+#endif
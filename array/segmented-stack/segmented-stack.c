@@ -0,0 +1,546 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: Same functions as the Stack in array/stack/stack.h with a segmented_ prefix, so swapping one for the other is a rename
+//  NOTE: The Stack is only included for the benchmarks
+
+#include "../stack/stack.h"
+
+// Items per segment - 4096 ints is 16KB, big enough that the malloc per segment is lost in the pushes
+
+#define SEGMENT_SIZE 4096
+
+// Empty segments kept around after a pop so a stack going up and down across a segment boundary doesn't malloc/free each time
+
+#define MAX_SPARE_SEGMENTS 1
+
+typedef struct Segment {
+  struct Segment* below;
+  int data[SEGMENT_SIZE];
+} Segment;
+
+/**
+ * The items are in a linked list of fixed size segments, newest segment on top.
+ * Growing adds a segment rather than copying the whole stack, so an item never moves once it has been pushed.
+ *
+ * - top -> The segment holding the top of the stack (NULL when empty)
+ * - top_size -> How many items are in the top segment. Only the top segment can be partly full
+ * - spare -> Empty segments ready for the next push (linked through below)
+ * - reserved -> What segmented_stack_initialize(...)/segmented_stack_reserve(...) asked for. Popping keeps spares up to
+ *   it, only segmented_stack_shrink_to_fit(...) gives them back
+ */
+
+typedef struct {
+  Segment* top;
+  size_t top_size;
+  size_t size;
+  size_t capacity;
+  Segment* spare;
+  size_t spare_count;
+  size_t reserved;
+} SegmentedStack;
+
+/**
+ * ===================================
+ * ||        Segmented Stack        ||
+ * ===================================
+ */
+
+bool segmented_stack_initialize(SegmentedStack* stack, size_t capacity);
+void segmented_stack_free(SegmentedStack* stack);
+bool segmented_stack_reserve(SegmentedStack* stack, size_t capacity);
+bool segmented_stack_shrink_to_fit(SegmentedStack* stack);
+static inline bool segmented_stack_push(SegmentedStack* stack, int data);
+static inline bool segmented_stack_pop(SegmentedStack* stack, int* out);
+static inline bool segmented_stack_peek(SegmentedStack* stack, int* out);
+static inline int* segmented_stack_top_ref(SegmentedStack* stack);
+bool segmented_stack_push_n(SegmentedStack* stack, const int* data, size_t n);
+size_t segmented_stack_pop_n(SegmentedStack* stack, int* out, size_t n);
+
+// Hand back an empty segment - kept as a spare up to MAX_SPARE_SEGMENTS (or while freeing it would drop below the reservation), otherwise freed
+
+void segmented_stack_release(SegmentedStack* stack, Segment* segment) {
+  if (stack->spare_count < MAX_SPARE_SEGMENTS || stack->capacity - SEGMENT_SIZE < stack->reserved) {
+    segment->below = stack->spare;
+    stack->spare = segment;
+    stack->spare_count++;
+    return;
+  }
+
+  free(segment);
+  stack->capacity -= SEGMENT_SIZE;
+}
+
+// One more empty segment on the spare list
+
+bool segmented_stack_add_spare(SegmentedStack* stack) {
+  Segment* segment = (Segment*) malloc(sizeof(Segment));
+
+  if (segment == NULL) {
+    DEBUG_PRINT("Error Allocating memory for a stack segment\n\n", NULL);
+    return false;
+  }
+
+  segment->below = stack->spare;
+  stack->spare = segment;
+  stack->spare_count++;
+  stack->capacity += SEGMENT_SIZE;
+
+  return true;
+}
+
+// Put an empty segment on top (a spare if there is one)
+
+bool segmented_stack_add_segment(SegmentedStack* stack) {
+  if (stack->spare == NULL && !segmented_stack_add_spare(stack)) return false;
+
+  Segment* segment = stack->spare;
+  stack->spare = segment->below;
+  stack->spare_count--;
+
+  segment->below = stack->top;
+  stack->top = segment;
+  stack->top_size = 0;
+
+  return true;
+}
+
+// Take the empty top segment off, the one below is full (or there isn't one)
+
+void segmented_stack_drop_segment(SegmentedStack* stack) {
+  Segment* segment = stack->top;
+
+  stack->top = segment->below;
+  stack->top_size = stack->top == NULL ? 0 : SEGMENT_SIZE;
+
+  segmented_stack_release(stack, segment);
+}
+
+/**
+ * @param: stack -> The stack to set up
+ * @param: capacity -> How many items to make room for up front
+ */
+
+bool segmented_stack_initialize(SegmentedStack* stack, size_t capacity) {
+  stack->top = NULL;
+  stack->top_size = 0;
+  stack->size = 0;
+  stack->capacity = 0;
+  stack->spare = NULL;
+  stack->spare_count = 0;
+  stack->reserved = 0;
+
+  return segmented_stack_reserve(stack, capacity);
+}
+
+void segmented_stack_free(SegmentedStack* stack) {
+  Segment* lists[] = { stack->top, stack->spare };
+
+  for (int i = 0; i < 2; i++) {
+    Segment* segment = lists[i];
+
+    while (segment != NULL) {
+      Segment* below = segment->below;
+      free(segment);
+      segment = below;
+    }
+  }
+
+  segmented_stack_initialize(stack, 0);
+}
+
+/**
+ * Allocates spare segments until the stack can hold `capacity` items without another malloc. Popping won't free them
+ * again until segmented_stack_shrink_to_fit(...)
+ *
+ * @param: stack -> The stack to grow
+ * @param: capacity -> The number of items it should be able to hold
+ */
+
+bool segmented_stack_reserve(SegmentedStack* stack, size_t capacity) {
+  while (stack->capacity < capacity) {
+    if (!segmented_stack_add_spare(stack)) return false;
+  }
+
+  if (capacity > stack->reserved) stack->reserved = capacity;
+  return true;
+}
+
+// Frees every spare segment and drops any reservation - the segments holding items stay where they are
+
+bool segmented_stack_shrink_to_fit(SegmentedStack* stack) {
+  stack->reserved = 0;
+
+  while (stack->spare != NULL) {
+    Segment* segment = stack->spare;
+    stack->spare = segment->below;
+    free(segment);
+    stack->capacity -= SEGMENT_SIZE;
+  }
+
+  stack->spare_count = 0;
+  return true;
+}
+
+static inline bool segmented_stack_push(SegmentedStack* stack, int data) {
+  if ((stack->top == NULL || stack->top_size == SEGMENT_SIZE) && !segmented_stack_add_segment(stack)) {
+    DEBUG_PRINT("Error: Cannot push as the stack could not grow\n\n", NULL);
+    return false;
+  }
+
+  stack->top->data[stack->top_size++] = data;
+  stack->size++;
+
+  return true;
+}
+
+/**
+ * @param: stack -> The stack to pop from
+ * @param: out -> Where to put the popped item (can be NULL to just drop it)
+ */
+
+static inline bool segmented_stack_pop(SegmentedStack* stack, int* out) {
+  if (stack->size == 0) {
+    DEBUG_PRINT("Error: Cannot pop from an empty stack\n\n", NULL);
+    return false;
+  }
+
+  stack->top_size--;
+  stack->size--;
+  if (out != NULL) *out = stack->top->data[stack->top_size];
+
+  if (stack->top_size == 0) segmented_stack_drop_segment(stack);
+
+  return true;
+}
+
+static inline bool segmented_stack_peek(SegmentedStack* stack, int* out) {
+  if (stack->size == 0) return false;
+
+  *out = stack->top->data[stack->top_size - 1];
+  return true;
+}
+
+/**
+ * The address of the top item. It stays valid through any number of pushes and pops above it -
+ * only popping the item itself (or freeing the stack) invalidates it
+ */
+
+static inline int* segmented_stack_top_ref(SegmentedStack* stack) {
+  if (stack->size == 0) return NULL;
+
+  return &stack->top->data[stack->top_size - 1];
+}
+
+/**
+ * Pushes data[0] ... data[n - 1] (so data[n - 1] ends up on top) with one memcpy per segment
+ * Every segment needed is allocated first so a failed push leaves the stack as it was
+ *
+ * @param: stack -> The stack to push onto
+ * @param: data -> The items to push
+ * @param: n -> How many items
+ */
+
+bool segmented_stack_push_n(SegmentedStack* stack, const int* data, size_t n) {
+  if (n == 0) return true;
+
+  size_t room = stack->top == NULL ? 0 : SEGMENT_SIZE - stack->top_size;
+  size_t needed = n > room ? (n - room + SEGMENT_SIZE - 1) / SEGMENT_SIZE : 0;
+
+  while (stack->spare_count < needed) {
+    if (!segmented_stack_add_spare(stack)) {
+      DEBUG_PRINT("Error: Cannot push %zu items as the stack could not grow\n\n", n);
+      return false;
+    }
+  }
+
+  while (n > 0) {
+    if (stack->top == NULL || stack->top_size == SEGMENT_SIZE) segmented_stack_add_segment(stack);
+
+    size_t count = SEGMENT_SIZE - stack->top_size;
+    if (count > n) count = n;
+
+    memcpy(stack->top->data + stack->top_size, data, count * sizeof(int));
+    stack->top_size += count;
+    stack->size += count;
+    data += count;
+    n -= count;
+  }
+
+  return true;
+}
+
+/**
+ * Pops up to n items with one memcpy per segment. They come out in the order they sit in the stack (top last),
+ * the same as stack_pop_n(...)
+ *
+ * @param: stack -> The stack to pop from
+ * @param: out -> Room for at least n items (can be NULL to just drop them)
+ * @param: n -> How many items to pop
+ *
+ * Returns how many items were popped (less than n if the stack ran out)
+ */
+
+size_t segmented_stack_pop_n(SegmentedStack* stack, int* out, size_t n) {
+  if (n > stack->size) n = stack->size;
+
+  size_t remaining = n;
+
+  while (remaining > 0) {
+    size_t count = stack->top_size < remaining ? stack->top_size : remaining;
+
+    stack->top_size -= count;
+    stack->size -= count;
+    remaining -= count;
+
+    if (out != NULL) memcpy(out + remaining, stack->top->data + stack->top_size, count * sizeof(int));
+    if (stack->top_size == 0) segmented_stack_drop_segment(stack);
+  }
+
+  return n;
+}
+
+/**
+ * ===================================
+ * ||             Tests             ||
+ * ===================================
+ */
+
+void test_push_pop() {
+  printf("==================\n");
+  printf("|| Push and Pop ||\n");
+  printf("==================\n\n");
+
+  SegmentedStack stack;
+  if (!segmented_stack_initialize(&stack, 0)) return;
+
+  bool matched = true;
+  int top;
+
+  for (int i = 0; i < 3 * SEGMENT_SIZE + 7; i++) segmented_stack_push(&stack, i);
+
+  printf("Size: %zu, capacity: %zu\n", stack.size, stack.capacity);
+
+  if (!segmented_stack_peek(&stack, &top) || top != 3 * SEGMENT_SIZE + 6) matched = false;
+
+  for (int i = 3 * SEGMENT_SIZE + 6; i >= 0; i--) {
+    if (!segmented_stack_pop(&stack, &top) || top != i) matched = false;
+  }
+
+  printf("Popped in LIFO order: %s\n", matched ? "true" : "false");
+  printf("Capacity after popping everything: %zu (%zu spare)\n", stack.capacity, stack.spare_count);
+  printf("Pop from empty fails: %s\n\n", segmented_stack_pop(&stack, NULL) ? "false" : "true");
+
+  segmented_stack_free(&stack);
+}
+
+void test_push_n_pop_n() {
+  printf("==================\n");
+  printf("|| Push/Pop N   ||\n");
+  printf("==================\n\n");
+
+  SegmentedStack stack;
+  if (!segmented_stack_initialize(&stack, 0)) return;
+
+  size_t n = 2 * SEGMENT_SIZE + 100;
+  int* data = (int*) malloc(sizeof(int) * n);
+  int* out = (int*) malloc(sizeof(int) * n);
+  bool matched = true;
+
+  if (data == NULL || out == NULL) return;
+
+  for (size_t i = 0; i < n; i++) data[i] = (int) i * 3;
+
+  // Start part way into a segment so the block straddles the segment boundaries
+  for (int i = 0; i < 10; i++) segmented_stack_push(&stack, -1);
+  segmented_stack_push_n(&stack, data, n);
+
+  size_t popped = segmented_stack_pop_n(&stack, out, n);
+  for (size_t i = 0; i < popped; i++) {
+    if (out[i] != data[i]) matched = false;
+  }
+
+  printf("Popped %zu items, same as pushed: %s\n", popped, matched ? "true" : "false");
+
+  popped = segmented_stack_pop_n(&stack, out, n);
+  printf("Asked for %zu from a stack of 10, got %zu\n\n", n, popped);
+
+  free(data);
+  free(out);
+  segmented_stack_free(&stack);
+}
+
+void test_stable_addresses() {
+  printf("==================\n");
+  printf("|| Addresses    ||\n");
+  printf("==================\n\n");
+
+  SegmentedStack stack;
+  if (!segmented_stack_initialize(&stack, 0)) return;
+
+  int* refs[100];
+  bool stable = true;
+
+  // Take the address of every 1000th item then push far past it
+  for (int i = 0; i < 100; i++) {
+    for (int j = 0; j < 1000; j++) segmented_stack_push(&stack, i * 1000 + j);
+    refs[i] = segmented_stack_top_ref(&stack);
+  }
+
+  for (int i = 0; i < BENCHMARK_SIZE; i++) segmented_stack_push(&stack, -1);
+  segmented_stack_pop_n(&stack, NULL, BENCHMARK_SIZE);
+
+  for (int i = 0; i < 100; i++) {
+    if (*refs[i] != i * 1000 + 999) stable = false;
+  }
+
+  printf("Addresses unchanged after %d more pushes: %s\n\n", BENCHMARK_SIZE, stable ? "true" : "false");
+
+  segmented_stack_free(&stack);
+}
+
+void test_reserve_shrink() {
+  printf("==================\n");
+  printf("|| Reserve      ||\n");
+  printf("==================\n\n");
+
+  SegmentedStack stack;
+  if (!segmented_stack_initialize(&stack, 10 * SEGMENT_SIZE)) return;
+
+  printf("Capacity after reserve: %zu (%zu spare)\n", stack.capacity, stack.spare_count);
+
+  for (int i = 0; i < 5 * SEGMENT_SIZE; i++) segmented_stack_push(&stack, i);
+  printf("Capacity at %zu items: %zu (%zu spare)\n", stack.size, stack.capacity, stack.spare_count);
+
+  // Popping keeps every reserved segment as a spare
+  segmented_stack_pop_n(&stack, NULL, 4 * SEGMENT_SIZE);
+  printf("Capacity at %zu items: %zu (%zu spare)\n", stack.size, stack.capacity, stack.spare_count);
+
+  segmented_stack_shrink_to_fit(&stack);
+  printf("Capacity after shrink_to_fit: %zu (%zu spare)\n", stack.capacity, stack.spare_count);
+
+  // Without a reservation popping only keeps MAX_SPARE_SEGMENTS of the freed segments
+  for (int i = 0; i < 4 * SEGMENT_SIZE; i++) segmented_stack_push(&stack, i);
+  segmented_stack_pop_n(&stack, NULL, 4 * SEGMENT_SIZE);
+  printf("Capacity at %zu items: %zu (%zu spare)\n\n", stack.size, stack.capacity, stack.spare_count);
+
+  segmented_stack_free(&stack);
+}
+
+void run_tests() {
+  test_push_pop();
+
+  test_push_n_pop_n();
+
+  test_stable_addresses();
+
+  test_reserve_shrink();
+
+}
+
+/**
+ * ===================================
+ * ||           Benchmarks          ||
+ * ===================================
+ */
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// A deep DFS shape: push 32 * BENCHMARK_SIZE items then pop them all, with the realloc'd Stack against the segmented one
+
+void bench_deep_stack() {
+  printf("==================\n");
+  printf("|| Deep Stack   ||\n");
+  printf("==================\n\n");
+
+  size_t depth = (size_t) 32 * BENCHMARK_SIZE;
+  Stack array_stack;
+  SegmentedStack segmented_stack;
+  struct timespec start, end;
+  long long checksum = 0;
+  int popped;
+
+  if (!stack_initialize(&array_stack, 0) || !segmented_stack_initialize(&segmented_stack, 0)) return;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (size_t i = 0; i < depth; i++) stack_push(&array_stack, (int) i);
+  size_t array_peak = array_stack.capacity;
+  while (array_stack.size > 0) {
+    stack_pop(&array_stack, &popped);
+    checksum += popped;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double array_time = elapsed_seconds(start, end);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (size_t i = 0; i < depth; i++) segmented_stack_push(&segmented_stack, (int) i);
+  size_t segmented_peak = segmented_stack.capacity;
+  while (segmented_stack.size > 0) {
+    segmented_stack_pop(&segmented_stack, &popped);
+    checksum -= popped;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  printf("%zu pushes then pops\n", depth);
+  printf("Stack:           %.2f ms, peak capacity %zu (%.1f MB)\n", array_time * 1e3, array_peak, array_peak * sizeof(int) / 1e6);
+  printf("SegmentedStack:  %.2f ms, peak capacity %zu (%.1f MB)\n", elapsed_seconds(start, end) * 1e3, segmented_peak, segmented_peak * sizeof(int) / 1e6);
+  printf("(checksum %lld)\n\n", checksum);
+
+  stack_free(&array_stack);
+  segmented_stack_free(&segmented_stack);
+}
+
+// Push and pop back and forth across a segment boundary - the spare segment means no malloc/free per crossing
+
+void bench_boundary() {
+  printf("==================\n");
+  printf("|| Boundary     ||\n");
+  printf("==================\n\n");
+
+  SegmentedStack stack;
+  struct timespec start, end;
+
+  if (!segmented_stack_initialize(&stack, 0)) return;
+
+  for (int i = 0; i < SEGMENT_SIZE; i++) segmented_stack_push(&stack, i);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < BENCHMARK_SIZE; i++) {
+    segmented_stack_push(&stack, i);
+    segmented_stack_pop(&stack, NULL);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  printf("%d push/pop pairs across a boundary: %.2f ms\n\n", BENCHMARK_SIZE, elapsed_seconds(start, end) * 1e3);
+
+  segmented_stack_free(&stack);
+}
+
+void run_benchmarks() {
+  bench_deep_stack();
+  bench_boundary();
+}
+
+int main() {
+  run_tests();
+
+  if (RUN_BENCHMARKS) run_benchmarks();
+
+  return 0;
+}
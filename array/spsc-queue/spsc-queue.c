@@ -0,0 +1,289 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: The queue itself is in spsc-queue.h, this file tests it and benchmarks it against a mutex around the CircularQueue
+//  NOTE: Build with gcc -O2 -pthread spsc-queue.c
+
+#include "spsc-queue.h"
+#include "../circular-queue/circular-queue.h"
+
+#define QUEUE_CAPACITY 4096
+#define BATCH_SIZE 256
+
+// Items passed between the two threads in the benchmark
+
+#define TRANSFER_ITEMS (100 * BENCHMARK_SIZE)
+
+// Spin a little then give the core up - with fewer cores than threads the other side can't run until we do
+
+static inline void wait_for_other_side(int* spins) {
+  if (++*spins < 64) return;
+
+  *spins = 0;
+  sched_yield();
+}
+
+/**
+ * ===================================
+ * ||             Tests             ||
+ * ===================================
+ */
+
+void test_full_empty() {
+  printf("==================\n");
+  printf("|| Full + Empty ||\n");
+  printf("==================\n\n");
+
+  SpscQueue queue;
+  if (!spsc_queue_initialize(&queue, 10)) return;
+
+  int out;
+  int enqueued = 0;
+
+  while (spsc_queue_enqueue(&queue, enqueued)) enqueued++;
+
+  printf("Capacity 10 rounds up to %zu, enqueued %d before full\n", queue.capacity, enqueued);
+
+  bool matched = true;
+  for (int i = 0; i < enqueued; i++) {
+    if (!spsc_queue_dequeue(&queue, &out) || out != i) matched = false;
+  }
+
+  printf("Dequeued in FIFO order: %s\n", matched ? "true" : "false");
+  printf("Dequeue from empty fails: %s\n\n", spsc_queue_dequeue(&queue, &out) ? "false" : "true");
+
+  spsc_queue_free(&queue);
+}
+
+typedef struct {
+  SpscQueue* queue;
+  int count;
+  bool batch;
+  bool matched;
+} TransferContext;
+
+void* producer(void* arg) {
+  TransferContext* context = (TransferContext*) arg;
+  int block[BATCH_SIZE];
+  int spins = 0;
+  int next = 0;
+
+  while (next < context->count) {
+    if (context->batch) {
+      int n = context->count - next < BATCH_SIZE ? context->count - next : BATCH_SIZE;
+      for (int i = 0; i < n; i++) block[i] = next + i;
+
+      // Whatever didn't fit goes again next time round
+      size_t sent = spsc_queue_enqueue_n(context->queue, block, (size_t) n);
+      next += (int) sent;
+      if (sent == 0) wait_for_other_side(&spins);
+    } else if (spsc_queue_enqueue(context->queue, next)) {
+      next++;
+    } else {
+      wait_for_other_side(&spins);
+    }
+  }
+
+  return NULL;
+}
+
+void* consumer(void* arg) {
+  TransferContext* context = (TransferContext*) arg;
+  int block[BATCH_SIZE];
+  int spins = 0;
+  int expected = 0;
+
+  context->matched = true;
+
+  while (expected < context->count) {
+    if (context->batch) {
+      size_t received = spsc_queue_dequeue_n(context->queue, block, BATCH_SIZE);
+
+      for (size_t i = 0; i < received; i++) {
+        if (block[i] != expected++) context->matched = false;
+      }
+
+      if (received == 0) wait_for_other_side(&spins);
+    } else {
+      int out;
+
+      if (spsc_queue_dequeue(context->queue, &out)) {
+        if (out != expected++) context->matched = false;
+      } else {
+        wait_for_other_side(&spins);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+// Run a producer and a consumer thread over one queue, returns how long the transfer took
+
+double transfer(SpscQueue* queue, int count, bool batch, bool* matched) {
+  TransferContext context = { queue, count, batch, false };
+  pthread_t threads[2];
+  struct timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pthread_create(&threads[0], NULL, consumer, &context);
+  pthread_create(&threads[1], NULL, producer, &context);
+  pthread_join(threads[0], NULL);
+  pthread_join(threads[1], NULL);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  *matched = context.matched;
+
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+void test_threads() {
+  printf("==================\n");
+  printf("|| Two Threads  ||\n");
+  printf("==================\n\n");
+
+  SpscQueue queue;
+  bool matched;
+
+  // A small queue so both sides keep running into full/ empty and wrapping
+  if (!spsc_queue_initialize(&queue, 64)) return;
+
+  transfer(&queue, BENCHMARK_SIZE, false, &matched);
+  printf("%d items one at a time, all in order: %s\n", BENCHMARK_SIZE, matched ? "true" : "false");
+
+  transfer(&queue, BENCHMARK_SIZE, true, &matched);
+  printf("%d items in batches, all in order: %s\n\n", BENCHMARK_SIZE, matched ? "true" : "false");
+
+  spsc_queue_free(&queue);
+}
+
+void run_tests() {
+  test_full_empty();
+
+  test_threads();
+
+}
+
+/**
+ * ===================================
+ * ||           Benchmarks          ||
+ * ===================================
+ */
+
+typedef struct {
+  pthread_mutex_t lock;
+  CircularQueue queue;
+  int count;
+  long long checksum;
+} MutexContext;
+
+// The CircularQueue behind one mutex - what the pipeline did before, capped at QUEUE_CAPACITY so it can't just grow
+
+void* mutex_producer(void* arg) {
+  MutexContext* context = (MutexContext*) arg;
+  int spins = 0;
+
+  for (int i = 0; i < context->count;) {
+    pthread_mutex_lock(&context->lock);
+    bool room = circular_queue_size(&context->queue) < QUEUE_CAPACITY && circular_queue_enqueue(&context->queue, i);
+    pthread_mutex_unlock(&context->lock);
+
+    if (room) {
+      i++;
+    } else {
+      wait_for_other_side(&spins);
+    }
+  }
+
+  return NULL;
+}
+
+void* mutex_consumer(void* arg) {
+  MutexContext* context = (MutexContext*) arg;
+  int spins = 0;
+  int out;
+
+  for (int i = 0; i < context->count;) {
+    pthread_mutex_lock(&context->lock);
+    bool got = !circular_queue_is_empty(&context->queue) && circular_queue_dequeue(&context->queue, &out);
+    pthread_mutex_unlock(&context->lock);
+
+    if (got) {
+      context->checksum += out;
+      i++;
+    } else {
+      wait_for_other_side(&spins);
+    }
+  }
+
+  return NULL;
+}
+
+// TRANSFER_ITEMS from one thread to another, one at a time and in batches of BATCH_SIZE, in millions of items a second
+
+void bench_transfer() {
+  printf("==================\n");
+  printf("|| Transfer     ||\n");
+  printf("==================\n\n");
+
+  SpscQueue queue;
+  bool matched;
+
+  if (!spsc_queue_initialize(&queue, QUEUE_CAPACITY)) return;
+
+  double single_time = transfer(&queue, TRANSFER_ITEMS, false, &matched);
+  double batch_time = transfer(&queue, TRANSFER_ITEMS, true, &matched);
+
+  MutexContext context = { .count = TRANSFER_ITEMS / 10, .checksum = 0 };
+  pthread_t threads[2];
+  struct timespec start, end;
+
+  if (!circular_queue_initialize(&context.queue, QUEUE_CAPACITY)) return;
+  pthread_mutex_init(&context.lock, NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pthread_create(&threads[0], NULL, mutex_consumer, &context);
+  pthread_create(&threads[1], NULL, mutex_producer, &context);
+  pthread_join(threads[0], NULL);
+  pthread_join(threads[1], NULL);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double mutex_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  printf("Mutex + CircularQueue (%d items):   %.2f M items/s\n", context.count, context.count / mutex_time / 1e6);
+  printf("SPSC one at a time (%d items):    %.2f M items/s\n", TRANSFER_ITEMS, TRANSFER_ITEMS / single_time / 1e6);
+  printf("SPSC batches of %d (%d items):   %.2f M items/s\n\n", BATCH_SIZE, TRANSFER_ITEMS, TRANSFER_ITEMS / batch_time / 1e6);
+
+  spsc_queue_free(&queue);
+  circular_queue_free(&context.queue);
+  pthread_mutex_destroy(&context.lock);
+}
+
+void run_benchmarks() {
+  bench_transfer();
+}
+
+int main() {
+  run_tests();
+
+  if (RUN_BENCHMARKS) run_benchmarks();
+
+  return 0;
+}
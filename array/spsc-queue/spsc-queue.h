@@ -0,0 +1,217 @@
+/**
+ * *------------------------------------------*
+ * * SPSC Ring Buffer (spsc-queue.h)          *
+ * *------------------------------------------*
+ *
+ * The circular queue (array/circular-queue) for exactly one producer thread and one consumer thread, with no lock.
+ * It keeps the power of two capacity and free running head/tail counters, but it doesn't grow - a full queue
+ * makes the producer wait (spsc_queue_enqueue(...) returns false) rather than reallocating under the consumer.
+ *
+ * Only the producer writes tail and only the consumer writes head, so neither needs a CAS:
+ *
+ * - The producer writes the item, then stores tail + 1 with release. A consumer that reads the new tail with acquire
+ *   is guaranteed to see the item
+ * - The consumer reads the item, then stores head + 1 with release, which hands the slot back to the producer
+ *
+ * Layout matters as much as the atomics here:
+ *
+ * - tail and head are on separate cache lines, otherwise every store by one side would invalidate the other side's line
+ * - Each side keeps a cached copy of the other side's counter on its own line (cached_head for the producer,
+ *   cached_tail for the consumer). The shared counter is only read when the cached one says full/ empty, so in the
+ *   common case each side only touches its own line
+ * - spsc_queue_enqueue_n(...)/spsc_queue_dequeue_n(...) copy a whole batch and publish it with one store
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef SPSC_QUEUE_MIN_CAPACITY
+#define SPSC_QUEUE_MIN_CAPACITY 8
+#endif
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+#ifndef DEBUG_PRINT
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+typedef struct {
+  // Producer's line
+  _Alignas(CACHE_LINE_SIZE) _Atomic size_t tail;
+  size_t cached_head;
+
+  // Consumer's line
+  _Alignas(CACHE_LINE_SIZE) _Atomic size_t head;
+  size_t cached_tail;
+
+  // Read only once the queue is set up, so both sides can share this line
+  _Alignas(CACHE_LINE_SIZE) int* queue;
+  size_t capacity;
+  size_t mask;
+} SpscQueue;
+
+/**
+ * @param: queue -> The queue to set up (before either thread uses it)
+ * @param: capacity -> How many items it holds, rounded up to a power of two
+ */
+
+static inline bool spsc_queue_initialize(SpscQueue* queue, size_t capacity) {
+  size_t rounded = SPSC_QUEUE_MIN_CAPACITY;
+
+  while (rounded < capacity) {
+    if (rounded > SIZE_MAX / 2 / sizeof(int)) return false;
+    rounded *= 2;
+  }
+
+  queue->queue = (int*) aligned_alloc(CACHE_LINE_SIZE, rounded * sizeof(int) < CACHE_LINE_SIZE ? CACHE_LINE_SIZE : rounded * sizeof(int));
+
+  if (queue->queue == NULL) {
+    DEBUG_PRINT("Error Allocating memory for the queue\n\n", NULL);
+    return false;
+  }
+
+  queue->capacity = rounded;
+  queue->mask = rounded - 1;
+  queue->cached_head = 0;
+  queue->cached_tail = 0;
+  atomic_init(&queue->head, 0);
+  atomic_init(&queue->tail, 0);
+
+  return true;
+}
+
+static inline void spsc_queue_free(SpscQueue* queue) {
+  free(queue->queue);
+  queue->queue = NULL;
+  queue->capacity = 0;
+  queue->mask = 0;
+}
+
+// Producer only - how many slots are free, only reading the consumer's head when the cached copy isn't enough
+
+static inline size_t spsc_queue_free_slots(SpscQueue* queue, size_t tail, size_t wanted) {
+  size_t free_slots = queue->capacity - (tail - queue->cached_head);
+
+  if (free_slots < wanted) {
+    queue->cached_head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    free_slots = queue->capacity - (tail - queue->cached_head);
+  }
+
+  return free_slots;
+}
+
+// Consumer only - how many items are ready, only reading the producer's tail when the cached copy isn't enough
+
+static inline size_t spsc_queue_ready(SpscQueue* queue, size_t head, size_t wanted) {
+  size_t ready = queue->cached_tail - head;
+
+  if (ready < wanted) {
+    queue->cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    ready = queue->cached_tail - head;
+  }
+
+  return ready;
+}
+
+/**
+ * Producer only. Returns false if the queue is full
+ *
+ * @param: queue -> The queue to add to
+ * @param: data -> The item to enqueue
+ */
+
+static inline bool spsc_queue_enqueue(SpscQueue* queue, int data) {
+  size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+  if (spsc_queue_free_slots(queue, tail, 1) == 0) return false;
+
+  queue->queue[tail & queue->mask] = data;
+  atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+
+  return true;
+}
+
+/**
+ * Consumer only. Returns false if the queue is empty
+ *
+ * @param: queue -> The queue to take from
+ * @param: out -> Where to put the item
+ */
+
+static inline bool spsc_queue_dequeue(SpscQueue* queue, int* out) {
+  size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+  if (spsc_queue_ready(queue, head, 1) == 0) return false;
+
+  *out = queue->queue[head & queue->mask];
+  atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+  return true;
+}
+
+/**
+ * Producer only. Enqueues as many of data[0] ... data[n - 1] as fit (at most two memcpys) and publishes them
+ * all with a single store to tail
+ *
+ * @param: queue -> The queue to add to
+ * @param: data -> The items to enqueue
+ * @param: n -> How many items
+ *
+ * Returns how many items were enqueued (less than n if the queue filled up)
+ */
+
+static inline size_t spsc_queue_enqueue_n(SpscQueue* queue, const int* data, size_t n) {
+  size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  size_t free_slots = spsc_queue_free_slots(queue, tail, n);
+
+  if (n > free_slots) n = free_slots;
+  if (n == 0) return 0;
+
+  size_t start = tail & queue->mask;
+  size_t first = queue->capacity - start < n ? queue->capacity - start : n;
+
+  memcpy(queue->queue + start, data, first * sizeof(int));
+  if (n > first) memcpy(queue->queue, data + first, (n - first) * sizeof(int));
+
+  atomic_store_explicit(&queue->tail, tail + n, memory_order_release);
+
+  return n;
+}
+
+/**
+ * Consumer only. Dequeues up to n items (at most two memcpys) and hands all their slots back with a single store to head
+ *
+ * @param: queue -> The queue to take from
+ * @param: out -> Room for at least n items
+ * @param: n -> How many items to dequeue
+ *
+ * Returns how many items were dequeued (less than n if there weren't that many ready)
+ */
+
+static inline size_t spsc_queue_dequeue_n(SpscQueue* queue, int* out, size_t n) {
+  size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  size_t ready = spsc_queue_ready(queue, head, n);
+
+  if (n > ready) n = ready;
+  if (n == 0) return 0;
+
+  size_t start = head & queue->mask;
+  size_t first = queue->capacity - start < n ? queue->capacity - start : n;
+
+  memcpy(out, queue->queue + start, first * sizeof(int));
+  if (n > first) memcpy(out + first, queue->queue, (n - first) * sizeof(int));
+
+  atomic_store_explicit(&queue->head, head + n, memory_order_release);
+
+  return n;
+}
+
+#endif
@@ -1,47 +1,79 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
-typedef struct {
-  int* stack; 
-  int size; 
-  int capacity;
-} Stack; 
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
 
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: The stack itself lives in stack.h - stack_push(...), stack_pop(...) etc. never touch stdin/stdout 
+//  NOTE: programLoop() is just one client of it. Run ./stack --test for the tests and benchmarks 
+
+#include "stack.h"
+
+// Stack user operations UI
 void length(Stack* stack); 
 void capacity(Stack* stack); 
 void push(Stack* stack);  
 void pop(Stack* stack);
 void show(Stack* stack);
 void programLoop(); 
-int initializeStack(); 
+size_t initializeStack(); 
 void printMenu();
 
-int main() {
+void run_tests(); 
+void run_benchmarks(); 
+
+int main(int argc, char** argv) {
+  if (argc > 1 && strcmp(argv[1], "--test") == 0) {
+    run_tests(); 
+
+    if (RUN_BENCHMARKS) run_benchmarks(); 
+
+    return 0; 
+  }
+
   programLoop(); 
   return 0; 
 }
 
+/**
+ * ===================================
+ * ||          Program Loop         ||
+ * ===================================
+ */
+
 void programLoop() {
   printf("========================\n"); 
   printf("* Stack Data Structure *\n"); 
   printf("========================\n\n"); 
 
-  int stackSize = initializeStack();  
   Stack stack; 
-  stack.size = 0; 
-  stack.capacity = stackSize; 
-  stack.stack = (int*) malloc(stack.capacity * sizeof(int)); 
+
+  if (!stack_initialize(&stack, initializeStack())) exit(1); 
 
   while(true) {
     int command;
     printMenu(); 
-    scanf("%d", &command);  
+    if (scanf("%d", &command) != 1) {
+      stack_free(&stack); 
+      exit(0); 
+    }
     printf("\n"); 
 
     switch(command) {
       case 0 :
+        stack_free(&stack); 
         exit(0);
         break; 
       case 1 : 
@@ -67,19 +99,19 @@ void programLoop() {
 
   }
 
-  free(stack.stack); 
+  stack_free(&stack); 
 }
 
-// TODO: This needs to be fixed 
+// The size is only a starting capacity now, the stack grows past it 
 
-int initializeStack() {
+size_t initializeStack() {
   printf("The stack will be limited to integers only\n\n"); 
   printf("> Please initialize your stack with a size: "); 
-  long stackSize; 
-  scanf("%ld", &stackSize);
+  long stackSize = 0; 
+  if (scanf("%ld", &stackSize) != 1 || stackSize < 0) stackSize = 0; 
   printf("\n\n"); 
 
-  return stackSize;
+  return (size_t) stackSize;
 }
 
 void printMenu() {
@@ -95,11 +127,11 @@ void printMenu() {
 }
 
 void show(Stack* stack) {
-  int size = stack->size;
+  size_t size = stack->size;
   if(size == 0) {
     printf("There is nothing in your stack to show!\n\n"); 
   } else if (stack->size > 1) {
-    int i; 
+    size_t i; 
     printf("Showing Stack Contents\n\n"); 
     printf("[");
     for (i = 0; i < stack->size - 1; i++) {
@@ -114,11 +146,11 @@ void show(Stack* stack) {
 }
 
 void length(Stack* stack) {
-  int size = stack->size;
+  size_t size = stack->size;
   if(size == 0) {
     printf("There is nothing in your stack!\n\n"); 
   } else {
-    printf("Stack contains: %d items\n\n", stack->size); 
+    printf("Stack contains: %zu items\n\n", stack->size); 
   }
 }
 
@@ -127,31 +159,205 @@ void capacity(Stack* stack) {
   float capacity = (float) stack->capacity;
   float fullPercentage = (float) (size / capacity) * 100; 
 
-  printf("The total capacity of your stack is %d items\n", stack->capacity); 
+  printf("The total capacity of your stack is %zu items\n", stack->capacity); 
   printf("The percentage your stack is full is %.2f%%\n\n", fullPercentage); 
 }
 
 void push(Stack* stack) {
-  if(stack->size == stack->capacity) {
-    printf("Any more items will overflow the stack!i\n");
-  } else {
-    int newNum; 
-    printf("> Enter the number you want to add to the stack: ");
-    scanf("%d", &newNum); 
-    printf("\nAdding Number...\n\n");
-    stack->stack[stack->size] = newNum; 
-    stack->size += 1;
+  int newNum; 
+  printf("> Enter the number you want to add to the stack: ");
+  if (scanf("%d", &newNum) != 1) return; 
+  printf("\nAdding Number...\n\n");
+
+  if (stack_push(stack, newNum)) {
     printf("%d sucessfully added to the stack\n\n", newNum);
+  } else {
+    printf("Could not add %d as the stack could not grow\n\n", newNum);
   }
 }
 
 void pop(Stack* stack) {
-  if((stack->size - 1) < 0) {
+  int popped; 
+
+  if (!stack_pop(stack, &popped)) {
     printf("Cannot remove any more items from the stack as it is already empty\n\n"); 
     return; 
   }
 
-  stack->size -= 1;
-  printf("Stack size decremented meaning that the next element pushed will overwrite the previous element\n\n"); 
-  
+  printf("%d popped from the stack\n\n", popped); 
+}
+
+/**
+ * ===================================
+ * ||             Tests             ||
+ * ===================================
+ */
+
+void test_push_pop() {
+  printf("==================\n");
+  printf("|| Push and Pop ||\n"); 
+  printf("==================\n\n");
+
+  Stack stack; 
+  if (!stack_initialize(&stack, 0)) return; 
+
+  bool matched = true; 
+  int top; 
+
+  for (int i = 0; i < 1000; i++) stack_push(&stack, i); 
+
+  printf("Size after 1000 pushes: %zu (capacity %zu)\n", stack.size, stack.capacity); 
+
+  if (!stack_peek(&stack, &top) || top != 999) matched = false; 
+
+  for (int i = 999; i >= 0; i--) {
+    if (!stack_pop(&stack, &top) || top != i) matched = false; 
+  }
+
+  printf("Popped in LIFO order: %s\n", matched ? "true" : "false"); 
+  printf("Capacity after popping everything: %zu\n", stack.capacity); 
+  printf("Pop from empty fails: %s\n\n", stack_pop(&stack, NULL) ? "false" : "true"); 
+
+  stack_free(&stack); 
+}
+
+void test_push_n_pop_n() {
+  printf("==================\n");
+  printf("|| Push/Pop N   ||\n"); 
+  printf("==================\n\n");
+
+  Stack stack; 
+  if (!stack_initialize(&stack, 0)) return; 
+
+  int data[5000]; 
+  int out[5000]; 
+  bool matched = true; 
+
+  for (int i = 0; i < 5000; i++) data[i] = i * 3; 
+
+  stack_push(&stack, -1); 
+  stack_push_n(&stack, data, 5000); 
+
+  size_t popped = stack_pop_n(&stack, out, 5000); 
+  for (size_t i = 0; i < popped; i++) {
+    if (out[i] != data[i]) matched = false; 
+  }
+
+  printf("Popped %zu items, same as pushed: %s\n", popped, matched ? "true" : "false"); 
+
+  // Asking for more than there is just pops what is left 
+  popped = stack_pop_n(&stack, out, 10); 
+  printf("Asked for 10 from a stack of 1, got %zu (%d)\n\n", popped, out[0]); 
+
+  stack_free(&stack); 
+}
+
+void test_reserve_shrink() {
+  printf("==================\n");
+  printf("|| Reserve      ||\n"); 
+  printf("==================\n\n");
+
+  Stack stack; 
+  if (!stack_initialize(&stack, 0)) return; 
+
+  stack_reserve(&stack, 1000); 
+  size_t reserved = stack.capacity; 
+
+  for (int i = 0; i < 1000; i++) stack_push(&stack, i); 
+
+  printf("Capacity after reserve(1000): %zu, after 1000 pushes: %zu\n", reserved, stack.capacity); 
+
+  // Popping doesn't give back memory that was reserved 
+  stack_pop_n(&stack, NULL, 990); 
+  printf("Capacity at %zu items: %zu\n", stack.size, stack.capacity); 
+
+  stack_shrink_to_fit(&stack); 
+  printf("Capacity after shrink_to_fit: %zu\n", stack.capacity); 
+
+  // Without a reservation popping to just under half doesn't shrink, a quarter does 
+  stack_free(&stack); 
+  if (!stack_initialize(&stack, 0)) return; 
+
+  for (int i = 0; i < 1000; i++) stack_push(&stack, i); 
+  printf("Capacity at %zu items: %zu\n", stack.size, stack.capacity); 
+
+  stack_pop_n(&stack, NULL, 501); 
+  printf("Capacity at %zu items: %zu\n", stack.size, stack.capacity); 
+
+  stack_pop_n(&stack, NULL, 250); 
+  printf("Capacity at %zu items: %zu\n", stack.size, stack.capacity); 
+
+  // A freed stack has no capacity left to grow from 
+  stack_free(&stack); 
+  printf("Push after free: %s\n\n", stack_push(&stack, 1) && stack.size == 1 ? "true" : "false"); 
+
+  stack_free(&stack); 
+}
+
+void run_tests() {
+  test_push_pop(); 
+
+  test_push_n_pop_n(); 
+
+  test_reserve_shrink(); 
+
+}
+
+/**
+ * ===================================
+ * ||           Benchmarks          ||
+ * ===================================
+ */
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9; 
+}
+
+// Move BENCHMARK_SIZE items on and off the stack one at a time, then in blocks of 4096 with push_n/pop_n 
+
+void bench_push_pop() {
+  printf("==================\n");
+  printf("|| Push/Pop     ||\n"); 
+  printf("==================\n\n");
+
+  int* data = (int*) malloc(sizeof(int) * BENCHMARK_SIZE); 
+  Stack stack; 
+  struct timespec start, end; 
+  long long checksum = 0; 
+  int popped; 
+
+  if (data == NULL || !stack_initialize(&stack, 0)) return; 
+
+  for (int i = 0; i < BENCHMARK_SIZE; i++) data[i] = i; 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  for (int i = 0; i < BENCHMARK_SIZE; i++) stack_push(&stack, data[i]); 
+  while (stack.size > 0) {
+    stack_pop(&stack, &popped); 
+    checksum += popped; 
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double single_time = elapsed_seconds(start, end); 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  for (size_t i = 0; i < BENCHMARK_SIZE; i += 4096) {
+    size_t n = BENCHMARK_SIZE - i < 4096 ? BENCHMARK_SIZE - i : 4096; 
+    stack_push_n(&stack, data + i, n); 
+  }
+  while (stack.size > 0) {
+    size_t n = stack_pop_n(&stack, data, 4096); 
+    checksum += data[n - 1]; 
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+
+  printf("push + pop one at a time:   %.2f ms\n", single_time * 1e3); 
+  printf("push_n + pop_n (4096):      %.2f ms\n", elapsed_seconds(start, end) * 1e3); 
+  printf("(checksum %lld)\n\n", checksum); 
+
+  stack_free(&stack); 
+  free(data); 
+}
+
+void run_benchmarks() {
+  bench_push_pop(); 
 }
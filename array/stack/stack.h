@@ -0,0 +1,238 @@
+/**
+ * *--------------------------*
+ * * Growable Stack (stack.h) *
+ * *--------------------------*
+ *
+ * The int stack from stack.c as a library - nothing in here reads stdin or prints unless DEBUG_PRINT is defined.
+ * stack.c (the interactive program) is one client, the other stacks in array/ use it as the baseline they are benchmarked against
+ * and keep the same function names with their own prefix (segmented_stack_push ...) so they can be swapped in.
+ *
+ * - stack_initialize(stack, capacity) / stack_free(stack)
+ * - stack_push(stack, data) / stack_pop(stack, &out) / stack_peek(stack, &out)
+ * - stack_push_n(stack, data, n) / stack_pop_n(stack, out, n) -> move a block of items with one memcpy
+ * - stack_reserve(stack, n) / stack_shrink_to_fit(stack)
+ *
+ * The array grows by STACK_GROWTH_FACTOR when full and halves once it is 1 / STACK_SHRINK_THRESHOLD full.
+ * The gap between the two points means a stack pushing and popping around a boundary doesn't realloc every time.
+ * Popping never shrinks below what stack_initialize(...)/stack_reserve(...) asked for, only stack_shrink_to_fit(...) does.
+ */
+
+#ifndef STACK_H
+#define STACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef STACK_MIN_CAPACITY
+#define STACK_MIN_CAPACITY 8
+#endif
+
+#ifndef STACK_GROWTH_FACTOR
+#define STACK_GROWTH_FACTOR 2
+#endif
+
+#ifndef STACK_SHRINK_THRESHOLD
+#define STACK_SHRINK_THRESHOLD 4
+#endif
+
+#ifndef DEBUG_PRINT
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+typedef struct {
+  int* stack; 
+  size_t size; 
+  size_t capacity;
+  size_t reserved; 
+} Stack; 
+
+// Move the stack into a buffer of exactly `capacity` slots (never below the current size) 
+
+static inline bool stack_resize(Stack* stack, size_t capacity) {
+  if (capacity < stack->size) capacity = stack->size; 
+  if (capacity < STACK_MIN_CAPACITY) capacity = STACK_MIN_CAPACITY; 
+  if (capacity == stack->capacity) return true; 
+
+  int* resized = (int*) realloc(stack->stack, capacity * sizeof(int)); 
+
+  if (resized == NULL) {
+    DEBUG_PRINT("Error reallocating the stack to %zu slots\n", capacity); 
+    return false; 
+  }
+
+  stack->stack = resized; 
+  stack->capacity = capacity; 
+
+  return true; 
+}
+
+/**
+ * @param: stack -> The stack to set up 
+ * @param: capacity -> How many items to make room for up front (at least STACK_MIN_CAPACITY) 
+ */
+
+static inline bool stack_initialize(Stack* stack, size_t capacity) {
+  stack->stack = NULL; 
+  stack->size = 0; 
+  stack->capacity = 0; 
+  stack->reserved = 0; 
+
+  if (!stack_resize(stack, capacity)) {
+    DEBUG_PRINT("Error Allocating memory for the stack\n\n", NULL); 
+    return false; 
+  }
+
+  stack->reserved = capacity; 
+
+  return true; 
+}
+
+static inline void stack_free(Stack* stack) {
+  free(stack->stack); 
+  stack->stack = NULL; 
+  stack->size = 0; 
+  stack->capacity = 0; 
+  stack->reserved = 0; 
+}
+
+/**
+ * Grows the stack to hold at least `capacity` items - call it before a big load so it only reallocs once 
+ * Popping won't shrink it back below `capacity` until stack_shrink_to_fit(...) 
+ *
+ * @param: stack -> The stack to grow 
+ * @param: capacity -> The number of items it should be able to hold 
+ */
+
+static inline bool stack_reserve(Stack* stack, size_t capacity) {
+  if (capacity > stack->reserved) stack->reserved = capacity; 
+  if (capacity <= stack->capacity) return true; 
+
+  return stack_resize(stack, capacity); 
+}
+
+// Gives back every unused slot and drops any reservation 
+
+static inline bool stack_shrink_to_fit(Stack* stack) {
+  stack->reserved = 0; 
+
+  return stack_resize(stack, stack->size); 
+}
+
+// Room for `extra` more items - grows geometrically so a run of pushes is amortized O(1) 
+// A freed stack has no capacity to multiply, so growth starts again from STACK_MIN_CAPACITY 
+
+static inline bool stack_grow(Stack* stack, size_t extra) {
+  if (extra > SIZE_MAX - stack->size) return false; 
+  if (stack->size + extra <= stack->capacity) return true; 
+
+  size_t needed = stack->size + extra; 
+  size_t capacity = stack->capacity < STACK_MIN_CAPACITY ? STACK_MIN_CAPACITY : stack->capacity; 
+
+  while (capacity < needed) {
+    if (capacity > SIZE_MAX / STACK_GROWTH_FACTOR) {
+      capacity = needed; 
+      break; 
+    }
+
+    capacity *= STACK_GROWTH_FACTOR; 
+  }
+
+  return stack_resize(stack, capacity); 
+}
+
+// Halve the capacity once the stack drops to a quarter full, but not below the reservation. A failed shrink is fine - the 
+// stack is just bigger than it needs to be 
+
+static inline void stack_maybe_shrink(Stack* stack) {
+  if (stack->capacity <= STACK_MIN_CAPACITY || stack->capacity <= stack->reserved) return; 
+  if (stack->size > stack->capacity / STACK_SHRINK_THRESHOLD) return; 
+
+  size_t capacity = stack->capacity / STACK_GROWTH_FACTOR; 
+  if (capacity < stack->reserved) capacity = stack->reserved; 
+
+  stack_resize(stack, capacity); 
+}
+
+static inline bool stack_push(Stack* stack, int data) {
+  if (stack->size == stack->capacity && !stack_grow(stack, 1)) {
+    DEBUG_PRINT("Error: Cannot push as the stack could not grow\n\n", NULL); 
+    return false; 
+  }
+
+  stack->stack[stack->size++] = data; 
+  return true; 
+}
+
+/**
+ * @param: stack -> The stack to pop from 
+ * @param: out -> Where to put the popped item (can be NULL to just drop it) 
+ */
+
+static inline bool stack_pop(Stack* stack, int* out) {
+  if (stack->size == 0) {
+    DEBUG_PRINT("Error: Cannot pop from an empty stack\n\n", NULL); 
+    return false; 
+  }
+
+  stack->size--; 
+  if (out != NULL) *out = stack->stack[stack->size]; 
+
+  stack_maybe_shrink(stack); 
+
+  return true; 
+}
+
+static inline bool stack_peek(Stack* stack, int* out) {
+  if (stack->size == 0) return false; 
+
+  *out = stack->stack[stack->size - 1]; 
+  return true; 
+}
+
+/**
+ * Pushes data[0] ... data[n - 1] (so data[n - 1] ends up on top) with one grow and one memcpy 
+ *
+ * @param: stack -> The stack to push onto 
+ * @param: data -> The items to push 
+ * @param: n -> How many items 
+ */
+
+static inline bool stack_push_n(Stack* stack, const int* data, size_t n) {
+  if (n == 0) return true; 
+
+  if (!stack_grow(stack, n)) {
+    DEBUG_PRINT("Error: Cannot push %zu items as the stack could not grow\n\n", n); 
+    return false; 
+  }
+
+  memcpy(stack->stack + stack->size, data, n * sizeof(int)); 
+  stack->size += n; 
+
+  return true; 
+}
+
+/**
+ * Pops up to n items with one memcpy. They come out in the order they sit in the stack (top last), 
+ * so stack_push_n(stack, data, n) followed by stack_pop_n(stack, out, n) leaves out the same as data 
+ *
+ * @param: stack -> The stack to pop from 
+ * @param: out -> Room for at least n items (can be NULL to just drop them) 
+ * @param: n -> How many items to pop 
+ *
+ * Returns how many items were popped (less than n if the stack ran out) 
+ */
+
+static inline size_t stack_pop_n(Stack* stack, int* out, size_t n) {
+  if (n > stack->size) n = stack->size; 
+
+  stack->size -= n; 
+  if (out != NULL && n > 0) memcpy(out, stack->stack + stack->size, n * sizeof(int)); 
+
+  stack_maybe_shrink(stack); 
+
+  return n; 
+}
+
+#endif
@@ -0,0 +1,259 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: The lock free stack itself is in treiber-stack.h, this file tests it and benchmarks it against a mutex around the Stack
+//  NOTE: Build with gcc -O2 -pthread treiber-stack.c
+
+#include "treiber-stack.h"
+#include "../stack/stack.h"
+
+#define MAX_THREADS 64
+
+/**
+ * ===================================
+ * ||          Mutex Stack          ||
+ * ===================================
+ */
+
+// The Stack from array/stack behind one lock - how it was shared between threads before
+
+typedef struct {
+  pthread_mutex_t lock;
+  Stack stack;
+} MutexStack;
+
+bool mutex_stack_push(MutexStack* stack, int data) {
+  pthread_mutex_lock(&stack->lock);
+  bool pushed = stack_push(&stack->stack, data);
+  pthread_mutex_unlock(&stack->lock);
+
+  return pushed;
+}
+
+bool mutex_stack_pop(MutexStack* stack, int* out) {
+  pthread_mutex_lock(&stack->lock);
+  bool popped = stack->stack.size > 0 && stack_pop(&stack->stack, out);
+  pthread_mutex_unlock(&stack->lock);
+
+  return popped;
+}
+
+/**
+ * ===================================
+ * ||             Tests             ||
+ * ===================================
+ */
+
+void test_push_pop() {
+  printf("==================\n");
+  printf("|| Push and Pop ||\n");
+  printf("==================\n\n");
+
+  TreiberStack stack;
+  if (!treiber_stack_initialize(&stack)) return;
+
+  TreiberThread* thread = treiber_stack_register(&stack);
+  bool matched = true;
+  int popped;
+
+  if (thread == NULL) return;
+
+  for (int i = 0; i < 10000; i++) treiber_stack_push(&stack, thread, i);
+
+  for (int i = 9999; i >= 0; i--) {
+    if (!treiber_stack_pop(&stack, thread, &popped) || popped != i) matched = false;
+  }
+
+  printf("Popped in LIFO order: %s\n", matched ? "true" : "false");
+  printf("Pop from empty fails: %s\n", treiber_stack_pop(&stack, thread, &popped) ? "false" : "true");
+  printf("Nodes back in the pools: %zu\n\n", thread->pool_size + thread->retired_count + stack.shared_pool_size);
+
+  treiber_stack_free(&stack);
+}
+
+typedef struct {
+  TreiberStack* stack;
+  int id;
+  int count;
+  _Atomic int* seen;
+} TestContext;
+
+// Push count values unique to this thread, popping one after every push so pushes and pops race each other
+
+void* test_worker(void* arg) {
+  TestContext* context = (TestContext*) arg;
+  TreiberThread* thread = treiber_stack_register(context->stack);
+  int popped;
+
+  if (thread == NULL) return NULL;
+
+  for (int i = 0; i < context->count; i++) {
+    treiber_stack_push(context->stack, thread, context->id * context->count + i);
+
+    if (i % 2 == 0 && treiber_stack_pop(context->stack, thread, &popped)) atomic_fetch_add(&context->seen[popped], 1);
+  }
+
+  while (treiber_stack_pop(context->stack, thread, &popped)) atomic_fetch_add(&context->seen[popped], 1);
+
+  return NULL;
+}
+
+void test_concurrent() {
+  printf("==================\n");
+  printf("|| Concurrent   ||\n");
+  printf("==================\n\n");
+
+  int thread_count = 8;
+  int count = 50000;
+  TreiberStack stack;
+  pthread_t threads[8];
+  TestContext contexts[8];
+  _Atomic int* seen = (_Atomic int*) calloc((size_t) thread_count * count, sizeof(_Atomic int));
+
+  if (seen == NULL || !treiber_stack_initialize(&stack)) return;
+
+  for (int i = 0; i < thread_count; i++) {
+    contexts[i] = (TestContext) { &stack, i, count, seen };
+    pthread_create(&threads[i], NULL, test_worker, &contexts[i]);
+  }
+
+  for (int i = 0; i < thread_count; i++) pthread_join(threads[i], NULL);
+
+  // Every value pushed should have been popped exactly once
+  bool exactly_once = true;
+  for (int i = 0; i < thread_count * count; i++) {
+    if (atomic_load(&seen[i]) != 1) exactly_once = false;
+  }
+
+  printf("%d threads pushed %d values each\n", thread_count, count);
+  printf("Every value popped exactly once: %s\n", exactly_once ? "true" : "false");
+  printf("Stack empty at the end: %s\n\n", treiber_stack_is_empty(&stack) ? "true" : "false");
+
+  free(seen);
+  treiber_stack_free(&stack);
+}
+
+void run_tests() {
+  test_push_pop();
+
+  test_concurrent();
+
+}
+
+/**
+ * ===================================
+ * ||           Benchmarks          ||
+ * ===================================
+ */
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+typedef struct {
+  TreiberStack* treiber;
+  MutexStack* mutex;
+  int ops;
+} BenchContext;
+
+// Each thread does push/pop pairs so the stack stays small and every operation fights over the head
+
+void* bench_treiber_worker(void* arg) {
+  BenchContext* context = (BenchContext*) arg;
+  TreiberThread* thread = treiber_stack_register(context->treiber);
+  int popped;
+
+  if (thread == NULL) return NULL;
+
+  for (int i = 0; i < context->ops; i++) {
+    treiber_stack_push(context->treiber, thread, i);
+    treiber_stack_pop(context->treiber, thread, &popped);
+  }
+
+  return NULL;
+}
+
+void* bench_mutex_worker(void* arg) {
+  BenchContext* context = (BenchContext*) arg;
+  int popped;
+
+  for (int i = 0; i < context->ops; i++) {
+    mutex_stack_push(context->mutex, i);
+    mutex_stack_pop(context->mutex, &popped);
+  }
+
+  return NULL;
+}
+
+double bench_run(void* (*worker)(void*), BenchContext* context, int thread_count) {
+  pthread_t threads[MAX_THREADS];
+  struct timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < thread_count; i++) pthread_create(&threads[i], NULL, worker, context);
+  for (int i = 0; i < thread_count; i++) pthread_join(threads[i], NULL);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  return elapsed_seconds(start, end);
+}
+
+// BENCHMARK_SIZE push/pop pairs split over 1 to MAX_THREADS threads, in millions of operations a second
+
+void bench_contention() {
+  printf("==================\n");
+  printf("|| Contention   ||\n");
+  printf("==================\n\n");
+
+  printf("Threads   Treiber (Mops/s)   Mutex (Mops/s)\n");
+
+  for (int thread_count = 1; thread_count <= MAX_THREADS; thread_count *= 2) {
+    TreiberStack treiber;
+    MutexStack mutex;
+
+    if (!treiber_stack_initialize(&treiber)) return;
+    if (!stack_initialize(&mutex.stack, 0)) return;
+    pthread_mutex_init(&mutex.lock, NULL);
+
+    BenchContext context = { &treiber, &mutex, BENCHMARK_SIZE / thread_count };
+    double ops = 2.0 * context.ops * thread_count;
+
+    double treiber_time = bench_run(bench_treiber_worker, &context, thread_count);
+    double mutex_time = bench_run(bench_mutex_worker, &context, thread_count);
+
+    printf("%-9d %-18.2f %.2f\n", thread_count, ops / treiber_time / 1e6, ops / mutex_time / 1e6);
+
+    treiber_stack_free(&treiber);
+    stack_free(&mutex.stack);
+    pthread_mutex_destroy(&mutex.lock);
+  }
+
+  printf("\n");
+}
+
+void run_benchmarks() {
+  bench_contention();
+}
+
+int main() {
+  run_tests();
+
+  if (RUN_BENCHMARKS) run_benchmarks();
+
+  return 0;
+}
@@ -0,0 +1,417 @@
+/**
+ * *-------------------------------------*
+ * * Lock Free Stack (treiber-stack.h)   *
+ * *-------------------------------------*
+ *
+ * A Treiber stack - a linked list of nodes where push and pop are a single compare and swap on the head.
+ * There is no lock, so a thread that gets descheduled mid push/pop never holds anyone else up.
+ *
+ * Two things make the bare CAS loop unsafe and each has its own fix:
+ *
+ * - ABA -> A pop reads head = A and next = B, then stalls. Other threads pop A and B and push A back.
+ *          The stalled CAS still sees A and swings the head to B, which is no longer in the stack.
+ *          The head is a tagged pointer (pointer in the low 48 bits, a counter in the top 16) and every
+ *          successful CAS bumps the counter, so the stalled CAS sees a different tag and retries.
+ *
+ * - Reclamation -> A pop reads head->next after loading head. If another thread popped that node and reused it
+ *          (or freed it) in between, that read races with the new owner. A pop publishes the node it is about
+ *          to read in its thread's hazard pointer, and a popped node is only retired - it goes back to a pool
+ *          once no hazard pointer holds it (checked in batches by treiber_stack_scan(...)).
+ *
+ * Every thread that uses a stack calls treiber_stack_register(...) once and passes the handle it gets back
+ * to push/pop. The handle holds that thread's hazard pointer, its retired nodes and its node pool:
+ *
+ * - Push takes a node from the thread's own pool so the common case never touches shared memory
+ * - When the pool runs dry it takes a batch from the stack's shared pool (a mutex, once per TREIBER_POOL_BATCH nodes)
+ *   and only then mallocs a new chunk of nodes
+ * - A thread that only pops ends up with a big pool, past 2 * TREIBER_POOL_BATCH it hands a batch to the shared pool
+ *
+ * Nodes are only given back to the OS by treiber_stack_free(...), once no thread is using the stack.
+ *
+ * Compile with -pthread.
+ */
+
+#ifndef TREIBER_STACK_H
+#define TREIBER_STACK_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef TREIBER_POOL_BATCH
+#define TREIBER_POOL_BATCH 256
+#endif
+
+// Scan the hazard pointers once this many nodes are retired (or twice the number of threads, whichever is more)
+#ifndef TREIBER_RETIRE_THRESHOLD
+#define TREIBER_RETIRE_THRESHOLD 64
+#endif
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+#ifndef DEBUG_PRINT
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+// User space addresses on x86-64 and AArch64 fit in 48 bits, which leaves the top 16 for the tag
+#define TREIBER_TAG_SHIFT 48
+#define TREIBER_PTR_MASK ((UINT64_C(1) << TREIBER_TAG_SHIFT) - 1)
+
+typedef struct TreiberNode {
+  int data;
+  struct TreiberNode* next;
+} TreiberNode;
+
+typedef enum {
+  TREIBER_OK,
+  TREIBER_EMPTY,
+  TREIBER_CONTENDED,
+  TREIBER_NO_MEMORY
+} TreiberResult;
+
+typedef struct TreiberChunk {
+  struct TreiberChunk* next;
+  TreiberNode nodes[TREIBER_POOL_BATCH];
+} TreiberChunk;
+
+/**
+ * One per thread per stack. Only the owning thread writes to it, other threads only read hazard while scanning.
+ *
+ * - hazard -> The node this thread's pop is about to read (NULL otherwise)
+ * - pool -> Free nodes for this thread's pushes (linked through next)
+ * - retired -> Popped nodes waiting for no hazard pointer to hold them
+ * - chunks -> Every chunk this thread malloc'd, freed along with the stack
+ */
+
+typedef struct TreiberThread {
+  _Alignas(CACHE_LINE_SIZE) _Atomic(TreiberNode*) hazard;
+  TreiberNode* pool;
+  size_t pool_size;
+  TreiberNode** retired;
+  size_t retired_count;
+  size_t retired_capacity;
+  TreiberNode** hazards;
+  size_t hazards_capacity;
+  TreiberChunk* chunks;
+  struct TreiberThread* next_thread;
+} TreiberThread;
+
+typedef struct {
+  _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t head;
+  _Alignas(CACHE_LINE_SIZE) _Atomic(TreiberThread*) threads;
+  _Atomic size_t thread_count;
+  pthread_mutex_t pool_lock;
+  TreiberNode* shared_pool;
+  size_t shared_pool_size;
+} TreiberStack;
+
+static inline TreiberNode* treiber_ptr(uint64_t head) {
+  return (TreiberNode*) (uintptr_t) (head & TREIBER_PTR_MASK);
+}
+
+static inline uint64_t treiber_pack(TreiberNode* node, uint64_t old_head) {
+  uint64_t tag = (old_head >> TREIBER_TAG_SHIFT) + 1;
+  return (uint64_t) (uintptr_t) node | (tag << TREIBER_TAG_SHIFT);
+}
+
+static inline bool treiber_stack_initialize(TreiberStack* stack) {
+  atomic_init(&stack->head, 0);
+  atomic_init(&stack->threads, NULL);
+  atomic_init(&stack->thread_count, 0);
+  stack->shared_pool = NULL;
+  stack->shared_pool_size = 0;
+
+  if (pthread_mutex_init(&stack->pool_lock, NULL) != 0) {
+    DEBUG_PRINT("Error: Could not create the pool lock\n\n", NULL);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Frees every node, chunk and thread handle. No thread can be using the stack (or its handles) any more
+ *
+ * @param: stack -> The stack to free
+ */
+
+static inline void treiber_stack_free(TreiberStack* stack) {
+  TreiberThread* thread = atomic_load(&stack->threads);
+
+  while (thread != NULL) {
+    TreiberThread* next_thread = thread->next_thread;
+    TreiberChunk* chunk = thread->chunks;
+
+    while (chunk != NULL) {
+      TreiberChunk* next = chunk->next;
+      free(chunk);
+      chunk = next;
+    }
+
+    free(thread->retired);
+    free(thread->hazards);
+    free(thread);
+    thread = next_thread;
+  }
+
+  pthread_mutex_destroy(&stack->pool_lock);
+  treiber_stack_initialize(stack);
+}
+
+/**
+ * Gives the calling thread its handle for this stack. Call once per thread, the handle lives until treiber_stack_free(...)
+ *
+ * @param: stack -> The stack the thread is going to use
+ */
+
+static inline TreiberThread* treiber_stack_register(TreiberStack* stack) {
+  TreiberThread* thread = (TreiberThread*) aligned_alloc(CACHE_LINE_SIZE, sizeof(TreiberThread));
+
+  if (thread == NULL) {
+    DEBUG_PRINT("Error Allocating memory for a thread handle\n\n", NULL);
+    return NULL;
+  }
+
+  atomic_init(&thread->hazard, NULL);
+  thread->pool = NULL;
+  thread->pool_size = 0;
+  thread->retired = NULL;
+  thread->retired_count = 0;
+  thread->retired_capacity = 0;
+  thread->hazards = NULL;
+  thread->hazards_capacity = 0;
+  thread->chunks = NULL;
+
+  // The thread list only ever grows so a plain CAS push is safe here
+  TreiberThread* head = atomic_load(&stack->threads);
+  do {
+    thread->next_thread = head;
+  } while (!atomic_compare_exchange_weak(&stack->threads, &head, thread));
+
+  atomic_fetch_add(&stack->thread_count, 1);
+
+  return thread;
+}
+
+// Refill an empty pool - a batch from the shared pool if it has one, otherwise a new chunk
+
+static inline bool treiber_pool_refill(TreiberStack* stack, TreiberThread* thread) {
+  pthread_mutex_lock(&stack->pool_lock);
+
+  while (stack->shared_pool != NULL && thread->pool_size < TREIBER_POOL_BATCH) {
+    TreiberNode* node = stack->shared_pool;
+    stack->shared_pool = node->next;
+    stack->shared_pool_size--;
+
+    node->next = thread->pool;
+    thread->pool = node;
+    thread->pool_size++;
+  }
+
+  pthread_mutex_unlock(&stack->pool_lock);
+
+  if (thread->pool != NULL) return true;
+
+  TreiberChunk* chunk = (TreiberChunk*) malloc(sizeof(TreiberChunk));
+
+  if (chunk == NULL || ((uintptr_t) chunk + sizeof(TreiberChunk)) > TREIBER_PTR_MASK) {
+    DEBUG_PRINT("Error: Could not allocate taggable stack nodes\n\n", NULL);
+    free(chunk);
+    return false;
+  }
+
+  chunk->next = thread->chunks;
+  thread->chunks = chunk;
+
+  for (size_t i = 0; i < TREIBER_POOL_BATCH; i++) {
+    chunk->nodes[i].next = thread->pool;
+    thread->pool = &chunk->nodes[i];
+  }
+
+  thread->pool_size = TREIBER_POOL_BATCH;
+
+  return true;
+}
+
+// Give a free node back to the thread's pool, spilling a batch to the shared pool when it gets too big
+
+static inline void treiber_pool_release(TreiberStack* stack, TreiberThread* thread, TreiberNode* node) {
+  node->next = thread->pool;
+  thread->pool = node;
+  thread->pool_size++;
+
+  if (thread->pool_size < 2 * TREIBER_POOL_BATCH) return;
+
+  TreiberNode* first = thread->pool;
+  TreiberNode* last = first;
+
+  for (size_t i = 1; i < TREIBER_POOL_BATCH; i++) last = last->next;
+
+  thread->pool = last->next;
+  thread->pool_size -= TREIBER_POOL_BATCH;
+
+  pthread_mutex_lock(&stack->pool_lock);
+  last->next = stack->shared_pool;
+  stack->shared_pool = first;
+  stack->shared_pool_size += TREIBER_POOL_BATCH;
+  pthread_mutex_unlock(&stack->pool_lock);
+}
+
+/**
+ * Moves every retired node no hazard pointer holds back into the pool. At most one node per thread can still be
+ * held so with the scan threshold at twice the thread count at least half the retired nodes come back each time
+ *
+ * @param: stack -> The stack the nodes came from
+ * @param: thread -> The calling thread's handle
+ */
+
+static inline void treiber_stack_scan(TreiberStack* stack, TreiberThread* thread) {
+  size_t count = 0;
+
+  for (TreiberThread* other = atomic_load(&stack->threads); other != NULL; other = other->next_thread) {
+    TreiberNode* hazard = atomic_load(&other->hazard);
+    if (hazard == NULL) continue;
+
+    if (count == thread->hazards_capacity) {
+      size_t capacity = thread->hazards_capacity == 0 ? 16 : thread->hazards_capacity * 2;
+      TreiberNode** hazards = (TreiberNode**) realloc(thread->hazards, capacity * sizeof(TreiberNode*));
+
+      // Without room to record the hazards nothing can be proven safe, keep everything retired for now
+      if (hazards == NULL) return;
+
+      thread->hazards = hazards;
+      thread->hazards_capacity = capacity;
+    }
+
+    thread->hazards[count++] = hazard;
+  }
+
+  size_t kept = 0;
+
+  for (size_t i = 0; i < thread->retired_count; i++) {
+    TreiberNode* node = thread->retired[i];
+    bool held = false;
+
+    for (size_t j = 0; j < count && !held; j++) held = thread->hazards[j] == node;
+
+    if (held) {
+      thread->retired[kept++] = node;
+    } else {
+      treiber_pool_release(stack, thread, node);
+    }
+  }
+
+  thread->retired_count = kept;
+}
+
+static inline void treiber_stack_retire(TreiberStack* stack, TreiberThread* thread, TreiberNode* node) {
+  if (thread->retired_count == thread->retired_capacity) {
+    size_t capacity = thread->retired_capacity == 0 ? TREIBER_RETIRE_THRESHOLD : thread->retired_capacity * 2;
+    TreiberNode** retired = (TreiberNode**) realloc(thread->retired, capacity * sizeof(TreiberNode*));
+
+    // Leaking one node beats reusing it while another pop might still read it
+    if (retired == NULL) {
+      DEBUG_PRINT("Error: Could not retire a stack node\n\n", NULL);
+      return;
+    }
+
+    thread->retired = retired;
+    thread->retired_capacity = capacity;
+  }
+
+  thread->retired[thread->retired_count++] = node;
+
+  size_t threshold = 2 * atomic_load_explicit(&stack->thread_count, memory_order_relaxed);
+  if (threshold < TREIBER_RETIRE_THRESHOLD) threshold = TREIBER_RETIRE_THRESHOLD;
+
+  if (thread->retired_count >= threshold) treiber_stack_scan(stack, thread);
+}
+
+/**
+ * One push attempt - a single CAS on the head. TREIBER_CONTENDED means another thread moved the head first,
+ * which is where a caller can back off (or try elimination) before going again
+ *
+ * @param: stack -> The stack to push onto
+ * @param: thread -> The calling thread's handle from treiber_stack_register(...)
+ * @param: data -> The item to push
+ */
+
+static inline TreiberResult treiber_stack_try_push(TreiberStack* stack, TreiberThread* thread, int data) {
+  if (thread->pool == NULL && !treiber_pool_refill(stack, thread)) return TREIBER_NO_MEMORY;
+
+  TreiberNode* node = thread->pool;
+  uint64_t head = atomic_load_explicit(&stack->head, memory_order_relaxed);
+
+  thread->pool = node->next;
+  thread->pool_size--;
+  node->data = data;
+  node->next = treiber_ptr(head);
+
+  if (atomic_compare_exchange_strong_explicit(&stack->head, &head, treiber_pack(node, head),
+                                              memory_order_release, memory_order_relaxed)) return TREIBER_OK;
+
+  node->next = thread->pool;
+  thread->pool = node;
+  thread->pool_size++;
+
+  return TREIBER_CONTENDED;
+}
+
+/**
+ * One pop attempt - a single CAS on the head
+ *
+ * @param: stack -> The stack to pop from
+ * @param: thread -> The calling thread's handle from treiber_stack_register(...)
+ * @param: out -> Where to put the popped item
+ */
+
+static inline TreiberResult treiber_stack_try_pop(TreiberStack* stack, TreiberThread* thread, int* out) {
+  uint64_t head = atomic_load(&stack->head);
+  TreiberNode* node = treiber_ptr(head);
+
+  if (node == NULL) return TREIBER_EMPTY;
+
+  // Publish the hazard then check the head still points at it - if so, no scan from here on can miss it
+  atomic_store(&thread->hazard, node);
+
+  if (atomic_load(&stack->head) != head ||
+      !atomic_compare_exchange_strong_explicit(&stack->head, &head, treiber_pack(node->next, head),
+                                               memory_order_acquire, memory_order_relaxed)) {
+    atomic_store_explicit(&thread->hazard, NULL, memory_order_release);
+    return TREIBER_CONTENDED;
+  }
+
+  *out = node->data;
+  atomic_store_explicit(&thread->hazard, NULL, memory_order_release);
+  treiber_stack_retire(stack, thread, node);
+
+  return TREIBER_OK;
+}
+
+static inline bool treiber_stack_push(TreiberStack* stack, TreiberThread* thread, int data) {
+  TreiberResult result;
+
+  while ((result = treiber_stack_try_push(stack, thread, data)) == TREIBER_CONTENDED);
+
+  return result == TREIBER_OK;
+}
+
+// Returns false if the stack was empty
+
+static inline bool treiber_stack_pop(TreiberStack* stack, TreiberThread* thread, int* out) {
+  TreiberResult result;
+
+  while ((result = treiber_stack_try_pop(stack, thread, out)) == TREIBER_CONTENDED);
+
+  return result == TREIBER_OK;
+}
+
+static inline bool treiber_stack_is_empty(TreiberStack* stack) {
+  return treiber_ptr(atomic_load(&stack->head)) == NULL;
+}
+
+#endif
@@ -0,0 +1,364 @@
+/**
+ * *-------------------------------------*
+ * * Fork-Join Thread Pool (work-pool.h) *
+ * *-------------------------------------*
+ *
+ * A pool of worker threads, each with its own Chase-Lev deque (work-stealing-deque.h), for divide and conquer code:
+ *
+ * - work_pool_spawn(&task, fn, arg) -> Push a task onto the calling worker's deque. Some idle worker may steal it
+ * - work_pool_sync(&task) -> Wait for a spawned task. While it waits the worker pops its own deque and steals from
+ *                            others, so a waiting worker is never idle and nested spawns can't deadlock
+ * - work_pool_run(pool, fn, arg) -> Run fn(arg) on the pool, the calling thread joins in as worker 0
+ * - work_pool_parallel_for(pool, fn, context, count, grain) -> fn(context, 0) ... fn(context, count - 1), split in
+ *                                                                halves down to grain indices a task
+ *
+ * A worker pushes and pops its own bottom and only touches another deque to steal from the top, so in the common case
+ * (nobody idle) spawn and sync are a store and a fence on memory no other thread is using. Tasks are stolen oldest
+ * first, and in divide and conquer the oldest task is the biggest piece of work left, so one steal moves a lot of work.
+ *
+ * A task lives in the spawner's stack frame, so every work_pool_spawn(...) must be matched by a work_pool_sync(...)
+ * before the function that spawned it returns. Spawn and sync only work on a pool's threads (inside work_pool_run(...)),
+ * anywhere else the task just runs on the spot.
+ *
+ * Idle workers spin, then yield, and sleep on a condition variable whenever no work_pool_run(...) is in progress.
+ *
+ * Compile with -pthread.
+ */
+
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "work-stealing-deque.h"
+
+#ifndef WORK_POOL_DEQUE_CAPACITY
+#define WORK_POOL_DEQUE_CAPACITY 64
+#endif
+
+// How many failed rounds of stealing before an idle worker gives the core up
+#ifndef WORK_POOL_SPINS
+#define WORK_POOL_SPINS 64
+#endif
+
+#ifndef DEBUG_PRINT
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+typedef void (*WorkFn)(void* arg);
+
+// What work_pool_parallel_for(...) calls, the same shape as the heap's HeapTaskFn
+typedef void (*WorkRangeFn)(void* context, size_t index);
+
+typedef struct {
+  WorkFn fn;
+  void* arg;
+  _Atomic bool done;
+} WorkTask;
+
+struct WorkPool;
+
+typedef struct {
+  ChaseLevDeque deque;
+  struct WorkPool* pool;
+  size_t index;
+  uint64_t seed;
+  pthread_t thread;
+} WorkWorker;
+
+typedef struct WorkPool {
+  WorkWorker* workers;
+  size_t worker_count;
+  size_t started;
+  _Atomic bool stop;
+  _Atomic bool running;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_mutex_t run_lock;
+} WorkPool;
+
+// The worker the calling thread is, NULL on threads that aren't in a pool
+static _Thread_local WorkWorker* work_pool_current = NULL;
+
+static inline void work_pool_backoff(int* spins) {
+  if (++*spins < WORK_POOL_SPINS) return;
+
+  *spins = 0;
+  sched_yield();
+}
+
+static inline void work_pool_execute(WorkTask* task) {
+  task->fn(task->arg);
+
+  // Release so the thread that syncs on the task sees everything the task wrote
+  atomic_store_explicit(&task->done, true, memory_order_release);
+}
+
+// xorshift64 - picks the next victim to steal from
+
+static inline size_t work_pool_random_victim(WorkWorker* worker) {
+  worker->seed ^= worker->seed << 13;
+  worker->seed ^= worker->seed >> 7;
+  worker->seed ^= worker->seed << 17;
+
+  return (size_t) (worker->seed % worker->pool->worker_count);
+}
+
+/**
+ * One pass over the other workers, starting from a random one, stealing the first task it can
+ *
+ * @param: worker -> The worker looking for work
+ *
+ * Returns NULL if every deque looked empty
+ */
+
+static inline WorkTask* work_pool_steal(WorkWorker* worker) {
+  WorkPool* pool = worker->pool;
+  size_t start = work_pool_random_victim(worker);
+
+  for (size_t i = 0; i < pool->worker_count; i++) {
+    WorkWorker* victim = &pool->workers[(start + i) % pool->worker_count];
+    void* task;
+
+    if (victim == worker) continue;
+
+    // An abort means someone else just won that task, there may be more behind it so try the same victim again
+    ChaseLevResult result;
+    while ((result = chase_lev_deque_steal(&victim->deque, &task)) == CHASE_LEV_ABORT);
+
+    if (result == CHASE_LEV_OK) return (WorkTask*) task;
+  }
+
+  return NULL;
+}
+
+static inline void* work_pool_worker_loop(void* arg) {
+  WorkWorker* worker = (WorkWorker*) arg;
+  WorkPool* pool = worker->pool;
+  int spins = 0;
+
+  work_pool_current = worker;
+
+  while (!atomic_load_explicit(&pool->stop, memory_order_acquire)) {
+    if (!atomic_load_explicit(&pool->running, memory_order_acquire)) {
+      pthread_mutex_lock(&pool->lock);
+      while (!atomic_load(&pool->running) && !atomic_load(&pool->stop)) pthread_cond_wait(&pool->wake, &pool->lock);
+      pthread_mutex_unlock(&pool->lock);
+      continue;
+    }
+
+    WorkTask* task = work_pool_steal(worker);
+
+    if (task == NULL) {
+      work_pool_backoff(&spins);
+      continue;
+    }
+
+    spins = 0;
+    work_pool_execute(task);
+  }
+
+  return NULL;
+}
+
+/**
+ * Starts threads - 1 workers, the thread that calls work_pool_run(...) is the last one. If some threads can't be
+ * started the pool carries on with the ones that did
+ *
+ * @param: pool -> The pool to set up
+ * @param: threads -> How many threads should work, including the caller of work_pool_run(...)
+ */
+
+static inline bool work_pool_initialize(WorkPool* pool, size_t threads) {
+  if (threads == 0) threads = 1;
+
+  pool->workers = (WorkWorker*) aligned_alloc(CACHE_LINE_SIZE, threads * sizeof(WorkWorker));
+
+  if (pool->workers == NULL) {
+    DEBUG_PRINT("Error Allocating memory for the workers\n\n", NULL);
+    return false;
+  }
+
+  pool->worker_count = 0;
+  pool->started = 1;
+  atomic_init(&pool->stop, false);
+  atomic_init(&pool->running, false);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_mutex_init(&pool->run_lock, NULL);
+
+  for (size_t i = 0; i < threads; i++) {
+    WorkWorker* worker = &pool->workers[i];
+
+    if (!chase_lev_deque_initialize(&worker->deque, WORK_POOL_DEQUE_CAPACITY)) break;
+
+    worker->pool = pool;
+    worker->index = i;
+    worker->seed = 0x9E3779B97F4A7C15ULL * (i + 1);
+    pool->worker_count = i + 1;
+  }
+
+  if (pool->worker_count == 0) {
+    free(pool->workers);
+    return false;
+  }
+
+  // Worker 0 is whoever calls work_pool_run(...)
+  while (pool->started < pool->worker_count) {
+    WorkWorker* worker = &pool->workers[pool->started];
+    if (pthread_create(&worker->thread, NULL, work_pool_worker_loop, worker) != 0) break;
+    pool->started += 1;
+  }
+
+  if (pool->started < pool->worker_count) {
+    DEBUG_PRINT("Could only start %zu worker threads\n", pool->started - 1);
+  }
+
+  return true;
+}
+
+// Stops and joins the workers. No work_pool_run(...) can be in progress
+
+static inline void work_pool_free(WorkPool* pool) {
+  pthread_mutex_lock(&pool->lock);
+  atomic_store(&pool->stop, true);
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (size_t i = 1; i < pool->started; i++) pthread_join(pool->workers[i].thread, NULL);
+  for (size_t i = 0; i < pool->worker_count; i++) chase_lev_deque_free(&pool->workers[i].deque);
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->run_lock);
+  free(pool->workers);
+
+  pool->workers = NULL;
+  pool->worker_count = 0;
+  pool->started = 0;
+}
+
+/**
+ * Pushes a task onto the calling worker's deque. Off the pool (or if the deque can't grow) it runs straight away
+ *
+ * @param: task -> Somewhere for the task to live until work_pool_sync(task) returns
+ * @param: fn -> What to run
+ * @param: arg -> Passed to fn
+ */
+
+static inline void work_pool_spawn(WorkTask* task, WorkFn fn, void* arg) {
+  task->fn = fn;
+  task->arg = arg;
+  atomic_store_explicit(&task->done, false, memory_order_relaxed);
+
+  WorkWorker* worker = work_pool_current;
+
+  if (worker == NULL || !chase_lev_deque_push(&worker->deque, task)) work_pool_execute(task);
+}
+
+/**
+ * Waits for a spawned task to finish. If nobody stole it, it is at the bottom of our own deque and we just run it.
+ * Otherwise we run whatever we can pop or steal until the thief is done
+ *
+ * @param: task -> A task from work_pool_spawn(...) on this thread
+ */
+
+static inline void work_pool_sync(WorkTask* task) {
+  WorkWorker* worker = work_pool_current;
+  int spins = 0;
+
+  while (!atomic_load_explicit(&task->done, memory_order_acquire)) {
+    void* next = NULL;
+
+    if (worker != NULL && !chase_lev_deque_pop(&worker->deque, &next)) next = work_pool_steal(worker);
+
+    if (next == NULL) {
+      work_pool_backoff(&spins);
+      continue;
+    }
+
+    spins = 0;
+    work_pool_execute((WorkTask*) next);
+  }
+}
+
+/**
+ * Runs fn(arg) with the calling thread as worker 0 and the rest of the pool stealing whatever it spawns. Calls from
+ * other threads wait their turn, and a call from inside the pool just runs fn(arg)
+ *
+ * @param: pool -> The pool to run on
+ * @param: fn -> The root task
+ * @param: arg -> Passed to fn
+ */
+
+static inline void work_pool_run(WorkPool* pool, WorkFn fn, void* arg) {
+  if (work_pool_current != NULL && work_pool_current->pool == pool) {
+    fn(arg);
+    return;
+  }
+
+  WorkWorker* outer = work_pool_current;
+
+  pthread_mutex_lock(&pool->run_lock);
+  work_pool_current = &pool->workers[0];
+
+  pthread_mutex_lock(&pool->lock);
+  atomic_store(&pool->running, true);
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  fn(arg);
+
+  atomic_store(&pool->running, false);
+  work_pool_current = outer;
+  pthread_mutex_unlock(&pool->run_lock);
+}
+
+typedef struct {
+  WorkRangeFn fn;
+  void* context;
+  size_t begin;
+  size_t end;
+  size_t grain;
+} WorkRange;
+
+// Spawn the first half, do the second half ourselves, then sync - a thief takes the biggest half still waiting
+
+static inline void work_pool_range(void* arg) {
+  WorkRange* range = (WorkRange*) arg;
+
+  if (range->end - range->begin <= range->grain) {
+    for (size_t i = range->begin; i < range->end; i++) range->fn(range->context, i);
+    return;
+  }
+
+  size_t middle = range->begin + (range->end - range->begin) / 2;
+  WorkRange first = { range->fn, range->context, range->begin, middle, range->grain };
+  WorkRange second = { range->fn, range->context, middle, range->end, range->grain };
+  WorkTask task;
+
+  work_pool_spawn(&task, work_pool_range, &first);
+  work_pool_range(&second);
+  work_pool_sync(&task);
+}
+
+/**
+ * @param: pool -> The pool to run on
+ * @param: fn -> Called once for every index, calls must not touch the same memory
+ * @param: context -> Passed to every call of fn
+ * @param: count -> The number of indices
+ * @param: grain -> The most indices one task runs in a row (0 is taken as 1)
+ */
+
+static inline void work_pool_parallel_for(WorkPool* pool, WorkRangeFn fn, void* context, size_t count, size_t grain) {
+  WorkRange range = { fn, context, 0, count, grain == 0 ? 1 : grain };
+
+  work_pool_run(pool, work_pool_range, &range);
+}
+
+#endif
@@ -0,0 +1,474 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: The deque is in work-stealing-deque.h and the fork-join pool on top of it in work-pool.h,
+//        this file tests both and benchmarks them
+//  NOTE: Build with gcc -O2 -pthread work-stealing-deque.c
+
+#include "work-stealing-deque.h"
+#include "work-pool.h"
+#include "../circular-queue/circular-queue.h"
+
+#define THIEVES 3
+#define POOL_THREADS 4
+#define MAX_THREADS 8
+
+// Below this depth/ n the fork-join tests and benchmarks stop spawning and just recurse
+#define TREE_DEPTH 20
+#define SERIAL_DEPTH 8
+#define FIB_N 35
+#define FIB_CUTOFF 16
+
+// Spin a little then give the core up - with fewer cores than threads the other side can't run until we do
+
+static inline void wait_for_other_side(int* spins) {
+  if (++*spins < 64) return;
+
+  *spins = 0;
+  sched_yield();
+}
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// The items in the deque tests are just numbers - 0 would look like NULL so they start at 1
+
+static inline void* as_item(size_t n) {
+  return (void*) (uintptr_t) (n + 1);
+}
+
+static inline size_t from_item(void* item) {
+  return (size_t) (uintptr_t) item - 1;
+}
+
+/**
+ * ===================================
+ * ||        Fork-Join Helpers      ||
+ * ===================================
+ */
+
+typedef struct {
+  int n;
+  long long result;
+} FibTask;
+
+long long fib_serial(int n) {
+  return n < 2 ? n : fib_serial(n - 1) + fib_serial(n - 2);
+}
+
+void fib_parallel(void* arg) {
+  FibTask* fib = (FibTask*) arg;
+
+  if (fib->n < FIB_CUTOFF) {
+    fib->result = fib_serial(fib->n);
+    return;
+  }
+
+  FibTask first = { fib->n - 1, 0 };
+  FibTask second = { fib->n - 2, 0 };
+  WorkTask task;
+
+  work_pool_spawn(&task, fib_parallel, &first);
+  fib_parallel(&second);
+  work_pool_sync(&task);
+
+  fib->result = first.result + second.result;
+}
+
+typedef struct TreeNode {
+  struct TreeNode* left;
+  struct TreeNode* right;
+  int data;
+} TreeNode;
+
+// A complete binary tree of the given depth, numbered in preorder from *next
+
+TreeNode* tree_build(int depth, int* next) {
+  if (depth == 0) return NULL;
+
+  TreeNode* node = (TreeNode*) malloc(sizeof(TreeNode));
+  if (node == NULL) return NULL;
+
+  node->data = (*next)++;
+  node->left = tree_build(depth - 1, next);
+  node->right = tree_build(depth - 1, next);
+
+  return node;
+}
+
+void tree_free(TreeNode* node) {
+  if (node == NULL) return;
+
+  tree_free(node->left);
+  tree_free(node->right);
+  free(node);
+}
+
+long long tree_sum_serial(TreeNode* node) {
+  if (node == NULL) return 0;
+
+  return node->data + tree_sum_serial(node->left) + tree_sum_serial(node->right);
+}
+
+typedef struct {
+  TreeNode* node;
+  int depth;
+  long long result;
+} TreeSumTask;
+
+// Sum the left subtree as a task and the right one ourselves, the way a parallel tree fold would
+
+void tree_sum_parallel(void* arg) {
+  TreeSumTask* sum = (TreeSumTask*) arg;
+
+  if (sum->node == NULL || sum->depth >= SERIAL_DEPTH) {
+    sum->result = tree_sum_serial(sum->node);
+    return;
+  }
+
+  TreeSumTask left = { sum->node->left, sum->depth + 1, 0 };
+  TreeSumTask right = { sum->node->right, sum->depth + 1, 0 };
+  WorkTask task;
+
+  work_pool_spawn(&task, tree_sum_parallel, &left);
+  tree_sum_parallel(&right);
+  work_pool_sync(&task);
+
+  sum->result = sum->node->data + left.result + right.result;
+}
+
+/**
+ * ===================================
+ * ||             Tests             ||
+ * ===================================
+ */
+
+void test_owner() {
+  printf("==================\n");
+  printf("|| Owner Only   ||\n");
+  printf("==================\n\n");
+
+  ChaseLevDeque deque;
+  if (!chase_lev_deque_initialize(&deque, 0)) return;
+
+  int count = 1000;
+  void* item;
+  bool matched = true;
+
+  for (int i = 0; i < count; i++) chase_lev_deque_push(&deque, as_item(i));
+
+  printf("Pushed %d, grew from %d to %zu slots\n", count, CHASE_LEV_MIN_CAPACITY, atomic_load(&deque.ring)->capacity);
+
+  // Pop from the bottom comes out newest first
+  for (int i = count - 1; i >= 0; i--) {
+    if (!chase_lev_deque_pop(&deque, &item) || from_item(item) != (size_t) i) matched = false;
+  }
+
+  printf("Popped in LIFO order: %s\n", matched ? "true" : "false");
+  printf("Pop from empty fails: %s\n", chase_lev_deque_pop(&deque, &item) ? "false" : "true");
+
+  // Steal from the top comes out oldest first
+  for (int i = 0; i < count; i++) chase_lev_deque_push(&deque, as_item(i));
+
+  matched = true;
+  for (int i = 0; i < count; i++) {
+    if (chase_lev_deque_steal(&deque, &item) != CHASE_LEV_OK || from_item(item) != (size_t) i) matched = false;
+  }
+
+  printf("Stolen in FIFO order: %s\n", matched ? "true" : "false");
+  printf("Steal from empty is CHASE_LEV_EMPTY: %s\n\n", chase_lev_deque_steal(&deque, &item) == CHASE_LEV_EMPTY ? "true" : "false");
+
+  chase_lev_deque_free(&deque);
+}
+
+typedef struct {
+  ChaseLevDeque* deque;
+  _Atomic int* seen;
+  _Atomic bool* finished;
+  size_t taken;
+} ThiefContext;
+
+void* thief(void* arg) {
+  ThiefContext* context = (ThiefContext*) arg;
+  int spins = 0;
+  void* item;
+
+  while (true) {
+    ChaseLevResult result = chase_lev_deque_steal(context->deque, &item);
+
+    if (result == CHASE_LEV_OK) {
+      atomic_fetch_add(&context->seen[from_item(item)], 1);
+      context->taken++;
+      continue;
+    }
+
+    if (result == CHASE_LEV_EMPTY) {
+      if (atomic_load(context->finished)) return NULL;
+      wait_for_other_side(&spins);
+    }
+  }
+}
+
+// The owner pushes BENCHMARK_SIZE items and pops some back as it goes while THIEVES threads steal from the top.
+// Every item has to be taken exactly once, either by the owner or by one thief
+
+void test_stealing() {
+  printf("==================\n");
+  printf("|| Stealing     ||\n");
+  printf("==================\n\n");
+
+  ChaseLevDeque deque;
+  _Atomic int* seen = (_Atomic int*) calloc(BENCHMARK_SIZE, sizeof(_Atomic int));
+  _Atomic bool finished = false;
+  pthread_t threads[THIEVES];
+  ThiefContext contexts[THIEVES];
+  size_t owner_taken = 0;
+  void* item;
+
+  if (seen == NULL || !chase_lev_deque_initialize(&deque, 0)) return;
+
+  for (int i = 0; i < THIEVES; i++) {
+    contexts[i] = (ThiefContext) { &deque, seen, &finished, 0 };
+    pthread_create(&threads[i], NULL, thief, &contexts[i]);
+  }
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    chase_lev_deque_push(&deque, as_item(i));
+
+    // Pop every third item straight back so the owner and the thieves keep meeting over the last item
+    if (i % 3 == 2 && chase_lev_deque_pop(&deque, &item)) {
+      atomic_fetch_add(&seen[from_item(item)], 1);
+      owner_taken++;
+    }
+  }
+
+  while (chase_lev_deque_pop(&deque, &item)) {
+    atomic_fetch_add(&seen[from_item(item)], 1);
+    owner_taken++;
+  }
+
+  atomic_store(&finished, true);
+  for (int i = 0; i < THIEVES; i++) pthread_join(threads[i], NULL);
+
+  bool exactly_once = true;
+  size_t stolen = 0;
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    if (atomic_load(&seen[i]) != 1) exactly_once = false;
+  }
+  for (int i = 0; i < THIEVES; i++) stolen += contexts[i].taken;
+
+  printf("Owner took %zu, %d thieves stole %zu\n", owner_taken, THIEVES, stolen);
+  printf("Every item taken exactly once: %s\n\n", exactly_once ? "true" : "false");
+
+  free(seen);
+  chase_lev_deque_free(&deque);
+}
+
+typedef struct {
+  _Atomic int* seen;
+} ForContext;
+
+void mark_index(void* context, size_t index) {
+  atomic_fetch_add(&((ForContext*) context)->seen[index], 1);
+}
+
+// A parallel for run from inside a running task - has to run inline on the same pool rather than wait for itself
+
+typedef struct {
+  WorkPool* pool;
+  ForContext* context;
+  size_t count;
+} NestedContext;
+
+void nested_for(void* arg) {
+  NestedContext* nested = (NestedContext*) arg;
+
+  work_pool_parallel_for(nested->pool, mark_index, nested->context, nested->count, 16);
+}
+
+void test_fork_join() {
+  printf("==================\n");
+  printf("|| Fork-Join    ||\n");
+  printf("==================\n\n");
+
+  WorkPool pool;
+  if (!work_pool_initialize(&pool, POOL_THREADS)) return;
+
+  FibTask fib = { 25, 0 };
+  work_pool_run(&pool, fib_parallel, &fib);
+  printf("fib(25) on %d threads: %lld (serial %lld)\n", POOL_THREADS, fib.result, fib_serial(25));
+
+  int next = 0;
+  TreeNode* root = tree_build(16, &next);
+  TreeSumTask sum = { root, 0, 0 };
+
+  work_pool_run(&pool, tree_sum_parallel, &sum);
+  printf("Sum of a %d node tree: %lld (serial %lld)\n", next, sum.result, tree_sum_serial(root));
+  tree_free(root);
+
+  size_t count = 100000;
+  _Atomic int* seen = (_Atomic int*) calloc(count, sizeof(_Atomic int));
+  ForContext context = { seen };
+  bool exactly_once = true;
+
+  if (seen == NULL) return;
+
+  work_pool_parallel_for(&pool, mark_index, &context, count, 64);
+
+  NestedContext nested = { &pool, &context, count };
+  work_pool_run(&pool, nested_for, &nested);
+
+  for (size_t i = 0; i < count; i++) {
+    if (atomic_load(&seen[i]) != 2) exactly_once = false;
+  }
+
+  printf("parallel_for (and again nested in a task) hit every index once: %s\n\n", exactly_once ? "true" : "false");
+
+  free(seen);
+  work_pool_free(&pool);
+}
+
+void run_tests() {
+  test_owner();
+
+  test_stealing();
+
+  test_fork_join();
+
+}
+
+/**
+ * ===================================
+ * ||           Benchmarks          ||
+ * ===================================
+ */
+
+// BENCHMARK_SIZE pushes then BENCHMARK_SIZE pops on the owner's side, against the same ring with no atomics
+
+void bench_owner() {
+  printf("==================\n");
+  printf("|| Owner Ops    ||\n");
+  printf("==================\n\n");
+
+  ChaseLevDeque deque;
+  CircularQueue queue;
+  struct timespec start, end;
+  void* item;
+  int out;
+  size_t checksum = 0;
+
+  if (!chase_lev_deque_initialize(&deque, BENCHMARK_SIZE)) return;
+  if (!circular_queue_initialize(&queue, BENCHMARK_SIZE)) return;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) chase_lev_deque_push(&deque, as_item(i));
+  while (chase_lev_deque_pop(&deque, &item)) checksum += from_item(item);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double deque_time = elapsed_seconds(start, end);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < BENCHMARK_SIZE; i++) circular_queue_enqueue(&queue, i);
+  while (circular_queue_size(&queue) > 0) {
+    circular_queue_dequeue(&queue, &out);
+    checksum += (size_t) out;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double queue_time = elapsed_seconds(start, end);
+
+  printf("Chase-Lev push + pop:     %.2f ms\n", deque_time * 1e3);
+  printf("CircularQueue (no atomics): %.2f ms\n", queue_time * 1e3);
+  printf("(checksum %zu)\n\n", checksum);
+
+  chase_lev_deque_free(&deque);
+  circular_queue_free(&queue);
+}
+
+// fib(FIB_N) and a sum over a 2^TREE_DEPTH node tree, serially and on pools of 1 to MAX_THREADS threads
+
+void bench_fork_join() {
+  printf("==================\n");
+  printf("|| Fork-Join    ||\n");
+  printf("==================\n\n");
+
+  struct timespec start, end;
+  int next = 0;
+  TreeNode* root = tree_build(TREE_DEPTH, &next);
+
+  // One pass first so every run below starts with the tree just as warm
+  long long tree_result = tree_sum_serial(root);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  long long fib_result = fib_serial(FIB_N);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double fib_time = elapsed_seconds(start, end);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  tree_result = tree_sum_serial(root);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double tree_time = elapsed_seconds(start, end);
+
+  printf("Threads   fib(%d) (ms)   Tree sum (ms)\n", FIB_N);
+  printf("serial    %-14.2f %.2f\n", fib_time * 1e3, tree_time * 1e3);
+
+  for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+    WorkPool pool;
+    if (!work_pool_initialize(&pool, (size_t) threads)) break;
+
+    FibTask fib = { FIB_N, 0 };
+    TreeSumTask sum = { root, 0, 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    work_pool_run(&pool, fib_parallel, &fib);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fib_time = elapsed_seconds(start, end);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    work_pool_run(&pool, tree_sum_parallel, &sum);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    tree_time = elapsed_seconds(start, end);
+
+    if (fib.result != fib_result || sum.result != tree_result) printf("Results differ from the serial run!\n");
+
+    printf("%-9d %-14.2f %.2f\n", threads, fib_time * 1e3, tree_time * 1e3);
+
+    work_pool_free(&pool);
+  }
+
+  printf("\n");
+  tree_free(root);
+}
+
+void run_benchmarks() {
+  bench_owner();
+
+  bench_fork_join();
+}
+
+int main() {
+  run_tests();
+
+  if (RUN_BENCHMARKS) run_benchmarks();
+
+  return 0;
+}
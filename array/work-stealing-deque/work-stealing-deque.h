@@ -0,0 +1,255 @@
+/**
+ * *----------------------------------------------*
+ * * Work Stealing Deque (work-stealing-deque.h)  *
+ * *----------------------------------------------*
+ *
+ * A Chase-Lev deque - one owner thread pushes and pops tasks at the bottom, any number of thieves steal from the top.
+ * It's the circular queue's ring again (power of two capacity, free running counters, the slot for a counter is
+ * counter & mask) with bottom playing tail and top playing head:
+ *
+ * - Push -> Only the owner writes bottom, so it's a plain store of the item and then bottom + 1 with release. No CAS
+ * - Pop -> The owner takes bottom - 1 back first, then reads top. Only when that leaves exactly one item can a thief be
+ *          after the same item, and only then does the owner CAS top to settle who gets it
+ * - Steal -> Read top then bottom. If there's an item, CAS top to top + 1 - losing means another thief (or the owner
+ *            taking the last item) got it, and the steal reports CHASE_LEV_ABORT so the thief can look elsewhere
+ *
+ * The pop needs a full fence between taking bottom back and reading top (and the steal between reading top and
+ * bottom), otherwise both sides could see the old value of the other's counter and take the same last item.
+ *
+ * A full deque grows to double the capacity like the circular queue, but thieves can still be reading the old ring, so
+ * it isn't freed - the old rings are kept on a list and freed by chase_lev_deque_free(...). Growing only happens when
+ * the deque is full and rings double each time, so all the old rings together are smaller than the current one.
+ *
+ * The items are void* (a task, in work-pool.h). Compile with -pthread if thieves run on other threads.
+ */
+
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef CHASE_LEV_MIN_CAPACITY
+#define CHASE_LEV_MIN_CAPACITY 8
+#endif
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+#ifndef DEBUG_PRINT
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+typedef enum {
+  CHASE_LEV_OK,
+  CHASE_LEV_EMPTY,
+  CHASE_LEV_ABORT
+} ChaseLevResult;
+
+// The slots are atomic only so a thief reading a slot the owner is overwriting (one lap later) isn't a data race -
+// the thief's CAS on top fails in that case and it never uses what it read
+
+typedef struct ChaseLevRing {
+  size_t capacity;
+  size_t mask;
+  struct ChaseLevRing* previous;
+  _Atomic(void*) items[];
+} ChaseLevRing;
+
+typedef struct {
+  // Thieves' line
+  _Alignas(CACHE_LINE_SIZE) _Atomic int64_t top;
+
+  // Owner's line - thieves read bottom and ring but only the owner writes them
+  _Alignas(CACHE_LINE_SIZE) _Atomic int64_t bottom;
+  _Atomic(ChaseLevRing*) ring;
+} ChaseLevDeque;
+
+static inline ChaseLevRing* chase_lev_ring_allocate(size_t capacity) {
+  if (capacity > (SIZE_MAX - sizeof(ChaseLevRing)) / sizeof(void*)) return NULL;
+
+  ChaseLevRing* ring = (ChaseLevRing*) malloc(sizeof(ChaseLevRing) + capacity * sizeof(void*));
+  if (ring == NULL) return NULL;
+
+  ring->capacity = capacity;
+  ring->mask = capacity - 1;
+  ring->previous = NULL;
+
+  return ring;
+}
+
+/**
+ * @param: deque -> The deque to set up (before any thread uses it)
+ * @param: capacity -> How many items to make room for up front (rounded up to a power of two)
+ */
+
+static inline bool chase_lev_deque_initialize(ChaseLevDeque* deque, size_t capacity) {
+  size_t rounded = CHASE_LEV_MIN_CAPACITY;
+
+  while (rounded < capacity) {
+    if (rounded > SIZE_MAX / 2) return false;
+    rounded *= 2;
+  }
+
+  ChaseLevRing* ring = chase_lev_ring_allocate(rounded);
+
+  if (ring == NULL) {
+    DEBUG_PRINT("Error Allocating memory for the deque\n\n", NULL);
+    return false;
+  }
+
+  atomic_init(&deque->top, 0);
+  atomic_init(&deque->bottom, 0);
+  atomic_init(&deque->ring, ring);
+
+  return true;
+}
+
+// Frees the ring and every ring it grew out of. No thread can be using the deque any more
+
+static inline void chase_lev_deque_free(ChaseLevDeque* deque) {
+  ChaseLevRing* ring = atomic_load(&deque->ring);
+
+  while (ring != NULL) {
+    ChaseLevRing* previous = ring->previous;
+    free(ring);
+    ring = previous;
+  }
+
+  atomic_store(&deque->ring, NULL);
+  atomic_store(&deque->top, 0);
+  atomic_store(&deque->bottom, 0);
+}
+
+// A snapshot, exact only when called by the owner with no thieves about
+
+static inline size_t chase_lev_deque_size(ChaseLevDeque* deque) {
+  int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+  int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+  return bottom > top ? (size_t) (bottom - top) : 0;
+}
+
+/**
+ * Owner only. Copies top ... bottom - 1 into a ring twice the size - the same counters land in different slots once
+ * the mask changes, so it's a slot by slot copy rather than the circular queue's two memcpys
+ */
+
+static inline ChaseLevRing* chase_lev_deque_grow(ChaseLevDeque* deque, ChaseLevRing* ring, int64_t top, int64_t bottom) {
+  if (ring->capacity > SIZE_MAX / 2) return NULL;
+
+  ChaseLevRing* grown = chase_lev_ring_allocate(ring->capacity * 2);
+
+  if (grown == NULL) {
+    DEBUG_PRINT("Error reallocating the deque to %zu slots\n", ring->capacity * 2);
+    return NULL;
+  }
+
+  for (int64_t i = top; i < bottom; i++) {
+    void* item = atomic_load_explicit(&ring->items[(size_t) i & ring->mask], memory_order_relaxed);
+    atomic_store_explicit(&grown->items[(size_t) i & grown->mask], item, memory_order_relaxed);
+  }
+
+  grown->previous = ring;
+
+  // Release so a thief that loads the new ring sees the copied items
+  atomic_store_explicit(&deque->ring, grown, memory_order_release);
+
+  return grown;
+}
+
+/**
+ * Owner only. Returns false only if the deque was full and couldn't grow
+ *
+ * @param: deque -> The owner's deque
+ * @param: item -> The item to push on the bottom
+ */
+
+static inline bool chase_lev_deque_push(ChaseLevDeque* deque, void* item) {
+  int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+  int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+  ChaseLevRing* ring = atomic_load_explicit(&deque->ring, memory_order_relaxed);
+
+  if ((size_t) (bottom - top) >= ring->capacity) {
+    ring = chase_lev_deque_grow(deque, ring, top, bottom);
+    if (ring == NULL) return false;
+  }
+
+  atomic_store_explicit(&ring->items[(size_t) bottom & ring->mask], item, memory_order_relaxed);
+
+  // Release so a thief that reads the new bottom (acquire) sees the item and whatever it points at
+  atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+
+  return true;
+}
+
+/**
+ * Owner only. Takes the most recently pushed item. Returns false if the deque is empty (or a thief got the last item)
+ *
+ * @param: deque -> The owner's deque
+ * @param: out -> Where to put the item
+ */
+
+static inline bool chase_lev_deque_pop(ChaseLevDeque* deque, void** out) {
+  int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+  ChaseLevRing* ring = atomic_load_explicit(&deque->ring, memory_order_relaxed);
+
+  // Claim the bottom item before looking at top, a thief that reads top after this will see the smaller bottom
+  atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+
+  int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+  if (top > bottom) {
+    // Empty - put bottom back
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return false;
+  }
+
+  void* item = atomic_load_explicit(&ring->items[(size_t) bottom & ring->mask], memory_order_relaxed);
+
+  if (top == bottom) {
+    // The last item - a thief could be after it too, whoever moves top first gets it
+    bool won = atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                       memory_order_seq_cst, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+
+    if (!won) return false;
+  }
+
+  *out = item;
+
+  return true;
+}
+
+/**
+ * Any thread. Takes the oldest item
+ *
+ * @param: deque -> The deque to steal from
+ * @param: out -> Where to put the item
+ *
+ * Returns CHASE_LEV_EMPTY if there was nothing to take and CHASE_LEV_ABORT if another thread took it first
+ */
+
+static inline ChaseLevResult chase_lev_deque_steal(ChaseLevDeque* deque, void** out) {
+  int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+  if (top >= bottom) return CHASE_LEV_EMPTY;
+
+  ChaseLevRing* ring = atomic_load_explicit(&deque->ring, memory_order_acquire);
+  void* item = atomic_load_explicit(&ring->items[(size_t) top & ring->mask], memory_order_relaxed);
+
+  if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                               memory_order_seq_cst, memory_order_relaxed)) return CHASE_LEV_ABORT;
+
+  *out = item;
+
+  return CHASE_LEV_OK;
+}
+
+#endif
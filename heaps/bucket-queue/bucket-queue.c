@@ -0,0 +1,640 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define LENGTH(arr, dt) (sizeof(arr) / sizeof(dt))
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: The heaps only ever hold uint16_t keys so there are just 65536 possible priorities
+//  NOTE: Both queues here lean on that rather than comparing keys against each other
+
+#define KEY_COUNT 65536
+#define WORD_BITS 64
+#define LEAF_WORDS (KEY_COUNT / WORD_BITS)      // 1024 words, one bit per key
+#define SUMMARY_WORDS (LEAF_WORDS / WORD_BITS)  // 16 words, one bit per non-empty leaf word
+
+// Radix heap buckets - Bucket 0 holds keys equal to the last extracted key, bucket b holds keys whose highest differing bit is b - 1
+#define RADIX_BUCKETS 17
+
+#include "../heap.h"
+
+#define MIN_HEAP_HIGHER(a, b) ((a) < (b))
+
+DEFINE_HEAP(MinHeap, min_heap, uint16_t, MIN_HEAP_HIGHER)
+
+/**
+ * A bucket queue - One counter per key plus a bitmap of the non-empty keys
+ * The bitmap has three levels so finding the min is three count trailing zeros (ctz) no matter how many keys are in the queue
+ *
+ * - top: bit i set when summary[i] is not zero
+ * - summary: bit j of summary[i] set when leaves[i * 64 + j] is not zero
+ * - leaves: bit k of leaves[w] set when counts[w * 64 + k] is not zero
+ */
+
+typedef struct {
+  size_t size;
+  uint32_t* counts;
+  uint64_t leaves[LEAF_WORDS];
+  uint64_t summary[SUMMARY_WORDS];
+  uint64_t top;
+} BucketQueue;
+
+typedef struct {
+  size_t size;
+  size_t capacity;
+  uint16_t* keys;
+} RadixBucket;
+
+/**
+ * A monotone radix heap - Only valid when nothing smaller than the last extracted key is ever pushed (Dijkstra style)
+ * A key lives in the bucket for the highest bit where it differs from last, so when last moves up keys only ever move to lower buckets
+ * Each key moves at most 16 times over its life which is where the O(log U) amortised cost comes from
+ */
+
+typedef struct {
+  size_t size;
+  uint16_t last;
+  uint32_t occupied;
+  RadixBucket buckets[RADIX_BUCKETS];
+} RadixHeap;
+
+BucketQueue bucket_queue_initialize();
+void bucket_queue_free(BucketQueue* queue);
+bool bucket_queue_push(BucketQueue* queue, uint16_t key);
+int32_t bucket_queue_peek_min(BucketQueue* queue);
+int32_t bucket_queue_peek_max(BucketQueue* queue);
+int32_t bucket_queue_extract_min(BucketQueue* queue);
+int32_t bucket_queue_extract_max(BucketQueue* queue);
+
+RadixHeap radix_heap_initialize();
+void radix_heap_free(RadixHeap* heap);
+bool radix_heap_push(RadixHeap* heap, uint16_t key);
+int32_t radix_heap_extract_min(RadixHeap* heap);
+
+/**
+ * ======================
+ * || Bucket Queue     ||
+ * ======================
+ */
+
+BucketQueue bucket_queue_initialize() {
+  BucketQueue queue;
+  memset(&queue, 0, sizeof(BucketQueue));
+
+  queue.counts = (uint32_t*) calloc(KEY_COUNT, sizeof(uint32_t));
+
+  if (queue.counts == NULL) {
+    DEBUG_PRINT("Error Allocating memory for the bucket queue\n\n", NULL);
+    exit(EXIT_FAILURE);
+  }
+
+  return queue;
+}
+
+// Clears the bitmaps along with the counters so a freed queue reads as empty, a push after this allocates the counters again
+
+void bucket_queue_free(BucketQueue* queue) {
+  if (queue == NULL) return;
+
+  free(queue->counts);
+  memset(queue, 0, sizeof(BucketQueue));
+}
+
+/**
+ * Push a key O(1) - Bump its counter and set the bitmap bits if it was empty
+ *
+ * @param: queue -> The queue to push to
+ * @param: key -> The key to push
+ * @returns: false if the counters of a freed queue could not be allocated again
+ */
+
+bool bucket_queue_push(BucketQueue* queue, uint16_t key) {
+  if (queue == NULL) return false;
+
+  if (queue->counts == NULL) {
+    queue->counts = (uint32_t*) calloc(KEY_COUNT, sizeof(uint32_t));
+
+    if (queue->counts == NULL) {
+      DEBUG_PRINT("Error Allocating memory for the bucket queue\n\n", NULL);
+      return false;
+    }
+  }
+
+  queue->size += 1;
+
+  if (queue->counts[key]++ > 0) return true;
+
+  size_t leaf = key / WORD_BITS;
+  size_t summary = leaf / WORD_BITS;
+
+  queue->leaves[leaf] |= 1ULL << (key % WORD_BITS);
+  queue->summary[summary] |= 1ULL << (leaf % WORD_BITS);
+  queue->top |= 1ULL << summary;
+
+  return true;
+}
+
+/**
+ * Find the smallest key with a non-zero count - One ctz per level of the bitmap
+ *
+ * @param: queue -> The queue to search
+ * @returns: The smallest key or -1 if the queue is empty
+ */
+
+int32_t bucket_queue_peek_min(BucketQueue* queue) {
+  if (queue == NULL || queue->top == 0) return -1;
+
+  size_t summary = __builtin_ctzll(queue->top);
+  size_t leaf = summary * WORD_BITS + __builtin_ctzll(queue->summary[summary]);
+
+  return leaf * WORD_BITS + __builtin_ctzll(queue->leaves[leaf]);
+}
+
+/**
+ * Find the largest key with a non-zero count - The same walk with count leading zeros from the other end
+ *
+ * @param: queue -> The queue to search
+ * @returns: The largest key or -1 if the queue is empty
+ */
+
+int32_t bucket_queue_peek_max(BucketQueue* queue) {
+  if (queue == NULL || queue->top == 0) return -1;
+
+  size_t summary = (WORD_BITS - 1) - __builtin_clzll(queue->top);
+  size_t leaf = summary * WORD_BITS + (WORD_BITS - 1) - __builtin_clzll(queue->summary[summary]);
+
+  return leaf * WORD_BITS + (WORD_BITS - 1) - __builtin_clzll(queue->leaves[leaf]);
+}
+
+/**
+ * Take one copy of a key out, clearing the bitmap bits upwards when a level goes empty
+ *
+ * @param: queue -> The queue to remove from
+ * @param: key -> A key that is in the queue
+ */
+
+static void bucket_queue_remove(BucketQueue* queue, uint16_t key) {
+  queue->size -= 1;
+
+  if (--queue->counts[key] > 0) return;
+
+  size_t leaf = key / WORD_BITS;
+  size_t summary = leaf / WORD_BITS;
+
+  queue->leaves[leaf] &= ~(1ULL << (key % WORD_BITS));
+  if (queue->leaves[leaf] != 0) return;
+
+  queue->summary[summary] &= ~(1ULL << (leaf % WORD_BITS));
+  if (queue->summary[summary] != 0) return;
+
+  queue->top &= ~(1ULL << summary);
+}
+
+int32_t bucket_queue_extract_min(BucketQueue* queue) {
+  int32_t key = bucket_queue_peek_min(queue);
+
+  if (key == -1) {
+    DEBUG_PRINT("Trying to extract from the queue when there are no keys\n", NULL);
+    return -1;
+  }
+
+  bucket_queue_remove(queue, key);
+
+  return key;
+}
+
+int32_t bucket_queue_extract_max(BucketQueue* queue) {
+  int32_t key = bucket_queue_peek_max(queue);
+
+  if (key == -1) {
+    DEBUG_PRINT("Trying to extract from the queue when there are no keys\n", NULL);
+    return -1;
+  }
+
+  bucket_queue_remove(queue, key);
+
+  return key;
+}
+
+/**
+ * ======================
+ * || Radix Heap       ||
+ * ======================
+ */
+
+RadixHeap radix_heap_initialize() {
+  RadixHeap heap;
+  memset(&heap, 0, sizeof(RadixHeap));
+
+  return heap;
+}
+
+void radix_heap_free(RadixHeap* heap) {
+  if (heap == NULL) return;
+
+  for (size_t b = 0; b < RADIX_BUCKETS; b++) {
+    free(heap->buckets[b].keys);
+    heap->buckets[b].keys = NULL;
+    heap->buckets[b].size = 0;
+    heap->buckets[b].capacity = 0;
+  }
+
+  heap->size = 0;
+  heap->occupied = 0;
+}
+
+/**
+ * Get the bucket a key belongs in relative to the last extracted key
+ *
+ * @param: key -> The key to place
+ * @param: last -> The last extracted key
+ * @returns: 0 if they are equal otherwise 1 + the index of the highest bit that differs
+ */
+
+static inline size_t radix_bucket_idx(uint16_t key, uint16_t last) {
+  uint32_t diff = key ^ last;
+
+  if (diff == 0) return 0;
+
+  return 32 - __builtin_clz(diff);
+}
+
+// Grow bucket b geometrically until it has room for `needed` keys
+
+static bool radix_bucket_reserve(RadixHeap* heap, size_t b, size_t needed) {
+  RadixBucket* bucket = &heap->buckets[b];
+
+  if (needed <= bucket->capacity) return true;
+
+  size_t new_capacity = bucket->capacity == 0 ? INITIAL_HEAP_CAPACITY : bucket->capacity;
+
+  while (new_capacity < needed) new_capacity *= HEAP_GROWTH_FACTOR;
+
+  uint16_t* resized = (uint16_t*) realloc(bucket->keys, sizeof(uint16_t) * new_capacity);
+
+  if (resized == NULL) {
+    DEBUG_PRINT("Error reallocating radix bucket %zu to %zu slots\n", b, new_capacity);
+    return false;
+  }
+
+  bucket->keys = resized;
+  bucket->capacity = new_capacity;
+
+  return true;
+}
+
+static bool radix_bucket_append(RadixHeap* heap, size_t b, uint16_t key) {
+  RadixBucket* bucket = &heap->buckets[b];
+
+  if (!radix_bucket_reserve(heap, b, bucket->size + 1)) return false;
+
+  bucket->keys[bucket->size] = key;
+  bucket->size += 1;
+  heap->occupied |= 1U << b;
+
+  return true;
+}
+
+/**
+ * Push a key O(1)
+ *
+ * @param: heap -> The heap to push to
+ * @param: key -> The key to push, must not be below the last extracted key
+ * @returns: false if the key breaks the monotone rule or the bucket could not grow
+ */
+
+bool radix_heap_push(RadixHeap* heap, uint16_t key) {
+  if (heap == NULL) return false;
+
+  if (key < heap->last) {
+    DEBUG_PRINT("Error: %u is below the last extracted key, a radix heap is monotone\n", key);
+    return false;
+  }
+
+  if (!radix_bucket_append(heap, radix_bucket_idx(key, heap->last), key)) return false;
+
+  heap->size += 1;
+
+  return true;
+}
+
+/**
+ * Extract the min key - O(log U) amortised
+ * If bucket 0 is empty take the lowest non-empty bucket, its min becomes the new last and every key in it is spread out into lower buckets
+ * The lower buckets are grown for every key first, so if one can't grow nothing has moved yet and the heap is left as it was
+ *
+ * @param: heap -> The heap to extract from
+ * @returns: The min key or -1 if the heap is empty (or a bucket could not grow)
+ */
+
+int32_t radix_heap_extract_min(RadixHeap* heap) {
+  if (heap == NULL || heap->size == 0) {
+    DEBUG_PRINT("Trying to extract from the heap when there are no keys\n", NULL);
+    return -1;
+  }
+
+  if (heap->buckets[0].size == 0) {
+    size_t b = __builtin_ctz(heap->occupied);
+    RadixBucket* bucket = &heap->buckets[b];
+    uint16_t min = bucket->keys[0];
+
+    for (size_t i = 1; i < bucket->size; i++) {
+      if (bucket->keys[i] < min) min = bucket->keys[i];
+    }
+
+    // All the keys share the bits above b - 1 with the new last and differ from it below, so they all land in lower buckets
+    size_t moving[RADIX_BUCKETS] = { 0 };
+
+    for (size_t i = 0; i < bucket->size; i++) moving[radix_bucket_idx(bucket->keys[i], min)] += 1;
+
+    for (size_t t = 0; t < b; t++) {
+      if (moving[t] > 0 && !radix_bucket_reserve(heap, t, heap->buckets[t].size + moving[t])) return -1;
+    }
+
+    heap->last = min;
+
+    for (size_t i = 0; i < bucket->size; i++) {
+      radix_bucket_append(heap, radix_bucket_idx(bucket->keys[i], min), bucket->keys[i]);
+    }
+
+    bucket->size = 0;
+    heap->occupied &= ~(1U << b);
+  }
+
+  RadixBucket* zero = &heap->buckets[0];
+
+  zero->size -= 1;
+  heap->size -= 1;
+  if (zero->size == 0) heap->occupied &= ~1U;
+
+  return zero->keys[zero->size];
+}
+
+/**
+ * ===========
+ * || Tests ||
+ * ===========
+ */
+
+void test_bucket_queue() {
+  printf("==================\n");
+  printf("|| Bucket Queue ||\n");
+  printf("==================\n\n");
+
+  BucketQueue queue = bucket_queue_initialize();
+  uint16_t nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64, 27, 65535, 0 };
+
+  for (size_t i = 0; i < LENGTH(nums, uint16_t); i++) {
+    bucket_queue_push(&queue, nums[i]);
+  }
+
+  printf("Min: %d, Max: %d\n", bucket_queue_peek_min(&queue), bucket_queue_peek_max(&queue));
+  printf("Max end: %d\n", bucket_queue_extract_max(&queue));
+
+  printf("Drained: ");
+  while (queue.size > 0) {
+    printf("%d, ", bucket_queue_extract_min(&queue));
+  }
+
+  printf("\n");
+
+  // Free with keys still in it, then use it again
+  bucket_queue_push(&queue, 7);
+  bucket_queue_free(&queue);
+
+  printf("Empty after free: %s\n", bucket_queue_peek_min(&queue) == -1 && bucket_queue_extract_min(&queue) == -1 ? "true" : "false");
+  bool pushed = bucket_queue_push(&queue, 42);
+  printf("Push after free: %s (min %d)\n\n", pushed ? "true" : "false", bucket_queue_peek_min(&queue));
+
+  bucket_queue_free(&queue);
+}
+
+void test_radix_heap() {
+  printf("==================\n");
+  printf("|| Radix Heap   ||\n");
+  printf("==================\n\n");
+
+  RadixHeap heap = radix_heap_initialize();
+  uint16_t nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64, 27 };
+
+  for (size_t i = 0; i < LENGTH(nums, uint16_t); i++) {
+    radix_heap_push(&heap, nums[i]);
+  }
+
+  printf("Extracted: %d\n", radix_heap_extract_min(&heap));
+  printf("Extracted: %d\n", radix_heap_extract_min(&heap));
+  printf("Push 30 (at or above the last extracted key): %s\n", radix_heap_push(&heap, 30) ? "true" : "false");
+  printf("Push 10 (below the last extracted key) rejected: %s\n", radix_heap_push(&heap, 10) ? "false" : "true");
+
+  printf("Drained: ");
+  while (heap.size > 0) {
+    printf("%d, ", radix_heap_extract_min(&heap));
+  }
+
+  printf("\n\n");
+
+  radix_heap_free(&heap);
+}
+
+// Run the same random monotone workload through all three and check they hand back the same keys
+
+void test_matches_min_heap() {
+  printf("==================\n");
+  printf("|| Vs Min Heap  ||\n");
+  printf("==================\n\n");
+
+  BucketQueue queue = bucket_queue_initialize();
+  RadixHeap radix = radix_heap_initialize();
+  MinHeap heap = min_heap_initialize();
+  uint32_t seed = 12345;
+  bool same = true;
+
+  for (size_t i = 0; i < 1000; i++) {
+    seed = seed * 1103515245 + 12345;
+    uint16_t key = (seed >> 16) % 1024;
+    bucket_queue_push(&queue, key);
+    radix_heap_push(&radix, key);
+    min_heap_insert(&heap, key);
+  }
+
+  for (size_t i = 0; i < 100000; i++) {
+    uint16_t expected = 0;
+    min_heap_extract(&heap, &expected);
+
+    if (bucket_queue_extract_min(&queue) != expected) same = false;
+    if (radix_heap_extract_min(&radix) != expected) same = false;
+
+    seed = seed * 1103515245 + 12345;
+    uint32_t next = expected + (seed >> 16) % 256;
+
+    if (next > UINT16_MAX) next = expected;
+
+    bucket_queue_push(&queue, next);
+    radix_heap_push(&radix, next);
+    min_heap_insert(&heap, next);
+  }
+
+  printf("Same order as the min heap: %s\n\n", same ? "true" : "false");
+
+  bucket_queue_free(&queue);
+  radix_heap_free(&radix);
+  min_heap_free(&heap);
+}
+
+void run_tests() {
+  test_bucket_queue();
+
+  test_radix_heap();
+
+  test_matches_min_heap();
+
+}
+
+/**
+ * ================
+ * || Benchmarks ||
+ * ================
+ */
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// Fill with BENCHMARK_SIZE random keys then drain - No monotone rule so the radix heap sits this one out
+
+void bench_push_pop() {
+  printf("==================\n");
+  printf("|| Push/ Pop    ||\n");
+  printf("==================\n\n");
+
+  BucketQueue queue = bucket_queue_initialize();
+  MinHeap heap = min_heap_initialize();
+  struct timespec start, end;
+  uint32_t seed = 12345;
+  uint64_t checksum = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    seed = seed * 1103515245 + 12345;
+    bucket_queue_push(&queue, (uint16_t) (seed >> 16));
+  }
+
+  while (queue.size > 0) {
+    checksum += bucket_queue_extract_min(&queue);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double bucket_time = elapsed_seconds(start, end);
+
+  seed = 12345;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    seed = seed * 1103515245 + 12345;
+    min_heap_insert(&heap, (uint16_t) (seed >> 16));
+  }
+
+  while (heap.size > 0) {
+    uint16_t key;
+    min_heap_extract(&heap, &key);
+    checksum -= key;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double heap_time = elapsed_seconds(start, end);
+
+  printf("%d push + extract_min, bucket queue: %.2f Mops/s\n", BENCHMARK_SIZE, BENCHMARK_SIZE / bucket_time / 1e6);
+  printf("%d push + extract_min, min heap:     %.2f Mops/s\n", BENCHMARK_SIZE, BENCHMARK_SIZE / heap_time / 1e6);
+  printf("Same keys: %s\n\n", checksum == 0 ? "true" : "false");
+
+  bucket_queue_free(&queue);
+  min_heap_free(&heap);
+}
+
+// Dijkstra style: pop the min and push a key a short distance above it, so every push is at or above the last pop
+
+void bench_monotone() {
+  printf("==================\n");
+  printf("|| Monotone     ||\n");
+  printf("==================\n\n");
+
+  BucketQueue queue = bucket_queue_initialize();
+  RadixHeap radix = radix_heap_initialize();
+  MinHeap heap = min_heap_initialize();
+  struct timespec start, end;
+  double times[3];
+  uint64_t checksums[3] = { 0, 0, 0 };
+  size_t queued = BENCHMARK_SIZE / 10;
+
+  for (size_t run = 0; run < 3; run++) {
+    uint32_t seed = 12345;
+
+    for (size_t i = 0; i < queued; i++) {
+      seed = seed * 1103515245 + 12345;
+      uint16_t key = (seed >> 16) % 1024;
+
+      if (run == 0) bucket_queue_push(&queue, key);
+      if (run == 1) radix_heap_push(&radix, key);
+      if (run == 2) min_heap_insert(&heap, key);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+      uint16_t key = 0;
+
+      if (run == 0) key = bucket_queue_extract_min(&queue);
+      if (run == 1) key = radix_heap_extract_min(&radix);
+      if (run == 2) min_heap_extract(&heap, &key);
+
+      seed = seed * 1103515245 + 12345;
+      uint32_t next = key + (seed >> 16) % 64;
+
+      if (next > UINT16_MAX) next = key;
+
+      if (run == 0) bucket_queue_push(&queue, next);
+      if (run == 1) radix_heap_push(&radix, next);
+      if (run == 2) min_heap_insert(&heap, next);
+
+      checksums[run] += key;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    times[run] = elapsed_seconds(start, end);
+  }
+
+  printf("%d pop + push pairs on a %zu key queue\n", BENCHMARK_SIZE, queued);
+  printf("Bucket queue: %.2f Mops/s\n", BENCHMARK_SIZE / times[0] / 1e6);
+  printf("Radix heap:   %.2f Mops/s\n", BENCHMARK_SIZE / times[1] / 1e6);
+  printf("Min heap:     %.2f Mops/s\n", BENCHMARK_SIZE / times[2] / 1e6);
+  printf("Same keys: %s\n\n", checksums[0] == checksums[2] && checksums[1] == checksums[2] ? "true" : "false");
+
+  bucket_queue_free(&queue);
+  radix_heap_free(&radix);
+  min_heap_free(&heap);
+}
+
+void run_benchmarks() {
+  bench_push_pop();
+  bench_monotone();
+}
+
+int main() {
+  run_tests();
+
+  if (RUN_BENCHMARKS) run_benchmarks();
+
+  return 0;
+}
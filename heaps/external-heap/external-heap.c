@@ -0,0 +1,690 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: A max priority queue that can hold more than fits in memory
+//  NOTE: Inserts go into a normal MaxHeap, when that is full it is sorted and spilled to a temp file as a run
+//  NOTE: Pops take the bigger of the MaxHeap top and the best run head, runs are read back lazily a buffer at a time
+
+// A spill writes a tier 0 run. Once the newest RUNS_PER_TIER runs are all in one tier they are merged into a single run
+// in the tier above, so a value is rewritten once per tier rather than every time the runs pile up
+#define RUNS_PER_TIER 16
+
+// The top tier merges back into itself, which caps the runs a pop has to look at to RUNS_PER_TIER * MAX_TIERS
+#define MAX_TIERS 8
+#define MAX_RUNS (RUNS_PER_TIER * MAX_TIERS)
+
+// The number of values read from a run at a time and written to a run at a time
+#define RUN_BUFFER_VALUES (16 * 1024)
+
+#include "../heap.h"
+
+#define MAX_HEAP_HIGHER(a, b) ((a) > (b))
+
+DEFINE_HEAP(MaxHeap, max_heap, uint16_t, MAX_HEAP_HIGHER)
+
+// The largest value a run hasn't handed out yet
+
+typedef struct {
+  uint16_t value;
+  uint32_t run_id;
+} RunHead;
+
+#define RUN_HEAD_HIGHER(a, b) ((a).value > (b).value)
+
+DEFINE_HEAP(RunHeap, run_heap, RunHead, RUN_HEAD_HIGHER)
+
+// A run on disk sorted largest first, buffer holds the part of it that has been read in
+
+typedef struct {
+  FILE* file;
+  uint16_t* buffer;
+  size_t count;
+  size_t idx;
+  size_t tier;
+} Run;
+
+// runs are oldest first and their tiers never go up from one run to the next
+// merging holds the heads of the runs being merged, it lives here so a merge never has to allocate it
+
+typedef struct {
+  size_t size;
+  size_t memory_values;
+  MaxHeap memory;
+  RunHeap heads;
+  RunHeap merging;
+  Run runs[MAX_RUNS];
+  size_t run_count;
+  uint16_t* scratch;
+  uint32_t* counts;
+  size_t spilled_values;
+  size_t merged_values;
+} ExternalHeap;
+
+ExternalHeap external_heap_initialize(size_t memory_values);
+void external_heap_free(ExternalHeap* heap);
+bool external_heap_insert(ExternalHeap* heap, uint16_t data);
+int32_t external_heap_peek(ExternalHeap* heap);
+int32_t extract_max(ExternalHeap* heap);
+
+/**
+ * =====================
+ * || Runs            ||
+ * =====================
+ */
+
+/**
+ * Get the next value of a run, refilling its buffer from the file when it runs dry
+ *
+ * @param: run -> The run to read from
+ * @param: value -> Set to the next value
+ * @returns: false once the run is exhausted - or on a read error, check ferror(run->file) to tell them apart
+ */
+
+static bool run_next(Run* run, uint16_t* value) {
+  if (run->idx == run->count) {
+    run->count = fread(run->buffer, sizeof(uint16_t), RUN_BUFFER_VALUES, run->file);
+    run->idx = 0;
+
+    if (run->count == 0) return false;
+  }
+
+  *value = run->buffer[run->idx];
+  run->idx += 1;
+
+  return true;
+}
+
+static void run_close(Run* run) {
+  if (run->file != NULL) fclose(run->file);
+  free(run->buffer);
+
+  run->file = NULL;
+  run->buffer = NULL;
+  run->count = 0;
+  run->idx = 0;
+}
+
+/**
+ * Open a run that has just been written for reading and read its first value
+ *
+ * @param: run -> The run to set up
+ * @param: file -> The run file, sorted largest first
+ * @param: buffer -> The run's read buffer of RUN_BUFFER_VALUES values
+ * @param: tier -> The tier the run is in
+ * @param: first -> Set to the first value
+ * @returns: false if the run is empty or could not be read, like run_next(...)
+ */
+
+static bool run_open(Run* run, FILE* file, uint16_t* buffer, size_t tier, uint16_t* first) {
+  run->file = file;
+  run->buffer = buffer;
+  run->count = 0;
+  run->idx = 0;
+  run->tier = tier;
+
+  rewind(file);
+
+  return run_next(run, first);
+}
+
+// Put an opened run in the next slot with its first value (if it has one) in the run heap
+
+static void run_attach(ExternalHeap* heap, Run* run, bool has_first, uint16_t first) {
+  RunHead head = { .value = first, .run_id = (uint32_t) heap->run_count };
+
+  heap->runs[heap->run_count] = *run;
+  heap->run_count += 1;
+
+  if (has_first) run_heap_insert(&heap->heads, head);
+}
+
+// Open and attach a run with a new read buffer, false (and the file closed) if it could not be allocated or read back
+
+static bool run_add(ExternalHeap* heap, FILE* file, size_t tier) {
+  uint16_t* buffer = (uint16_t*) malloc(sizeof(uint16_t) * RUN_BUFFER_VALUES);
+
+  if (buffer == NULL) {
+    DEBUG_PRINT("Error Allocating a run buffer\n", NULL);
+    fclose(file);
+    return false;
+  }
+
+  Run run;
+  uint16_t first = 0;
+  bool has_first = run_open(&run, file, buffer, tier, &first);
+
+  if (!has_first && ferror(file)) {
+    DEBUG_PRINT("Error reading back a run that was just written\n", NULL);
+    run_close(&run);
+    return false;
+  }
+
+  run_attach(heap, &run, has_first, first);
+
+  return true;
+}
+
+/**
+ * Take the top value off the runs - The best run head is replaced by the next value from the same run
+ * A read error leaves the run heap as it was so the pop can be tried again, rather than dropping the rest of the run
+ *
+ * @param: heap -> The external heap, must have a run head
+ * @param: out -> Set to the largest value left in the runs
+ * @returns: false if the run could not be read
+ */
+
+static bool runs_pop(ExternalHeap* heap, uint16_t* out) {
+  RunHead top = heap->heads.heap[0].data;
+  RunHead next = { .value = 0, .run_id = top.run_id };
+  Run* run = &heap->runs[top.run_id];
+
+  if (run_next(run, &next.value)) {
+    run_heap_replace_top(&heap->heads, next, NULL);
+  } else if (ferror(run->file)) {
+    DEBUG_PRINT("Error reading run %u\n", top.run_id);
+    clearerr(run->file);
+    return false;
+  } else {
+    run_heap_extract(&heap->heads, NULL);
+  }
+
+  *out = top.value;
+  return true;
+}
+
+/**
+ * Write values to a new temp file in blocks of RUN_BUFFER_VALUES
+ *
+ * @param: values -> The values, already sorted largest first
+ * @param: n -> The number of values
+ * @returns: The file or NULL if it could not be created or written
+ */
+
+static FILE* write_run(const uint16_t* values, size_t n) {
+  FILE* file = tmpfile();
+
+  if (file == NULL) {
+    DEBUG_PRINT("Error: Could not create a temp file to spill to\n", NULL);
+    return NULL;
+  }
+
+  if (fwrite(values, sizeof(uint16_t), n, file) != n) {
+    DEBUG_PRINT("Error writing a run of %zu values\n", n);
+    fclose(file);
+    return NULL;
+  }
+
+  return file;
+}
+
+/**
+ * Merge runs first ... run_count - 1 into one run - Their heads move from the run heap to the merging heap and are
+ * drained into a new file. The old runs are only closed once that file is fully written and read back, if a read or
+ * write fails every run is wound back to where it was and its head goes back in the run heap, so no value is lost
+ *
+ * @param: heap -> The external heap
+ * @param: first -> The oldest run to merge, every run after it is merged too
+ * @param: tier -> The tier the merged run goes in
+ * @returns: false if a run could not be read or the merged run could not be written
+ */
+
+static bool merge_runs(ExternalHeap* heap, size_t first, size_t tier) {
+  FILE* file = tmpfile();
+  RunHead saved[MAX_RUNS];
+  long offsets[MAX_RUNS];
+  size_t saved_count = 0;
+
+  if (file == NULL) {
+    DEBUG_PRINT("Error: Could not create a temp file to merge into\n", NULL);
+    return false;
+  }
+
+  // Where each run is up to - the file position less whatever is still unread in its buffer
+  for (size_t i = first; i < heap->run_count; i++) {
+    Run* run = &heap->runs[i];
+    offsets[i - first] = ftell(run->file) - (long) ((run->count - run->idx) * sizeof(uint16_t));
+  }
+
+  // Take the merged runs' heads out of the run heap then heapify what is left back into shape
+  RunHeap* heads = &heap->heads;
+  size_t kept = 0;
+
+  for (size_t i = 0; i < heads->size; i++) {
+    RunHead head = heads->heap[i].data;
+
+    if (head.run_id < first) {
+      heads->heap[kept] = heads->heap[i];
+      kept += 1;
+      continue;
+    }
+
+    saved[saved_count] = head;
+    saved_count += 1;
+    run_heap_insert(&heap->merging, head);
+  }
+
+  heads->size = kept;
+
+  for (size_t i = (kept + HEAP_ARITY - 1) / HEAP_ARITY; i > 0; i--) run_heap_heapify(heads, i - 1);
+
+  size_t count = 0;
+  size_t written = 0;
+  bool ok = true;
+
+  while (ok && heap->merging.size > 0) {
+    RunHead top = heap->merging.heap[0].data;
+    RunHead next = { .value = 0, .run_id = top.run_id };
+
+    if (run_next(&heap->runs[top.run_id], &next.value)) {
+      run_heap_replace_top(&heap->merging, next, NULL);
+    } else if (ferror(heap->runs[top.run_id].file)) {
+      DEBUG_PRINT("Error reading run %u\n", top.run_id);
+      ok = false;
+      break;
+    } else {
+      run_heap_extract(&heap->merging, NULL);
+    }
+
+    heap->scratch[count] = top.value;
+    count += 1;
+
+    if (count == RUN_BUFFER_VALUES) {
+      ok = fwrite(heap->scratch, sizeof(uint16_t), count, file) == count;
+      written += count;
+      count = 0;
+    }
+  }
+
+  if (ok && count > 0) ok = fwrite(heap->scratch, sizeof(uint16_t), count, file) == count;
+  if (ok) ok = fflush(file) == 0;
+
+  written += count;
+
+  // The merged run reads into the oldest merged run's buffer - every merged run is drained so it is free
+  Run merged;
+  uint16_t first_value = 0;
+  bool has_first = false;
+
+  if (ok) {
+    has_first = run_open(&merged, file, heap->runs[first].buffer, tier, &first_value);
+    ok = has_first || !ferror(file);
+  }
+
+  if (!ok) {
+    DEBUG_PRINT("Error: Could not merge the runs, putting them back\n", NULL);
+    fclose(file);
+    heap->merging.size = 0;
+
+    for (size_t i = first; i < heap->run_count; i++) {
+      Run* run = &heap->runs[i];
+      clearerr(run->file);
+      fseek(run->file, offsets[i - first], SEEK_SET);
+      run->count = 0;
+      run->idx = 0;
+    }
+
+    for (size_t i = 0; i < saved_count; i++) run_heap_insert(heads, saved[i]);
+
+    return false;
+  }
+
+  // The merged run has taken over the oldest merged run's buffer so nothing can fail from here on
+  heap->runs[first].buffer = NULL;
+
+  for (size_t i = first; i < heap->run_count; i++) run_close(&heap->runs[i]);
+
+  heap->run_count = first;
+  heap->merged_values += written;
+  run_attach(heap, &merged, has_first, first_value);
+
+  return true;
+}
+
+/**
+ * While the newest RUNS_PER_TIER runs are all in one tier, merge them into one run in the tier above
+ * Tiers never go up from oldest to newest run, so the runs of the lowest tier are always the last ones
+ *
+ * @param: heap -> The external heap
+ * @returns: false if a merge failed (the runs are left as they were)
+ */
+
+static bool compact_runs(ExternalHeap* heap) {
+  while (heap->run_count >= RUNS_PER_TIER) {
+    size_t first = heap->run_count - RUNS_PER_TIER;
+    size_t tier = heap->runs[heap->run_count - 1].tier;
+
+    if (heap->runs[first].tier != tier) return true;
+
+    if (!merge_runs(heap, first, tier + 1 < MAX_TIERS ? tier + 1 : tier)) return false;
+  }
+
+  return true;
+}
+
+/**
+ * Sort the in memory heap largest first and write it out as a run, leaving the in memory heap empty
+ * The keys are uint16_t so the sort is a counting sort rather than max_heap_size extracts
+ *
+ * @param: heap -> The external heap
+ * @returns: false if the run could not be written
+ */
+
+static bool spill(ExternalHeap* heap) {
+  if (!compact_runs(heap)) return false;
+
+  MaxHeap* memory = &heap->memory;
+  uint32_t* counts = heap->counts;
+  size_t idx = 0;
+
+  memset(counts, 0, sizeof(uint32_t) * (UINT16_MAX + 1));
+
+  for (size_t i = 0; i < memory->size; i++) counts[memory->heap[i].data] += 1;
+
+  for (int32_t key = UINT16_MAX; key >= 0; key--) {
+    for (uint32_t c = 0; c < counts[key]; c++) {
+      heap->scratch[idx] = (uint16_t) key;
+      idx += 1;
+    }
+  }
+
+  FILE* file = write_run(heap->scratch, idx);
+
+  if (file == NULL || !run_add(heap, file, 0)) return false;
+
+  heap->spilled_values += idx;
+
+  // Every node has gone to disk, reset the heap rather than extracting them one at a time
+  max_heap_free(memory);
+  *memory = max_heap_initialize();
+  max_heap_reserve(memory, heap->memory_values);
+
+  return true;
+}
+
+/**
+ * =====================
+ * || Program methods ||
+ * =====================
+ */
+
+/**
+ * Create an external heap
+ *
+ * @param: memory_values -> The most values kept in the in memory heap before it spills
+ * @returns: The heap, exits if the memory can't be had
+ */
+
+ExternalHeap external_heap_initialize(size_t memory_values) {
+  ExternalHeap heap;
+  memset(&heap, 0, sizeof(ExternalHeap));
+
+  if (memory_values < RUN_BUFFER_VALUES) memory_values = RUN_BUFFER_VALUES;
+
+  heap.memory_values = memory_values;
+  heap.memory = max_heap_initialize();
+  heap.heads = run_heap_initialize();
+  heap.merging = run_heap_initialize();
+  heap.scratch = (uint16_t*) malloc(sizeof(uint16_t) * memory_values);
+  heap.counts = (uint32_t*) malloc(sizeof(uint32_t) * (UINT16_MAX + 1));
+
+  bool reserved = max_heap_reserve(&heap.memory, memory_values) && run_heap_reserve(&heap.heads, MAX_RUNS) && run_heap_reserve(&heap.merging, MAX_RUNS);
+
+  if (heap.scratch == NULL || heap.counts == NULL || !reserved) {
+    DEBUG_PRINT("Error Allocating memory for the external heap\n\n", NULL);
+    exit(EXIT_FAILURE);
+  }
+
+  return heap;
+}
+
+void external_heap_free(ExternalHeap* heap) {
+  if (heap == NULL) return;
+
+  for (size_t i = 0; i < heap->run_count; i++) run_close(&heap->runs[i]);
+
+  max_heap_free(&heap->memory);
+  run_heap_free(&heap->heads);
+  run_heap_free(&heap->merging);
+  free(heap->scratch);
+  free(heap->counts);
+
+  heap->scratch = NULL;
+  heap->counts = NULL;
+  heap->run_count = 0;
+  heap->size = 0;
+}
+
+/**
+ * Insert a value - O(log n) into the in memory heap, plus a spill to disk every memory_values inserts
+ *
+ * @param: heap -> The heap to insert into
+ * @param: data -> The value to insert
+ * @returns: false if a spill failed
+ */
+
+bool external_heap_insert(ExternalHeap* heap, uint16_t data) {
+  if (heap == NULL) return false;
+
+  if (heap->memory.size == heap->memory_values && !spill(heap)) return false;
+
+  max_heap_insert(&heap->memory, data);
+  heap->size += 1;
+
+  return true;
+}
+
+int32_t external_heap_peek(ExternalHeap* heap) {
+  if (heap == NULL || heap->size == 0) return -1;
+
+  int32_t memory_top = heap->memory.size > 0 ? heap->memory.heap[0].data : -1;
+  int32_t run_top = heap->heads.size > 0 ? heap->heads.heap[0].data.value : -1;
+
+  return memory_top > run_top ? memory_top : run_top;
+}
+
+/**
+ * Extract the max value - From the in memory heap or from the runs, whichever has the bigger top
+ *
+ * @param: heap -> The heap to extract from
+ * @returns: The max value or -1 if the heap is empty or a run could not be read (the heap is left as it was)
+ */
+
+int32_t extract_max(ExternalHeap* heap) {
+  if (heap == NULL || heap->size == 0) {
+    DEBUG_PRINT("Trying to extract from the heap when there are no nodes\n", NULL);
+    return -1;
+  }
+
+  bool from_memory = heap->memory.size > 0 && (heap->heads.size == 0 || heap->memory.heap[0].data >= heap->heads.heap[0].data.value);
+  uint16_t data;
+
+  if (from_memory) {
+    max_heap_extract(&heap->memory, &data);
+  } else if (!runs_pop(heap, &data)) {
+    return -1;
+  }
+
+  heap->size -= 1;
+  return data;
+}
+
+/**
+ * ===========
+ * || Tests ||
+ * ===========
+ */
+
+// Random inserts with pops mixed in, every pop checked against a plain MaxHeap holding the same values
+
+void test_matches_max_heap() {
+  printf("==================\n");
+  printf("|| Vs Max Heap  ||\n");
+  printf("==================\n\n");
+
+  ExternalHeap heap = external_heap_initialize(RUN_BUFFER_VALUES);
+  MaxHeap reference = max_heap_initialize();
+  uint32_t seed = 12345;
+  bool same = true;
+  size_t max_runs = 0;
+
+  for (size_t i = 0; i < 1000000; i++) {
+    seed = seed * 1103515245 + 12345;
+    uint16_t value = (uint16_t) (seed >> 16);
+
+    external_heap_insert(&heap, value);
+    max_heap_insert(&reference, value);
+
+    if (heap.run_count > max_runs) max_runs = heap.run_count;
+
+    if (i % 3 == 0) {
+      uint16_t expected = 0;
+      max_heap_extract(&reference, &expected);
+      if (extract_max(&heap) != expected) same = false;
+    }
+  }
+
+  printf("Spilled %zu values, rewritten by merges %zu, most runs at once: %zu\n", heap.spilled_values, heap.merged_values, max_runs);
+
+  while (reference.size > 0) {
+    uint16_t expected;
+    max_heap_extract(&reference, &expected);
+    if (extract_max(&heap) != expected) same = false;
+  }
+
+  printf("Same order as the max heap: %s\n", same ? "true" : "false");
+  printf("Empty afterwards: %s\n\n", heap.size == 0 && external_heap_peek(&heap) == -1 ? "true" : "false");
+
+  external_heap_free(&heap);
+  max_heap_free(&reference);
+}
+
+// Swap a run's file for one that can't be read - a pop or a merge that needs it has to fail rather than drop the run
+
+void test_read_errors() {
+  printf("==================\n");
+  printf("|| Read Errors  ||\n");
+  printf("==================\n\n");
+
+  ExternalHeap heap = external_heap_initialize(RUN_BUFFER_VALUES);
+  FILE* unreadable = fopen("/dev/null", "w");
+
+  if (unreadable == NULL) return;
+
+  // RUNS_PER_TIER full runs and a full in memory heap, the next insert has to merge the runs
+  for (size_t i = 0; i < (RUNS_PER_TIER + 1) * RUN_BUFFER_VALUES; i++) external_heap_insert(&heap, (uint16_t) i);
+
+  fclose(heap.runs[0].file);
+  heap.runs[0].file = unreadable;
+
+  size_t size = heap.size;
+  size_t runs = heap.run_count;
+
+  printf("Insert that needs an unreadable run merged fails: %s\n", external_heap_insert(&heap, 0) ? "false" : "true");
+  printf("Runs left as they were: %s\n", heap.size == size && heap.run_count == runs ? "true" : "false");
+
+  // Run 0 holds the smallest values, so once everything above them is popped the next pop needs to read it
+  bool failed = false;
+
+  while (heap.size > 0 && !failed) {
+    if (extract_max(&heap) == -1) failed = true;
+  }
+
+  printf("Pop from an unreadable run fails: %s (%zu values still counted)\n\n", failed ? "true" : "false", heap.size);
+
+  external_heap_free(&heap);
+}
+
+void run_tests() {
+  test_matches_max_heap();
+
+  test_read_errors();
+
+}
+
+/**
+ * ================
+ * || Benchmarks ||
+ * ================
+ */
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// Push 20x more values than the in memory heap holds then drain - against a MaxHeap that has it all in memory
+
+void bench_push_pop() {
+  printf("==================\n");
+  printf("|| Push/ Pop    ||\n");
+  printf("==================\n\n");
+
+  size_t n = BENCHMARK_SIZE * 20;
+  size_t memory_values = BENCHMARK_SIZE;
+  double times[2];
+  uint64_t checksums[2] = { 0, 0 };
+  struct timespec start, end;
+  size_t spilled = 0;
+
+  for (size_t run = 0; run < 2; run++) {
+    ExternalHeap external = external_heap_initialize(memory_values);
+    MaxHeap memory = max_heap_initialize();
+    uint32_t seed = 12345;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < n; i++) {
+      seed = seed * 1103515245 + 12345;
+
+      if (run == 0) external_heap_insert(&external, (uint16_t) (seed >> 16));
+      if (run == 1) max_heap_insert(&memory, (uint16_t) (seed >> 16));
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      uint16_t data = 0;
+
+      if (run == 0) data = extract_max(&external);
+      if (run == 1) max_heap_extract(&memory, &data);
+
+      checksums[run] += data;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    times[run] = elapsed_seconds(start, end);
+
+    if (run == 0) spilled = external.spilled_values;
+
+    external_heap_free(&external);
+    max_heap_free(&memory);
+  }
+
+  printf("%zu pushes then pops, %zu values kept in memory\n", n, memory_values);
+  printf("External heap: %.2f Mops/s (%.1f MB spilled)\n", 2 * n / times[0] / 1e6, spilled * sizeof(uint16_t) / (1024.0 * 1024.0));
+  printf("Max heap:      %.2f Mops/s (%.1f MB in memory)\n", 2 * n / times[1] / 1e6, n * sizeof(MaxHeapNode) / (1024.0 * 1024.0));
+  printf("Same values: %s\n\n", checksums[0] == checksums[1] ? "true" : "false");
+}
+
+void run_benchmarks() {
+  bench_push_pop();
+}
+
+int main() {
+  run_tests();
+
+  if (RUN_BENCHMARKS) run_benchmarks();
+
+  return 0;
+}
@@ -0,0 +1,582 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: Sorts a binary file of uint16_t values (the same keys as the heaps) that doesn't have to fit in memory
+//  NOTE: Usage: ./external-sort <input> <output> [values per run] - With no arguments it runs the tests and benchmarks
+
+// How many values are sorted in memory at a time - Each becomes one run on disk (8MB of uint16_t)
+#define DEFAULT_RUN_VALUES (4 * 1024 * 1024)
+
+// stdio buffer for every file and the number of values read from a run in one go while merging
+#define IO_BUFFER_SIZE (1024 * 1024)
+#define MERGE_BUFFER_VALUES (64 * 1024)
+
+#include "../heap.h"
+
+// The tournament - One entry per run holding the smallest value that run hasn't written yet
+
+typedef struct {
+  uint16_t value;
+  uint32_t run_id;
+} RunHead;
+
+#define RUN_HEAD_HIGHER(a, b) ((a).value < (b).value)
+
+DEFINE_HEAP(MergeHeap, merge_heap, RunHead, RUN_HEAD_HIGHER)
+
+// A sorted run in a temp file and the part of it that has been read in
+
+typedef struct {
+  FILE* file;
+  uint16_t* buffer;
+  size_t count;
+  size_t idx;
+} Run;
+
+// failed is set if make_runs(...) gave up partway, an empty list on its own just means an empty input
+
+typedef struct {
+  size_t count;
+  size_t capacity;
+  FILE** files;
+  bool failed;
+} RunList;
+
+typedef struct {
+  size_t values;
+  size_t runs;
+  double run_seconds;
+  double merge_seconds;
+} SortStats;
+
+RunList make_runs(FILE* in, size_t run_values, SortStats* stats);
+bool merge_runs(RunList* runs, FILE* out, bool use_replace_top, SortStats* stats);
+void free_runs(RunList* runs);
+bool sort_file(FILE* in, FILE* out, size_t run_values, SortStats* stats);
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/**
+ * Sort a chunk in memory - The values are uint16_t so a counting sort over the 65536 keys is O(n) and beats qsort
+ *
+ * @param: values -> The values to sort in place
+ * @param: n -> The number of values
+ * @param: counts -> Scratch space for 65536 counters
+ */
+
+static void sort_run(uint16_t* values, size_t n, uint32_t* counts) {
+  memset(counts, 0, sizeof(uint32_t) * (UINT16_MAX + 1));
+
+  for (size_t i = 0; i < n; i++) counts[values[i]] += 1;
+
+  size_t idx = 0;
+
+  for (uint32_t key = 0; key <= UINT16_MAX; key++) {
+    for (uint32_t c = 0; c < counts[key]; c++) {
+      values[idx] = (uint16_t) key;
+      idx += 1;
+    }
+  }
+}
+
+/**
+ * =====================
+ * || Runs            ||
+ * =====================
+ */
+
+static bool run_list_push(RunList* runs, FILE* file) {
+  if (runs->count == runs->capacity) {
+    size_t new_capacity = runs->capacity == 0 ? INITIAL_HEAP_CAPACITY : runs->capacity * HEAP_GROWTH_FACTOR;
+    FILE** resized = (FILE**) realloc(runs->files, sizeof(FILE*) * new_capacity);
+
+    if (resized == NULL) return false;
+
+    runs->files = resized;
+    runs->capacity = new_capacity;
+  }
+
+  runs->files[runs->count] = file;
+  runs->count += 1;
+
+  return true;
+}
+
+void free_runs(RunList* runs) {
+  if (runs == NULL) return;
+
+  for (size_t i = 0; i < runs->count; i++) {
+    fclose(runs->files[i]);
+  }
+
+  free(runs->files);
+  runs->files = NULL;
+  runs->count = 0;
+  runs->capacity = 0;
+}
+
+/**
+ * Read the input run_values at a time, sort each chunk in memory and write it to its own temp file
+ * The temp files come from tmpfile() so they are deleted when closed (or when the program exits)
+ *
+ * @param: in -> The input file of uint16_t values
+ * @param: run_values -> The number of values per run
+ * @param: stats -> Filled in with the number of values, runs and time taken (can be NULL)
+ * @returns: The runs, failed is set (and count is 0) if a buffer, temp file, write or read failed
+ */
+
+RunList make_runs(FILE* in, size_t run_values, SortStats* stats) {
+  RunList runs = { .count = 0, .capacity = 0, .files = NULL, .failed = false };
+  uint16_t* chunk = (uint16_t*) malloc(sizeof(uint16_t) * run_values);
+  uint32_t* counts = (uint32_t*) malloc(sizeof(uint32_t) * (UINT16_MAX + 1));
+  struct timespec start, end;
+  size_t values = 0;
+
+  if (chunk == NULL || counts == NULL) {
+    DEBUG_PRINT("Error Allocating a %zu value run buffer\n", run_values);
+    free(chunk);
+    free(counts);
+    runs.failed = true;
+    return runs;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while (true) {
+    size_t count = fread(chunk, sizeof(uint16_t), run_values, in);
+
+    if (count == 0) break;
+
+    sort_run(chunk, count, counts);
+
+    FILE* run = tmpfile();
+
+    if (run == NULL || !run_list_push(&runs, run)) {
+      DEBUG_PRINT("Error: Could not create temp file for run %zu\n", runs.count);
+      if (run != NULL) fclose(run);
+      free_runs(&runs);
+      runs.failed = true;
+      break;
+    }
+
+    setvbuf(run, NULL, _IOFBF, IO_BUFFER_SIZE);
+
+    if (fwrite(chunk, sizeof(uint16_t), count, run) != count) {
+      DEBUG_PRINT("Error writing run %zu\n", runs.count - 1);
+      free_runs(&runs);
+      runs.failed = true;
+      break;
+    }
+
+    values += count;
+  }
+
+  // fread(...) returns 0 for a read error as well as the end of the file
+  if (!runs.failed && ferror(in)) {
+    DEBUG_PRINT("Error reading the input after %zu values\n", values);
+    free_runs(&runs);
+    runs.failed = true;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  free(chunk);
+  free(counts);
+
+  if (stats != NULL) {
+    stats->values = values;
+    stats->runs = runs.count;
+    stats->run_seconds = elapsed_seconds(start, end);
+  }
+
+  return runs;
+}
+
+/**
+ * Get the next value of a run, refilling its buffer from the file when it runs dry
+ *
+ * @param: run -> The run to read from
+ * @param: value -> Set to the next value
+ * @returns: false once the run is exhausted - or on a read error, check ferror(run->file) to tell them apart
+ */
+
+static bool run_next(Run* run, uint16_t* value) {
+  if (run->idx == run->count) {
+    run->count = fread(run->buffer, sizeof(uint16_t), MERGE_BUFFER_VALUES, run->file);
+    run->idx = 0;
+
+    if (run->count == 0) return false;
+  }
+
+  *value = run->buffer[run->idx];
+  run->idx += 1;
+
+  return true;
+}
+
+/**
+ * K-way merge the runs into out
+ * The heap holds the next value of every run, the top is written out and replaced by the next value from the same run
+ *
+ * @param: runs -> The runs from make_runs(...), they are rewound first so the same runs can be merged again
+ * @param: out -> The file to write the sorted values to
+ * @param: use_replace_top -> Use merge_heap_replace_top(...) (one sift per value) rather than extract + insert (two sifts)
+ * @param: stats -> merge_seconds is filled in (can be NULL)
+ * @returns: false if a buffer could not be allocated, a run could not be read back or a write failed
+ */
+
+bool merge_runs(RunList* runs, FILE* out, bool use_replace_top, SortStats* stats) {
+  Run* readers = (Run*) malloc(sizeof(Run) * runs->count);
+  uint16_t* out_buffer = (uint16_t*) malloc(sizeof(uint16_t) * MERGE_BUFFER_VALUES);
+  MergeHeap heap = merge_heap_initialize();
+  struct timespec start, end;
+  size_t out_count = 0;
+  bool ok = true;
+
+  if (readers == NULL || out_buffer == NULL || !merge_heap_reserve(&heap, runs->count)) {
+    DEBUG_PRINT("Error Allocating the merge buffers for %zu runs\n", runs->count);
+    free(readers);
+    free(out_buffer);
+    merge_heap_free(&heap);
+    return false;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (size_t i = 0; i < runs->count; i++) {
+    rewind(runs->files[i]);
+    readers[i].file = runs->files[i];
+    readers[i].buffer = (uint16_t*) malloc(sizeof(uint16_t) * MERGE_BUFFER_VALUES);
+    readers[i].count = 0;
+    readers[i].idx = 0;
+
+    uint16_t value;
+
+    if (readers[i].buffer == NULL) {
+      ok = false;
+      continue;
+    }
+
+    if (run_next(&readers[i], &value)) {
+      RunHead head = { .value = value, .run_id = (uint32_t) i };
+      merge_heap_insert(&heap, head);
+    } else if (ferror(readers[i].file)) {
+      DEBUG_PRINT("Error reading run %zu\n", i);
+      ok = false;
+    }
+  }
+
+  while (ok && heap.size > 0) {
+    RunHead top = heap.heap[0].data;
+    RunHead next = { .value = 0, .run_id = top.run_id };
+
+    if (run_next(&readers[top.run_id], &next.value)) {
+      if (use_replace_top) {
+        merge_heap_replace_top(&heap, next, NULL);
+      } else {
+        merge_heap_extract(&heap, NULL);
+        merge_heap_insert(&heap, next);
+      }
+    } else if (ferror(readers[top.run_id].file)) {
+      // A run that stops early on a read error would leave the output short - that's a failed merge, not the end of the run
+      DEBUG_PRINT("Error reading run %u\n", top.run_id);
+      ok = false;
+      break;
+    } else {
+      merge_heap_extract(&heap, NULL);
+    }
+
+    out_buffer[out_count] = top.value;
+    out_count += 1;
+
+    if (out_count == MERGE_BUFFER_VALUES) {
+      ok = fwrite(out_buffer, sizeof(uint16_t), out_count, out) == out_count;
+      out_count = 0;
+    }
+  }
+
+  if (ok && out_count > 0) ok = fwrite(out_buffer, sizeof(uint16_t), out_count, out) == out_count;
+  if (ok) ok = fflush(out) == 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  if (!ok) DEBUG_PRINT("Error merging the runs into the output\n", NULL);
+
+  if (stats != NULL) stats->merge_seconds = elapsed_seconds(start, end);
+
+  for (size_t i = 0; i < runs->count; i++) free(readers[i].buffer);
+
+  free(readers);
+  free(out_buffer);
+  merge_heap_free(&heap);
+
+  return ok;
+}
+
+/**
+ * Sort a whole file - Make the runs then merge them
+ *
+ * @param: in -> The input file of uint16_t values
+ * @param: out -> The file to write the sorted values to
+ * @param: run_values -> The number of values sorted in memory at a time
+ * @param: stats -> Filled in with the sizes and times (can be NULL)
+ * @returns: false if anything failed
+ */
+
+bool sort_file(FILE* in, FILE* out, size_t run_values, SortStats* stats) {
+  if (in == NULL || out == NULL || run_values == 0) return false;
+
+  RunList runs = make_runs(in, run_values, stats);
+
+  if (runs.failed) return false;
+  if (runs.count == 0) return true;
+
+  bool ok = merge_runs(&runs, out, true, stats);
+
+  free_runs(&runs);
+
+  return ok;
+}
+
+void print_stats(const char* label, SortStats* stats, double merge_seconds) {
+  double mb = stats->values * sizeof(uint16_t) / (1024.0 * 1024.0);
+
+  printf("%s: %.1f MB in %zu runs, runs %.1f MB/s, merge %.1f MB/s, total %.1f MB/s\n", label, mb, stats->runs, mb / stats->run_seconds, mb / merge_seconds, mb / (stats->run_seconds + merge_seconds));
+}
+
+/**
+ * ===========
+ * || Tests ||
+ * ===========
+ */
+
+// Write n pseudo random values to a temp file
+
+FILE* random_file(size_t n) {
+  FILE* file = tmpfile();
+  uint32_t seed = 12345;
+
+  if (file == NULL) return NULL;
+
+  setvbuf(file, NULL, _IOFBF, IO_BUFFER_SIZE);
+
+  for (size_t i = 0; i < n; i++) {
+    seed = seed * 1103515245 + 12345;
+    uint16_t value = (uint16_t) (seed >> 16);
+    fwrite(&value, sizeof(uint16_t), 1, file);
+  }
+
+  rewind(file);
+
+  return file;
+}
+
+// Read the output back and check it is in order, has every value and adds up to the same total as the input
+
+bool check_sorted(FILE* in, FILE* out, size_t n) {
+  uint64_t in_sum = 0, out_sum = 0;
+  size_t count = 0;
+  uint16_t value, prev = 0;
+  bool ordered = true;
+
+  rewind(in);
+  rewind(out);
+
+  while (fread(&value, sizeof(uint16_t), 1, in) == 1) in_sum += value;
+
+  while (fread(&value, sizeof(uint16_t), 1, out) == 1) {
+    if (value < prev) ordered = false;
+    prev = value;
+    out_sum += value;
+    count += 1;
+  }
+
+  return ordered && count == n && in_sum == out_sum;
+}
+
+void test_sort_file() {
+  printf("==================\n");
+  printf("|| Sort File    ||\n");
+  printf("==================\n\n");
+
+  size_t sizes[] = { 0, 1, 1000, 100003 };
+  size_t run_values[] = { 1000, 7, 64, 4096 };
+
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(size_t); i++) {
+    FILE* in = random_file(sizes[i]);
+    FILE* out = tmpfile();
+    SortStats stats = { 0 };
+
+    if (in == NULL || out == NULL) return;
+
+    bool ok = sort_file(in, out, run_values[i], &stats);
+
+    printf("%zu values, %zu per run (%zu runs): %s\n", sizes[i], run_values[i], stats.runs, ok && check_sorted(in, out, sizes[i]) ? "sorted" : "NOT sorted");
+
+    fclose(in);
+    fclose(out);
+  }
+
+  // A file opened for writing can't be read, that has to fail rather than "sort" to an empty output
+  FILE* write_only = fopen("/dev/null", "w");
+  FILE* out = tmpfile();
+
+  if (write_only != NULL && out != NULL) {
+    printf("Unreadable input rejected: %s\n", sort_file(write_only, out, 64, NULL) ? "false" : "true");
+  }
+
+  if (write_only != NULL) fclose(write_only);
+  if (out != NULL) fclose(out);
+
+  // Same for a run that can't be read back during the merge - swap one for a write only file
+  FILE* in = random_file(1000);
+  FILE* unreadable = fopen("/dev/null", "w");
+  out = tmpfile();
+
+  if (in != NULL && unreadable != NULL && out != NULL) {
+    RunList runs = make_runs(in, 64, NULL);
+
+    if (runs.count > 1) {
+      fclose(runs.files[1]);
+      runs.files[1] = unreadable;
+      unreadable = NULL;
+
+      printf("Unreadable run rejected: %s\n", merge_runs(&runs, out, true, NULL) ? "false" : "true");
+    }
+
+    free_runs(&runs);
+  }
+
+  if (in != NULL) fclose(in);
+  if (unreadable != NULL) fclose(unreadable);
+  if (out != NULL) fclose(out);
+
+  printf("\n");
+}
+
+void test_replace_top() {
+  printf("==================\n");
+  printf("|| Replace Top  ||\n");
+  printf("==================\n\n");
+
+  MergeHeap heap = merge_heap_initialize();
+  uint16_t values[] = { 38, 384, 27, 46 };
+
+  for (uint32_t i = 0; i < 4; i++) {
+    RunHead head = { .value = values[i], .run_id = i };
+    merge_heap_insert(&heap, head);
+  }
+
+  RunHead replacement = { .value = 400, .run_id = 2 };
+  RunHead top = { 0 };
+
+  merge_heap_replace_top(&heap, replacement, &top);
+
+  printf("Replaced %u (run %u) with 400, new top: %u (run %u)\n", top.value, top.run_id, heap.heap[0].data.value, heap.heap[0].data.run_id);
+  while (heap.size > 0) merge_heap_extract(&heap, NULL);
+
+  printf("Replace on an empty heap rejected: %s\n\n", merge_heap_replace_top(&heap, replacement, NULL) ? "false" : "true");
+
+  merge_heap_free(&heap);
+}
+
+void run_tests() {
+  test_replace_top();
+
+  test_sort_file();
+
+}
+
+/**
+ * ================
+ * || Benchmarks ||
+ * ================
+ */
+
+// 64MB of values sorted 1M values (2MB) at a time, so the merge has 32 runs - merged once with replace_top and once without
+
+void bench_external_sort() {
+  printf("==================\n");
+  printf("|| External Sort||\n");
+  printf("==================\n\n");
+
+  size_t n = BENCHMARK_SIZE * 32;
+  FILE* in = random_file(n);
+  FILE* out = tmpfile();
+  SortStats stats = { 0 };
+
+  if (in == NULL || out == NULL) return;
+
+  setvbuf(out, NULL, _IOFBF, IO_BUFFER_SIZE);
+
+  RunList runs = make_runs(in, BENCHMARK_SIZE, &stats);
+
+  merge_runs(&runs, out, true, &stats);
+  double replace_seconds = stats.merge_seconds;
+  bool sorted = check_sorted(in, out, n);
+
+  rewind(out);
+  merge_runs(&runs, out, false, &stats);
+  double extract_seconds = stats.merge_seconds;
+
+  print_stats("replace_top     ", &stats, replace_seconds);
+  print_stats("extract + insert", &stats, extract_seconds);
+  printf("Sorted: %s\n\n", sorted ? "true" : "false");
+
+  free_runs(&runs);
+  fclose(in);
+  fclose(out);
+}
+
+void run_benchmarks() {
+  bench_external_sort();
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    run_tests();
+
+    if (RUN_BENCHMARKS) run_benchmarks();
+
+    return 0;
+  }
+
+  size_t run_values = argc > 3 ? strtoull(argv[3], NULL, 10) : DEFAULT_RUN_VALUES;
+  FILE* in = fopen(argv[1], "rb");
+  FILE* out = fopen(argv[2], "wb");
+  SortStats stats = { 0 };
+
+  if (in == NULL || out == NULL) {
+    DEBUG_PRINT("Error: Could not open %s or %s\n", argv[1], argv[2]);
+    return EXIT_FAILURE;
+  }
+
+  setvbuf(in, NULL, _IOFBF, IO_BUFFER_SIZE);
+  setvbuf(out, NULL, _IOFBF, IO_BUFFER_SIZE);
+
+  bool ok = sort_file(in, out, run_values, &stats);
+
+  fclose(in);
+  fclose(out);
+
+  if (!ok) return EXIT_FAILURE;
+
+  if (stats.runs > 0) print_stats(argv[2], &stats, stats.merge_seconds);
+
+  return 0;
+}
@@ -0,0 +1,848 @@
+/**
+ * *--------------------------*
+ * * Generic Heap (heap.h)    *
+ * *--------------------------*
+ *
+ * min-heap.c and max-heap.c used to be two copies of the same file with the comparisons flipped and a fixed uint16_t payload.
+ * This header holds the one copy of the heap code and DEFINE_HEAP(...) stamps out a heap for a given element type and ordering:
+ *
+ *   DEFINE_HEAP(Type, prefix, T, HIGHER)
+ *
+ * - Type   -> The name of the heap struct to generate (e.g MaxHeap). The node struct is called Type##Node (e.g MaxHeapNode)
+ * - prefix -> The prefix for every generated function (e.g max_heap gives max_heap_insert, max_heap_extract ...)
+ * - T      -> The element type stored in the heap - anything that can be assigned, so a struct works for key/ value payloads
+ * - HIGHER -> A macro HIGHER(a, b) that is true when a belongs above b (closer to the root)
+ *
+ * HIGHER is a macro rather than a function pointer so it is pasted straight into the sift loops and the compiler can inline it.
+ * There is no indirect call per comparison so a custom key costs nothing over the old hard-coded uint16_t comparisons.
+ *
+ *   #define MIN_HIGHER(a, b) ((a) < (b))
+ *   DEFINE_HEAP(MinHeap, min_heap, uint16_t, MIN_HIGHER)
+ *
+ *   #define TASK_HIGHER(a, b) ((a).priority > (b).priority)
+ *   DEFINE_HEAP(TaskHeap, task_heap, Task, TASK_HIGHER)
+ *
+ *   DEFINE_INDEXED_HEAP(Type, prefix, T, HIGHER) is the same heap with handles (see the Heap Generator section below)
+ *
+ * Every generated heap has:
+ *
+ * - Nodes stored inline in one array, sifted by moving a "hole" rather than swapping
+ * - Geometric growth, reserve(), shrink_to_fit() and the optional AUTO_SHRINK hysteresis
+ * - An O(n) Floyd build from an array, build_parallel() to spread it over threads and insert_batch() for bulk loads
+ * - replace_top() to swap the top for a new node with a single sift (k-way merges, top-K)
+ * - Optionally (DEFINE_INDEXED_HEAP) a stable handle per insert and a position map for O(log n) delete and key updates
+ * - HEAP_ARITY children per node (2 unless overridden with -DHEAP_ARITY=4 etc)
+ *
+ * DEFINE_HEAP_SORT(prefix, T, HIGHER) generates an in place heapsort and partial sort for plain T arrays (see below).
+ *
+ * The generated functions are static inline so a file only pays for the ones it calls.
+ * The index helpers (heap_first_child_idx etc) take the arity as a parameter so other heap shaped structures can share them.
+ */
+
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifndef INITIAL_HEAP_CAPACITY
+#define INITIAL_HEAP_CAPACITY 20
+#endif
+
+// The number of children each node has - Override when compiling with -DHEAP_ARITY=4
+// A wider heap is shallower and the children of a node sit next to each other in memory
+#ifndef HEAP_ARITY
+#define HEAP_ARITY 2
+#endif
+
+#ifndef HEAP_GROWTH_FACTOR
+#define HEAP_GROWTH_FACTOR 2
+#endif
+
+#ifndef HEAP_SHRINK_FACTOR
+#define HEAP_SHRINK_FACTOR 4
+#endif
+
+#ifndef AUTO_SHRINK
+#define AUTO_SHRINK false
+#endif
+
+#define INVALID_HANDLE SIZE_MAX
+
+#ifndef DEBUG_PRINT
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+// Define HEAP_PARALLEL (and compile with -pthread) to spread build_parallel() over the work stealing pool
+// Without it build_parallel() does the same work in the same order on the calling thread
+#ifdef HEAP_PARALLEL
+#include "../array/work-stealing-deque/work-pool.h"
+#endif
+
+// build_parallel() splits the heap into at least this many subtrees per thread so a thread that gets short subtrees
+// (the bottom level is only partly filled) can pick up more work
+#ifndef HEAP_TASKS_PER_THREAD
+#define HEAP_TASKS_PER_THREAD 4
+#endif
+
+/**
+ * =====================
+ * || Index Helpers   ||
+ * =====================
+ */
+
+/**
+ * Get the first (left most) child of a given node
+ *
+ * @param: idx -> The index of the current node
+ * @param: size -> The number of nodes in the heap
+ * @param: arity -> The number of children per node
+ * @returns: The first child index in the heap or -1 if the node has no children
+ */
+
+static inline int64_t heap_first_child_idx(size_t idx, size_t size, size_t arity) {
+  size_t c_idx = (idx * arity) + 1;
+
+  if (c_idx >= size) return -1;
+
+  return c_idx;
+}
+
+/**
+ * Get the last child of a given node - Only valid when heap_first_child_idx(...) is not -1
+ * The children of idx are every index from the first child to the last child inclusive
+ *
+ * @param: idx -> The index of the current node
+ * @param: size -> The number of nodes in the heap
+ * @param: arity -> The number of children per node
+ * @returns: The last child index that is inside the heap
+ */
+
+static inline size_t heap_last_child_idx(size_t idx, size_t size, size_t arity) {
+  size_t c_idx = (idx * arity) + arity;
+
+  if (c_idx >= size) return size - 1;
+
+  return c_idx;
+}
+
+/**
+ * Get the parent of a given node
+ *
+ * @param: idx -> The current nodes index in the heap
+ * @param: arity -> The number of children per node
+ * @returns: The index of the parent or -1 if the node is the root
+ */
+
+static inline int64_t heap_parent_idx(size_t idx, size_t arity) {
+  if (idx == 0) return -1;
+
+  return (idx - 1) / arity;
+}
+
+/**
+ * =====================
+ * || Parallel For    ||
+ * =====================
+ */
+
+typedef void (*HeapTaskFn)(void* context, size_t task);
+
+#ifdef HEAP_PARALLEL
+
+// A pool for heap_parallel_for to reuse between calls, NULL means each call starts (and stops) its own
+static WorkPool* heap_work_pool = NULL;
+
+/**
+ * Run every heap_parallel_for (build_parallel() etc) on an existing pool rather than starting threads each call
+ *
+ * @param: pool -> The pool to use (its size wins over the threads argument), NULL to go back to a pool per call
+ */
+
+static inline void heap_use_work_pool(WorkPool* pool) {
+  heap_work_pool = pool;
+}
+
+#endif
+
+/**
+ * Run fn(context, 0) ... fn(context, task_count - 1), spread over up to threads threads when HEAP_PARALLEL is defined
+ * The tasks are split in halves over the fork-join pool in array/work-stealing-deque, so a thread that finishes
+ * its share early steals the biggest half still waiting rather than sitting idle. The calling thread works too
+ *
+ * @param: fn -> The task to run, tasks must not touch the same memory
+ * @param: context -> Passed to every call of fn
+ * @param: task_count -> The number of tasks
+ * @param: threads -> The most threads to use (including the caller)
+ */
+
+static inline void heap_parallel_for(HeapTaskFn fn, void* context, size_t task_count, size_t threads) {
+#ifdef HEAP_PARALLEL
+  if (heap_work_pool != NULL) {
+    work_pool_parallel_for(heap_work_pool, fn, context, task_count, 1);
+    return;
+  }
+
+  if (threads > task_count) threads = task_count;
+
+  WorkPool pool;
+
+  // If the pool can't be started the calling thread still runs every task below
+  if (threads > 1 && work_pool_initialize(&pool, threads)) {
+    work_pool_parallel_for(&pool, fn, context, task_count, 1);
+    work_pool_free(&pool);
+    return;
+  }
+#else
+  (void) threads;
+#endif
+
+  for (size_t task = 0; task < task_count; task++) fn(context, task);
+}
+
+/**
+ * =====================
+ * || Heap Sort       ||
+ * =====================
+ */
+
+/**
+ * DEFINE_HEAP_SORT(prefix, T, HIGHER) sorts a plain T array in place using the array itself as the heap
+ * No heap struct, handles or allocation - just the same hole sift down as DEFINE_HEAP's heapify, as a loop not recursion
+ *
+ * - prefix##_heapsort(a, n) -> Sorts so that no element is HIGHER than the one after it (ascending for a max ordering)
+ * - prefix##_partial_sort(a, n, k) -> Puts the k lowest elements, sorted, in a[0 .. k - 1] in O(n log k), the rest are left in any order
+ *
+ *   #define MAX_HIGHER(a, b) ((a) > (b))
+ *   DEFINE_HEAP_SORT(max_heap, uint16_t, MAX_HIGHER)   ->   max_heap_heapsort(values, n) sorts ascending
+ */
+
+#define DEFINE_HEAP_SORT(prefix, T, HIGHER)                                                         \
+                                                                                                    \
+/* Sift a[idx] down in the heap a[0 .. n - 1], moving the hole rather than swapping */              \
+static inline void prefix##_sift_down_array(T* a, size_t n, size_t idx) {                           \
+  T current = a[idx];                                                                               \
+                                                                                                    \
+  while (true) {                                                                                    \
+    int64_t first_idx = heap_first_child_idx(idx, n, HEAP_ARITY);                                   \
+                                                                                                    \
+    if (first_idx == -1) break;                                                                     \
+                                                                                                    \
+    size_t last_idx = heap_last_child_idx(idx, n, HEAP_ARITY);                                      \
+    size_t highest_idx = first_idx;                                                                 \
+                                                                                                    \
+    for (size_t c_idx = first_idx + 1; c_idx <= last_idx; c_idx++) {                                \
+      if (HIGHER(a[c_idx], a[highest_idx])) highest_idx = c_idx;                                    \
+    }                                                                                               \
+                                                                                                    \
+    if (!HIGHER(a[highest_idx], current)) break;                                                    \
+                                                                                                    \
+    a[idx] = a[highest_idx];                                                                        \
+    idx = highest_idx;                                                                              \
+  }                                                                                                 \
+                                                                                                    \
+  a[idx] = current;                                                                                 \
+}                                                                                                   \
+                                                                                                    \
+/* Floyd's build on a[0 .. n - 1] */                                                                \
+static inline void prefix##_heapify_array(T* a, size_t n) {                                         \
+  if (n < 2) return;                                                                                \
+                                                                                                    \
+  for (size_t i = (n - 1 + HEAP_ARITY - 1) / HEAP_ARITY; i > 0; i--) {                              \
+    prefix##_sift_down_array(a, n, i - 1);                                                          \
+  }                                                                                                 \
+}                                                                                                   \
+                                                                                                    \
+/* Build a heap then swap the top to the end of the shrinking heap n - 1 times, O(n log n) */       \
+static inline void prefix##_heapsort(T* a, size_t n) {                                              \
+  if (a == NULL || n < 2) return;                                                                   \
+                                                                                                    \
+  prefix##_heapify_array(a, n);                                                                     \
+                                                                                                    \
+  for (size_t end = n - 1; end > 0; end--) {                                                        \
+    T top = a[0];                                                                                   \
+    a[0] = a[end];                                                                                  \
+    a[end] = top;                                                                                   \
+    prefix##_sift_down_array(a, end, 0);                                                            \
+  }                                                                                                 \
+}                                                                                                   \
+                                                                                                    \
+/* Keep a heap of the k lowest so far in a[0 .. k - 1], anything after that is lower than the */    \
+/* top replaces it. Then heapsort those k - O(n log k) rather than sorting all n */                 \
+static inline void prefix##_partial_sort(T* a, size_t n, size_t k) {                                \
+  if (a == NULL || k == 0) return;                                                                  \
+  if (k > n) k = n;                                                                                 \
+                                                                                                    \
+  prefix##_heapify_array(a, k);                                                                     \
+                                                                                                    \
+  for (size_t i = k; i < n; i++) {                                                                  \
+    if (!HIGHER(a[0], a[i])) continue;                                                              \
+                                                                                                    \
+    T top = a[0];                                                                                   \
+    a[0] = a[i];                                                                                    \
+    a[i] = top;                                                                                     \
+    prefix##_sift_down_array(a, k, 0);                                                              \
+  }                                                                                                 \
+                                                                                                    \
+  prefix##_heapsort(a, k);                                                                          \
+}
+
+/**
+ * =====================
+ * || Heap Generator  ||
+ * =====================
+ */
+
+// HEAP_IF(flag, code) keeps code only when flag is 1 and HEAP_UNLESS(flag, code) only when it is 0
+// HEAP_PICK(flag, a, b) is a when flag is 1 and b when it is 0. flag must be a literal 0 or 1 as it is pasted onto the name
+#define HEAP_IF_0(...)
+#define HEAP_IF_1(...) __VA_ARGS__
+#define HEAP_IF(flag, ...) HEAP_IF_##flag(__VA_ARGS__)
+
+#define HEAP_UNLESS_0(...) __VA_ARGS__
+#define HEAP_UNLESS_1(...)
+#define HEAP_UNLESS(flag, ...) HEAP_UNLESS_##flag(__VA_ARGS__)
+
+#define HEAP_PICK_0(a, b) b
+#define HEAP_PICK_1(a, b) a
+#define HEAP_PICK(flag, a, b) HEAP_PICK_##flag(a, b)
+
+/**
+ * DEFINE_HEAP(...) is the plain heap - a node is just the data, so a uint16_t heap costs 2 bytes a slot
+ * DEFINE_INDEXED_HEAP(...) adds the handles: insert() returns a stable handle and contains(), delete(), promote(),
+ * demote() and update() find the node through a position map in O(1). That is a size_t in every node plus the position
+ * map and the free handle stack (another 2 size_ts per slot), so only ask for it when something holds on to handles
+ */
+
+#define DEFINE_HEAP(Type, prefix, T, HIGHER) HEAP_DEFINE_IMPL(Type, prefix, T, HIGHER, 0)
+#define DEFINE_INDEXED_HEAP(Type, prefix, T, HIGHER) HEAP_DEFINE_IMPL(Type, prefix, T, HIGHER, 1)
+
+#define HEAP_DEFINE_IMPL(Type, prefix, T, HIGHER, HANDLES)                                          \
+                                                                                                    \
+/* handle is the stable id insert() hands back, it stays the same however far the node moves */     \
+/* (indexed heaps only - a plain heap's node is just the data) */                                   \
+typedef struct {                                                                                    \
+  T data;                                                                                           \
+  HEAP_IF(HANDLES, size_t handle;)                                                                  \
+} Type##Node;                                                                                       \
+                                                                                                    \
+/* positions[handle] is the index of that handle's node (INVALID_HANDLE once it has left) */        \
+/* free_handles is a stack of released handles that are handed out again before new ones */         \
+typedef struct {                                                                                    \
+  size_t size;                                                                                      \
+  size_t capacity;                                                                                  \
+  Type##Node* heap;                                                                                 \
+  HEAP_IF(HANDLES, size_t* positions;)                                                              \
+  HEAP_IF(HANDLES, size_t* free_handles;)                                                           \
+  HEAP_IF(HANDLES, size_t free_count;)                                                              \
+  HEAP_IF(HANDLES, size_t next_handle;)                                                             \
+  HEAP_IF(HANDLES, size_t handle_capacity;)                                                         \
+} Type;                                                                                             \
+                                                                                                    \
+static inline void prefix##_heapify(Type* heap, size_t idx);                                        \
+                                                                                                    \
+/* Initialize an empty heap with INITIAL_HEAP_CAPACITY slots, exits if the memory can't be had */   \
+static inline Type prefix##_initialize(void) {                                                      \
+  Type heap;                                                                                        \
+  heap.heap = (Type##Node*) malloc(sizeof(Type##Node) * INITIAL_HEAP_CAPACITY);                     \
+  bool allocated = heap.heap != NULL;                                                               \
+                                                                                                    \
+  HEAP_IF(HANDLES,                                                                                  \
+    heap.positions = (size_t*) malloc(sizeof(size_t) * INITIAL_HEAP_CAPACITY);                      \
+    heap.free_handles = (size_t*) malloc(sizeof(size_t) * INITIAL_HEAP_CAPACITY);                   \
+    allocated = allocated && heap.positions != NULL && heap.free_handles != NULL;                   \
+    heap.free_count = 0;                                                                            \
+    heap.next_handle = 0;                                                                           \
+    heap.handle_capacity = INITIAL_HEAP_CAPACITY;                                                   \
+  )                                                                                                 \
+                                                                                                    \
+  if (!allocated) {                                                                                 \
+    DEBUG_PRINT("Error Allocating memory for the heap\n\n", NULL);                                  \
+    exit(EXIT_FAILURE);                                                                             \
+  }                                                                                                 \
+                                                                                                    \
+  heap.size = 0;                                                                                    \
+  heap.capacity = INITIAL_HEAP_CAPACITY;                                                            \
+                                                                                                    \
+  return heap;                                                                                      \
+}                                                                                                   \
+                                                                                                    \
+/* Free the heap arrays - the nodes live inside the array so there is nothing else to free */       \
+static inline void prefix##_free(Type* heap) {                                                      \
+  if (heap == NULL) return;                                                                         \
+                                                                                                    \
+  free(heap->heap);                                                                                 \
+  heap->heap = NULL;                                                                                \
+  heap->size = 0;                                                                                   \
+  heap->capacity = 0;                                                                               \
+                                                                                                    \
+  HEAP_IF(HANDLES,                                                                                  \
+    free(heap->positions);                                                                          \
+    free(heap->free_handles);                                                                       \
+    heap->positions = NULL;                                                                         \
+    heap->free_handles = NULL;                                                                      \
+    heap->free_count = 0;                                                                           \
+    heap->next_handle = 0;                                                                          \
+    heap->handle_capacity = 0;                                                                      \
+  )                                                                                                 \
+}                                                                                                   \
+                                                                                                    \
+/* Resize the node array (never below the size). The handle tables only ever grow as handles */     \
+/* can be out up to the largest capacity the heap has had, and they grow first so capacity is */    \
+/* only raised once there is a table slot for every node. false if a realloc failed */              \
+static inline bool prefix##_resize(Type* heap, size_t new_capacity) {                               \
+  if (heap == NULL) return false;                                                                   \
+                                                                                                    \
+  if (new_capacity < heap->size) new_capacity = heap->size;                                         \
+  if (new_capacity == 0) new_capacity = 1;                                                          \
+  if (new_capacity > SIZE_MAX / sizeof(Type##Node)) return false;                                   \
+                                                                                                    \
+  HEAP_IF(HANDLES,                                                                                  \
+    if (new_capacity > heap->handle_capacity) {                                                     \
+      size_t* positions = (size_t*) realloc(heap->positions, sizeof(size_t) * new_capacity);        \
+                                                                                                    \
+      if (positions == NULL) {                                                                      \
+        DEBUG_PRINT("Error reallocating the position map to %zu slots\n", new_capacity);            \
+        return false;                                                                               \
+      }                                                                                             \
+                                                                                                    \
+      heap->positions = positions;                                                                  \
+                                                                                                    \
+      size_t* free_handles = (size_t*) realloc(heap->free_handles, sizeof(size_t) * new_capacity);  \
+                                                                                                    \
+      if (free_handles == NULL) {                                                                   \
+        DEBUG_PRINT("Error reallocating the free handles to %zu slots\n", new_capacity);            \
+        return false;                                                                               \
+      }                                                                                             \
+                                                                                                    \
+      heap->free_handles = free_handles;                                                            \
+      heap->handle_capacity = new_capacity;                                                         \
+    }                                                                                               \
+  )                                                                                                 \
+                                                                                                    \
+  Type##Node* resized = (Type##Node*) realloc(heap->heap, sizeof(Type##Node) * new_capacity);       \
+                                                                                                    \
+  if (resized == NULL) {                                                                            \
+    DEBUG_PRINT("Error reallocating the heap to %zu slots\n", new_capacity);                        \
+    return false;                                                                                   \
+  }                                                                                                 \
+                                                                                                    \
+  heap->heap = resized;                                                                             \
+  heap->capacity = new_capacity;                                                                    \
+                                                                                                    \
+  return true;                                                                                      \
+}                                                                                                   \
+                                                                                                    \
+/* Grow the heap up front so a bulk load never reallocates partway through */                       \
+static inline bool prefix##_reserve(Type* heap, size_t capacity) {                                  \
+  if (heap == NULL) return false;                                                                   \
+  if (capacity <= heap->capacity) return true;                                                      \
+                                                                                                    \
+  return prefix##_resize(heap, capacity);                                                           \
+}                                                                                                   \
+                                                                                                    \
+/* Make room for extra more nodes, growing by HEAP_GROWTH_FACTOR until they fit. Growth starts */   \
+/* from 1 slot after free() and stops at exactly the size needed rather than overflow */            \
+static inline bool prefix##_make_room(Type* heap, size_t extra) {                                   \
+  if (extra > SIZE_MAX - heap->size) return false;                                                  \
+  if (heap->size + extra <= heap->capacity) return true;                                            \
+                                                                                                    \
+  size_t needed = heap->size + extra;                                                               \
+  size_t capacity = heap->capacity == 0 ? 1 : heap->capacity;                                       \
+                                                                                                    \
+  while (capacity < needed) {                                                                       \
+    if (capacity > SIZE_MAX / HEAP_GROWTH_FACTOR) {                                                 \
+      capacity = needed;                                                                            \
+      break;                                                                                        \
+    }                                                                                               \
+                                                                                                    \
+    capacity *= HEAP_GROWTH_FACTOR;                                                                 \
+  }                                                                                                 \
+                                                                                                    \
+  return prefix##_resize(heap, capacity);                                                           \
+}                                                                                                   \
+                                                                                                    \
+static inline void prefix##_shrink_to_fit(Type* heap) {                                             \
+  if (heap == NULL || heap->size == heap->capacity) return;                                         \
+                                                                                                    \
+  prefix##_resize(heap, heap->size);                                                                \
+}                                                                                                   \
+                                                                                                    \
+/* Halve the capacity at a quarter full (AUTO_SHRINK only), the gap to the growth point */          \
+/* stops a heap hovering around a boundary from thrashing realloc */                                \
+static inline void prefix##_maybe_shrink(Type* heap) {                                              \
+  if (!AUTO_SHRINK) return;                                                                         \
+  if (heap->capacity <= INITIAL_HEAP_CAPACITY) return;                                              \
+  if (heap->size > heap->capacity / HEAP_SHRINK_FACTOR) return;                                     \
+                                                                                                    \
+  size_t new_capacity = heap->capacity / HEAP_GROWTH_FACTOR;                                        \
+  if (new_capacity < INITIAL_HEAP_CAPACITY) new_capacity = INITIAL_HEAP_CAPACITY;                   \
+                                                                                                    \
+  prefix##_resize(heap, new_capacity);                                                              \
+}                                                                                                   \
+                                                                                                    \
+HEAP_IF(HANDLES,                                                                                    \
+  /* Released handles are reused first, next_handle never passes the largest size reached */        \
+  static inline size_t prefix##_acquire_handle(Type* heap) {                                        \
+    if (heap->free_count > 0) {                                                                     \
+      heap->free_count -= 1;                                                                        \
+      return heap->free_handles[heap->free_count];                                                  \
+    }                                                                                               \
+                                                                                                    \
+    size_t handle = heap->next_handle;                                                              \
+    heap->next_handle += 1;                                                                         \
+                                                                                                    \
+    return handle;                                                                                  \
+  }                                                                                                 \
+                                                                                                    \
+  static inline void prefix##_release_handle(Type* heap, size_t handle) {                           \
+    heap->positions[handle] = INVALID_HANDLE;                                                       \
+    heap->free_handles[heap->free_count] = handle;                                                  \
+    heap->free_count += 1;                                                                          \
+  }                                                                                                 \
+)                                                                                                   \
+                                                                                                    \
+/* A new node for data, with a fresh handle on an indexed heap */                                   \
+static inline Type##Node prefix##_make_node(Type* heap, T data) {                                   \
+  Type##Node node;                                                                                  \
+  node.data = data;                                                                                 \
+  HEAP_IF(HANDLES, node.handle = prefix##_acquire_handle(heap);)                                    \
+  HEAP_UNLESS(HANDLES, (void) heap;)                                                                \
+                                                                                                    \
+  return node;                                                                                      \
+}                                                                                                   \
+                                                                                                    \
+/* Every move of a node goes through here so positions[handle] is never out of date */              \
+static inline void prefix##_place(Type* heap, size_t idx, Type##Node node) {                        \
+  heap->heap[idx] = node;                                                                           \
+  HEAP_IF(HANDLES, heap->positions[node.handle] = idx;)                                             \
+}                                                                                                   \
+                                                                                                    \
+static inline void prefix##_swap(Type* heap, size_t i, size_t j) {                                  \
+  Type##Node temp = heap->heap[i];                                                                  \
+  prefix##_place(heap, i, heap->heap[j]);                                                           \
+  prefix##_place(heap, j, temp);                                                                    \
+}                                                                                                   \
+                                                                                                    \
+/* Move the node at idx towards the root until its parent is not lower than it */                   \
+static inline void prefix##_sift_up(Type* heap, size_t idx) {                                       \
+  Type##Node* h = heap->heap;                                                                       \
+  Type##Node current = h[idx];                                                                      \
+  int64_t p_idx = heap_parent_idx(idx, HEAP_ARITY);                                                 \
+                                                                                                    \
+  while (p_idx != -1 && HIGHER(current.data, h[p_idx].data)) {                                      \
+    prefix##_place(heap, idx, h[p_idx]);                                                            \
+    idx = p_idx;                                                                                    \
+    p_idx = heap_parent_idx(idx, HEAP_ARITY);                                                       \
+  }                                                                                                 \
+                                                                                                    \
+  prefix##_place(heap, idx, current);                                                               \
+}                                                                                                   \
+                                                                                                    \
+/* Sift the node at idx down: the highest child moves up into the "hole" until the node fits, */    \
+/* then the node is written once at the end rather than swapped at every level */                   \
+static inline void prefix##_heapify(Type* heap, size_t idx) {                                       \
+  if (heap == NULL || idx >= heap->size) return;                                                    \
+                                                                                                    \
+  Type##Node* h = heap->heap;                                                                       \
+  Type##Node current = h[idx];                                                                      \
+                                                                                                    \
+  while (true) {                                                                                    \
+    int64_t first_idx = heap_first_child_idx(idx, heap->size, HEAP_ARITY);                          \
+                                                                                                    \
+    if (first_idx == -1) break;                                                                     \
+                                                                                                    \
+    size_t last_idx = heap_last_child_idx(idx, heap->size, HEAP_ARITY);                             \
+    size_t highest_idx = first_idx;                                                                 \
+                                                                                                    \
+    for (size_t c_idx = first_idx + 1; c_idx <= last_idx; c_idx++) {                                \
+      if (HIGHER(h[c_idx].data, h[highest_idx].data)) highest_idx = c_idx;                          \
+    }                                                                                               \
+                                                                                                    \
+    if (!HIGHER(h[highest_idx].data, current.data)) break;                                          \
+                                                                                                    \
+    prefix##_place(heap, idx, h[highest_idx]);                                                      \
+    idx = highest_idx;                                                                              \
+  }                                                                                                 \
+                                                                                                    \
+  prefix##_place(heap, idx, current);                                                               \
+}                                                                                                   \
+                                                                                                    \
+/* Copy data into the node array as is (no heap order yet), data[i] gets handle i */                \
+static inline void prefix##_load(Type* heap, const T* data, size_t n) {                             \
+  for (size_t i = 0; i < n; i++) {                                                                  \
+    heap->heap[i].data = data[i];                                                                   \
+    HEAP_IF(HANDLES, heap->heap[i].handle = i;)                                                     \
+    HEAP_IF(HANDLES, heap->positions[i] = i;)                                                       \
+  }                                                                                                 \
+                                                                                                    \
+  heap->size = n;                                                                                   \
+  HEAP_IF(HANDLES, heap->next_handle = n;)                                                          \
+}                                                                                                   \
+                                                                                                    \
+/* Floyd's build: copy the data in then heapify every parent from the last one back to the */       \
+/* root, O(n) rather than the O(n log n) of n inserts. The handle of data[i] is i */                \
+static inline Type prefix##_build(const T* data, size_t n) {                                        \
+  Type h = prefix##_initialize();                                                                   \
+                                                                                                    \
+  if (data == NULL || n == 0) return h;                                                             \
+                                                                                                    \
+  if (!prefix##_reserve(&h, n)) {                                                                   \
+    DEBUG_PRINT("Error: Could not allocate a heap for %zu nodes\n", n);                             \
+    return h;                                                                                       \
+  }                                                                                                 \
+                                                                                                    \
+  prefix##_load(&h, data, n);                                                                       \
+                                                                                                    \
+  /* Start at the parent of the last node, everything after it is a leaf */                         \
+  for (size_t i = (n - 1 + HEAP_ARITY - 1) / HEAP_ARITY; i > 0; i--) {                              \
+    prefix##_heapify(&h, i - 1);                                                                    \
+  }                                                                                                 \
+                                                                                                    \
+  return h;                                                                                         \
+}                                                                                                   \
+                                                                                                    \
+/* A build_parallel() task: Floyd's build on the subtree under one node, deepest level first */     \
+typedef struct {                                                                                    \
+  Type* heap;                                                                                       \
+  size_t first_root;                                                                                \
+} Type##BuildTask;                                                                                  \
+                                                                                                    \
+static inline void prefix##_build_subtree(void* context, size_t task) {                             \
+  Type##BuildTask* build = (Type##BuildTask*) context;                                              \
+  Type* heap = build->heap;                                                                         \
+  size_t firsts[64];                                                                                \
+  size_t lasts[64];                                                                                 \
+  size_t levels = 0;                                                                                \
+                                                                                                    \
+  /* The nodes of a subtree on each level below its root are one contiguous range */                \
+  firsts[0] = lasts[0] = build->first_root + task;                                                  \
+                                                                                                    \
+  while (firsts[levels] < heap->size) {                                                             \
+    firsts[levels + 1] = firsts[levels] * HEAP_ARITY + 1;                                           \
+    lasts[levels + 1] = lasts[levels] * HEAP_ARITY + HEAP_ARITY;                                    \
+    levels += 1;                                                                                    \
+  }                                                                                                 \
+                                                                                                    \
+  for (size_t level = levels; level > 0; level--) {                                                 \
+    size_t last = lasts[level - 1] < heap->size ? lasts[level - 1] : heap->size - 1;                \
+                                                                                                    \
+    for (size_t i = last + 1; i > firsts[level - 1]; i--) {                                         \
+      prefix##_heapify(heap, i - 1);                                                                \
+    }                                                                                               \
+  }                                                                                                 \
+}                                                                                                   \
+                                                                                                    \
+/* Floyd's build with the subtrees under one level heapified in parallel (see heap_parallel_for) */ \
+/* The level is the first with HEAP_TASKS_PER_THREAD * threads nodes, subtrees below it share */    \
+/* no nodes so they can be built at the same time. The few levels above are finished serially */    \
+static inline Type prefix##_build_parallel(const T* data, size_t n, size_t threads) {               \
+  if (threads == 0) threads = 1;                                                                    \
+                                                                                                    \
+  size_t level_first = 0;                                                                           \
+  size_t level_width = 1;                                                                           \
+                                                                                                    \
+  while (level_width < threads * HEAP_TASKS_PER_THREAD && level_first * HEAP_ARITY + 1 < n) {       \
+    level_first = level_first * HEAP_ARITY + 1;                                                     \
+    level_width *= HEAP_ARITY;                                                                      \
+  }                                                                                                 \
+                                                                                                    \
+  /* Too small to be worth splitting */                                                             \
+  if (level_first == 0 || threads == 1) return prefix##_build(data, n);                             \
+                                                                                                    \
+  Type h = prefix##_initialize();                                                                   \
+                                                                                                    \
+  if (!prefix##_reserve(&h, n)) {                                                                   \
+    DEBUG_PRINT("Error: Could not allocate a heap for %zu nodes\n", n);                             \
+    return h;                                                                                       \
+  }                                                                                                 \
+                                                                                                    \
+  prefix##_load(&h, data, n);                                                                       \
+                                                                                                    \
+  size_t roots = n - level_first < level_width ? n - level_first : level_width;                     \
+  Type##BuildTask build = { .heap = &h, .first_root = level_first };                                \
+                                                                                                    \
+  heap_parallel_for(prefix##_build_subtree, &build, roots, threads);                                \
+                                                                                                    \
+  for (size_t i = level_first; i > 0; i--) {                                                        \
+    prefix##_heapify(&h, i - 1);                                                                    \
+  }                                                                                                 \
+                                                                                                    \
+  return h;                                                                                         \
+}                                                                                                   \
+                                                                                                    \
+/* Insert a node. An indexed heap returns its handle or INVALID_HANDLE if the heap could not */     \
+/* grow, a plain heap returns true/ false */                                                        \
+static inline HEAP_PICK(HANDLES, size_t, bool) prefix##_insert(Type* heap, T data) {                \
+  if (heap == NULL) return HEAP_PICK(HANDLES, INVALID_HANDLE, false);                               \
+                                                                                                    \
+  if (heap->size == heap->capacity && !prefix##_make_room(heap, 1)) {                               \
+    DEBUG_PRINT("Error: Cannot add another element as the heap could not grow\n\n", NULL);          \
+    return HEAP_PICK(HANDLES, INVALID_HANDLE, false);                                               \
+  }                                                                                                 \
+                                                                                                    \
+  Type##Node node = prefix##_make_node(heap, data);                                                 \
+                                                                                                    \
+  prefix##_place(heap, heap->size, node);                                                           \
+  heap->size += 1;                                                                                  \
+                                                                                                    \
+  prefix##_sift_up(heap, heap->size - 1);                                                           \
+                                                                                                    \
+  return HEAP_PICK(HANDLES, node.handle, true);                                                     \
+}                                                                                                   \
+                                                                                                    \
+/* Insert n nodes at once: append them all then sift down only the ancestors of the new nodes, */   \
+/* one level at a time from the bottom (Floyd's build restricted to the paths that changed). */     \
+/* On an indexed heap handles (can be NULL) gets the handle of each node. false if the heap */      \
+/* could not grow */                                                                                \
+static inline bool prefix##_insert_batch(Type* heap, const T* data, size_t n HEAP_IF(HANDLES, , size_t* handles)) { \
+  if (heap == NULL || (data == NULL && n > 0)) return false;                                        \
+  if (n == 0) return true;                                                                          \
+                                                                                                    \
+  size_t old_size = heap->size;                                                                     \
+                                                                                                    \
+  if (!prefix##_make_room(heap, n)) {                                                               \
+    DEBUG_PRINT("Error: Cannot add %zu elements as the heap could not grow\n\n", n);                \
+    return false;                                                                                   \
+  }                                                                                                 \
+                                                                                                    \
+  for (size_t i = 0; i < n; i++) {                                                                  \
+    Type##Node node = prefix##_make_node(heap, data[i]);                                            \
+    prefix##_place(heap, old_size + i, node);                                                       \
+    HEAP_IF(HANDLES, if (handles != NULL) handles[i] = node.handle;)                                \
+  }                                                                                                 \
+                                                                                                    \
+  heap->size = old_size + n;                                                                        \
+                                                                                                    \
+  if (heap->size == 1) return true;                                                                 \
+                                                                                                    \
+  /* The parents of the new nodes are one range, their parents the next range up and so on */       \
+  size_t lo = heap_parent_idx(old_size == 0 ? 1 : old_size, HEAP_ARITY);                            \
+  size_t hi = heap_parent_idx(heap->size - 1, HEAP_ARITY);                                          \
+                                                                                                    \
+  while (true) {                                                                                    \
+    for (size_t i = hi + 1; i > lo; i--) {                                                          \
+      prefix##_heapify(heap, i - 1);                                                                \
+    }                                                                                               \
+                                                                                                    \
+    if (lo == 0) break;                                                                             \
+                                                                                                    \
+    lo = heap_parent_idx(lo, HEAP_ARITY);                                                           \
+    hi = heap_parent_idx(hi, HEAP_ARITY);                                                           \
+  }                                                                                                 \
+                                                                                                    \
+  return true;                                                                                      \
+}                                                                                                   \
+                                                                                                    \
+/* The top node, or NULL if the heap is empty. Only valid until the heap is next modified */        \
+static inline Type##Node* prefix##_peek(Type* heap) {                                               \
+  if (heap == NULL || heap->size == 0) return NULL;                                                 \
+                                                                                                    \
+  return &heap->heap[0];                                                                            \
+}                                                                                                   \
+                                                                                                    \
+/* Remove the node at idx (and release its handle). The last node fills the slot and may need */    \
+/* to move either way */                                                                            \
+static inline void prefix##_remove_at(Type* heap, size_t idx) {                                     \
+  HEAP_IF(HANDLES, prefix##_release_handle(heap, heap->heap[idx].handle);)                          \
+  heap->size -= 1;                                                                                  \
+                                                                                                    \
+  if (idx < heap->size) {                                                                           \
+    prefix##_place(heap, idx, heap->heap[heap->size]);                                              \
+    prefix##_sift_up(heap, idx);                                                                    \
+    prefix##_heapify(heap, idx);                                                                    \
+  }                                                                                                 \
+                                                                                                    \
+  prefix##_maybe_shrink(heap);                                                                      \
+}                                                                                                   \
+                                                                                                    \
+/* Extract the top node into out, false if the heap is empty */                                     \
+static inline bool prefix##_extract(Type* heap, T* out) {                                           \
+  if (heap == NULL || heap->size == 0) {                                                            \
+    DEBUG_PRINT("Trying to extract from the heap when there are no nodes\n", NULL);                 \
+    return false;                                                                                   \
+  }                                                                                                 \
+                                                                                                    \
+  if (out != NULL) *out = heap->heap[0].data;                                                       \
+  prefix##_remove_at(heap, 0);                                                                      \
+                                                                                                    \
+  return true;                                                                                      \
+}                                                                                                   \
+                                                                                                    \
+/* Extract the top into out and put data in its place with one sift down, rather than the */        \
+/* sift down of extract and the sift up of insert. The root's handle now belongs to data */         \
+static inline bool prefix##_replace_top(Type* heap, T data, T* out) {                               \
+  if (heap == NULL || heap->size == 0) {                                                            \
+    DEBUG_PRINT("Trying to replace the top of the heap when there are no nodes\n", NULL);           \
+    return false;                                                                                   \
+  }                                                                                                 \
+                                                                                                    \
+  if (out != NULL) *out = heap->heap[0].data;                                                       \
+  heap->heap[0].data = data;                                                                        \
+  prefix##_heapify(heap, 0);                                                                        \
+                                                                                                    \
+  return true;                                                                                      \
+}                                                                                                   \
+                                                                                                    \
+HEAP_IF(HANDLES,                                                                                    \
+  static inline bool prefix##_contains(Type* heap, size_t handle) {                                 \
+    if (heap == NULL || handle >= heap->next_handle) return false;                                  \
+                                                                                                    \
+    return heap->positions[handle] != INVALID_HANDLE;                                               \
+  }                                                                                                 \
+                                                                                                    \
+  /* O(log n) delete by handle, the position map gives the index so there is no search */           \
+  static inline bool prefix##_delete(Type* heap, size_t handle) {                                   \
+    if (!prefix##_contains(heap, handle)) return false;                                             \
+                                                                                                    \
+    prefix##_remove_at(heap, heap->positions[handle]);                                              \
+                                                                                                    \
+    return true;                                                                                    \
+  }                                                                                                 \
+                                                                                                    \
+  /* Move a node closer to the top (decrease_key for a min heap, increase_key for a max heap) */    \
+  /* false if the handle is gone or the new data would put the node lower */                        \
+  static inline bool prefix##_promote(Type* heap, size_t handle, T data) {                          \
+    if (!prefix##_contains(heap, handle)) return false;                                             \
+                                                                                                    \
+    size_t idx = heap->positions[handle];                                                           \
+                                                                                                    \
+    if (HIGHER(heap->heap[idx].data, data)) return false;                                           \
+                                                                                                    \
+    heap->heap[idx].data = data;                                                                    \
+    prefix##_sift_up(heap, idx);                                                                    \
+                                                                                                    \
+    return true;                                                                                    \
+  }                                                                                                 \
+                                                                                                    \
+  /* Move a node further from the top (increase_key for a min heap, decrease_key for a max heap) */ \
+  static inline bool prefix##_demote(Type* heap, size_t handle, T data) {                           \
+    if (!prefix##_contains(heap, handle)) return false;                                             \
+                                                                                                    \
+    size_t idx = heap->positions[handle];                                                           \
+                                                                                                    \
+    if (HIGHER(data, heap->heap[idx].data)) return false;                                           \
+                                                                                                    \
+    heap->heap[idx].data = data;                                                                    \
+    prefix##_heapify(heap, idx);                                                                    \
+                                                                                                    \
+    return true;                                                                                    \
+  }                                                                                                 \
+                                                                                                    \
+  /* Change a node's data whichever way it moves */                                                 \
+  static inline bool prefix##_update(Type* heap, size_t handle, T data) {                           \
+    if (!prefix##_contains(heap, handle)) return false;                                             \
+                                                                                                    \
+    size_t idx = heap->positions[handle];                                                           \
+                                                                                                    \
+    heap->heap[idx].data = data;                                                                    \
+    prefix##_sift_up(heap, idx);                                                                    \
+    prefix##_heapify(heap, heap->positions[handle]);                                                \
+                                                                                                    \
+    return true;                                                                                    \
+  }                                                                                                 \
+)
+
+#endif
@@ -2,13 +2,13 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
-
-#define RESIZE_LOAD_FACTOR .7 
-#define INITIAL_HEAP_CAPACITY 20 
-#define QUEUE_CAPACITY 50
+#include <string.h>
+#include <time.h>
 
 #define LENGTH(arr, dt) (sizeof(arr) / sizeof(dt))
 #define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
 
 #ifdef DEBUG
 #define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
@@ -16,50 +16,44 @@
 #define DEBUG_PRINT(fmt, ...)
 #endif
 
-//  NOTE: There could be more in the Node struct 
-//  NOTE: This is just here to treat each item in a heap as a Node rather than just having an array of integers 
+//  NOTE: The heap itself is generated by DEFINE_HEAP in heaps/heap.h (shared with min-heap.c) 
+//  NOTE: This file picks the ordering and payload, then tests and benchmarks the result 
+//  NOTE: Build with gcc -O2 -pthread -DHEAP_PARALLEL max-heap.c to run max_heap_build_parallel(...) on BUILD_THREADS threads 
 
-typedef struct {
-  uint16_t data; 
-} Node;
+#define BUILD_THREADS 4
 
-typedef struct {
-  uint16_t size; 
-  uint16_t capacity; 
-  Node** heap; 
-} MaxHeap; 
+#include "../heap.h"
+
+// A node belongs above another when its data is larger 
+
+#define MAX_HEAP_HIGHER(a, b) ((a) > (b))
+
+DEFINE_HEAP(MaxHeap, max_heap, uint16_t, MAX_HEAP_HIGHER)
+
+// The same heap with handles for delete/ promote/ demote by handle - each node carries a size_t handle on top of its data 
+
+DEFINE_INDEXED_HEAP(IndexedMaxHeap, indexed_max_heap, uint16_t, MAX_HEAP_HIGHER)
+
+// max_heap_heapsort(...) and max_heap_partial_sort(...) on plain uint16_t arrays (ascending) 
+
+DEFINE_HEAP_SORT(max_heap, uint16_t, MAX_HEAP_HIGHER)
+
+//  NOTE: There could be more in the Node struct - Any type can be the payload, the comparison just picks the key out of it 
 
 typedef struct {
-  int* queue;
-  uint16_t front;
-  int16_t rear; 
-  uint16_t size; 
-  uint16_t capacity;
-} Queue;
-
-// Setup/ Teardown Methods 
-
-MaxHeap initialize_heap();
-Node* initialize_node(uint16_t node_data); 
-
-// Heap Operations 
-
-MaxHeap build_heap(Node** arr);
-void max_heapify(MaxHeap* heap, uint16_t idx);
-void insert(MaxHeap* heap, uint16_t node_data); 
-void delete(MaxHeap* heap, uint16_t node_data);
-int16_t right_child_idx(MaxHeap* heap, uint16_t idx); 
-int16_t left_child_idx(MaxHeap* heap, uint16_t idx); 
-int16_t parent_idx(uint16_t idx); 
-void swap(Node** heap, uint16_t i, uint16_t j); 
-Node* peek(MaxHeap* heap);
-void print_heap(MaxHeap* heap); 
+  uint16_t priority; 
+  uint32_t task_id; 
+} Task; 
+
+#define TASK_HIGHER(a, b) ((a).priority > (b).priority)
+
+DEFINE_HEAP(TaskHeap, task_heap, Task, TASK_HIGHER)
 
-// Queue Utility
-Queue initialize_queue(); 
-void free_queue(Queue* q);
-void enqueue(Queue* q, int x); 
-int dequeue(Queue* q);
+// Max Heap Operations 
+
+int32_t extract_max(MaxHeap* heap);
+void delete_node(MaxHeap* heap, uint16_t node_data);
+void print_heap(MaxHeap* heap); 
 
 /**
  * =====================
@@ -67,560 +61,713 @@ int dequeue(Queue* q);
  * =====================
  */
 
-/**
- * Initialize a heap heap and return it 
+/** 
+ * Extract the max element -> This is/ should be the root of the heap 
  *
- * @returns: A new heap struct 
+ * @param: heap -> The heap to extract from
+ * @returns: The max element (root of the heap) or -1 if the heap is empty 
  */
 
-MaxHeap initialize_heap() {
-  MaxHeap heap; 
-  heap.heap = (Node**) malloc(sizeof(Node*) * INITIAL_HEAP_CAPACITY);
-
-  if (heap.heap == NULL) {
-    DEBUG_PRINT("Error Allocating memory for the heap\n\n", NULL); 
-    exit(EXIT_FAILURE);
-  }
+int32_t extract_max(MaxHeap* heap) {
+  uint16_t node_data; 
 
-  heap.size = 0;
-  heap.capacity = INITIAL_HEAP_CAPACITY; 
+  if (!max_heap_extract(heap, &node_data)) return -1; 
 
-  return heap;
+  return node_data; 
 }
 
 /**
- * Free all nodes in the heap and the heap itself 
- * This will set the heap struct to NULL after destroying the heap and it's nodes 
+ * Delete an arbitrary node from the heap by its data O(n)
+ * If you need to delete by value often use an IndexedMaxHeap and keep the handle from indexed_max_heap_insert(), 
+ * indexed_max_heap_delete(...) is O(log n) 
+ * The nodes are in one contiguous array so a straight scan finds the node without the BFS queue
  *
- * @param: heap -> The heap to free 
+ * @param: heap -> The heap to delete from 
+ * @param: node_data -> The data of the node to delete 
  */
 
-void free_heap(MaxHeap* heap) {
-  Node** h = heap->heap;
+void delete_node(MaxHeap* heap, uint16_t node_data) {
 
-  for (int i = 0; i < heap->size; i++) {
-    DEBUG_PRINT("Freeing node -> %d\n", h[i]->data); 
-    free(h[i]);
+  if (heap == NULL) {
+    DEBUG_PRINT("Error: Cannot delete from a null heap\n", NULL);
+    return;
   }
 
-  DEBUG_PRINT("All heap nodes found have been freed\n\n", NULL);
+  if (heap->size == 0) {
+    DEBUG_PRINT("Error: Cannot delete from an empty heap\n", NULL);  
+    return; 
+  }
 
-  free(heap->heap);
-  heap->heap = NULL; 
-  heap = NULL; 
-}
+  for (size_t i = 0; i < heap->size; i++) {
+    if (heap->heap[i].data == node_data) {
+      max_heap_remove_at(heap, i); 
+      return; 
+    }
+  }
 
-/**
- * Initialize a node for the heep 
- */
+  DEBUG_PRINT("Node not found, thus no node has been deleted\n", NULL);
+}
 
-Node* initialize_node(uint16_t node_data) {
-  Node* n = (Node*) malloc(sizeof(Node)); 
+void print_heap(MaxHeap* heap) {
+  MaxHeapNode* h = heap->heap;  
 
-  if (n == NULL) {
-    DEBUG_PRINT("Error allocating memory for node -> %d\n", node_data);
-    exit(EXIT_FAILURE);
+  printf("[");
+  for (size_t i = 0; i < heap->size; i++) {
+    printf("%u, ", h[i].data);  
   }
 
-  n->data = node_data; 
+  printf("]\n");
 
-  return n; 
 }
 
-/** 
- * Build a max heap from a pre-existing Node array
- * 
- * @param: arr[] -> An array of nodes to build the heap from 
- * @returns: A new max heap - This can return a heap with nothing in it if the size of the node arr is greater than the size of the initial heap capacity 
- */
-
-MaxHeap build_heap(Node** arr) {
-
-  MaxHeap h = initialize_heap(); 
-
-  if ((sizeof(arr) / sizeof(Node)) > INITIAL_HEAP_CAPACITY) {
-    DEBUG_PRINT("Heap capcity is too large for this circumstance. Either adjust heap capcity or implement dynamic heap size\n", NULL); 
-    return h; 
-  }
+void print_indexed_heap(IndexedMaxHeap* heap) {
+  IndexedMaxHeapNode* h = heap->heap;  
 
-  for (int i = 0; i < (sizeof(arr) / sizeof(Node)); i++) {
-    insert(&h, arr[i]->data);
+  printf("[");
+  for (size_t i = 0; i < heap->size; i++) {
+    printf("%u, ", h[i].data);  
   }
 
+  printf("]\n");
 
-  return h; 
 }
 
 /**
- * Peek at the top of the heap (The max element) 
- *
- * @param: heap -> The heap to perform the peek operation on 
- * @returns: The top element of the heap or NULL if the size is 0 or the heap is NULL
+ * ===========
+ * || Tests ||
+ * ===========
  */
 
-Node* peek(MaxHeap* heap) {
-  if (heap == NULL || heap->size == 0) {
-    DEBUG_PRINT("Heap is Null or the size is zero so cannot peek at the heap\n\n", NULL);
-    return NULL; 
+void test_insertion(MaxHeap* heap) {
+  printf("==================\n");
+  printf("|| Insertion    ||\n"); 
+  printf("==================\n\n");
+
+  int nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64 };
+  
+  for (int i = 0; i < (sizeof(nums) / sizeof(int)); i++) {
+    printf("Adding node: %d\n", nums[i]); 
+    max_heap_insert(heap, nums[i]); 
+    print_heap(heap); 
   }
 
-  return heap->heap[0]; 
+  print_heap(heap); 
+  printf("\n");
 }
 
-/** 
- * Standard swap util method to swap to indexes in an Array/Vector 
- *
- * @param: heap -> The heap to swap the indexes within 
- * @param: { i, j } -> Indexes in the array to swap
- */
+void test_deletion(MaxHeap* heap) {
+  printf("==================\n");
+  printf("|| Deletion     ||\n"); 
+  printf("==================\n\n");
 
-void swap(Node** heap, uint16_t i, uint16_t j) {
-  Node* temp = heap[i];
-  heap[i] = heap[j];
-  heap[j] = temp; 
-}
 
-/** 
- * Max Heapify the heap given an idx 
- *
- * @param: heap -> The heap struct to heapify (The acctual heap is contained in heap->heap) 
- * @param: idx -> The idx to start the heapify method at
- */
+  int nums[] = { 38, 40, 64, 16 };
+
+  for (int i = 0; i < LENGTH(nums, int); i++) {
+    delete_node(heap, nums[i]); 
+    printf("\n");
+    print_heap(heap); 
+  }
 
-void max_heapify(MaxHeap* heap, uint16_t idx) {
-  int16_t l_idx = left_child_idx(heap, idx);  
-  int16_t r_idx = right_child_idx(heap, idx);
-  uint16_t largest_idx = idx; 
+  printf("\n");
   
-  Node* largest = heap->heap[largest_idx];
-  Node* right_child = r_idx == -1 ? NULL : heap->heap[r_idx];
-  Node* left_child = l_idx == -1 ? NULL : heap->heap[l_idx];
+}
 
-  if (left_child != NULL && left_child->data > largest->data) {
-    largest_idx = l_idx; 
-    largest = heap->heap[largest_idx];
-  }
+void test_extract_max(MaxHeap* heap) {
+  printf("==================\n");
+  printf("|| Extract Max  ||\n"); 
+  printf("==================\n\n");
 
-  if (right_child != NULL && right_child->data > largest->data) {
-    largest_idx = r_idx; 
-    largest = heap->heap[largest_idx];
+  for (int i = 0; i < 2; i++) {
+    printf("Before: "); 
+    print_heap(heap);
+    int32_t data = extract_max(heap); 
+    printf("Extracted: %d", data); 
+    printf("\nAfter: ");
+    print_heap(heap);
+    printf("\n");
   }
 
-  if (largest_idx != idx) {
-    swap(heap->heap, idx, largest_idx); 
-    max_heapify(heap, largest_idx);
-  }
-    
+  printf("\n");
 }
 
-/**
- * Get the right child of a given node 
- *
- * @param: heap -> The heap to check (Only used for getting the size)
- * @param: idx -> The index of the current node
- * @returns: The left child index in the heap or -1 if it is out of bounds
- */
-
-int16_t right_child_idx(MaxHeap* heap, uint16_t idx) {
-  uint16_t r_idx = (idx * 2) + 2; 
+void test_peek(MaxHeap* heap) {
+  printf("==================\n");
+  printf("|| Peek         ||\n"); 
+  printf("==================\n\n");
 
-  if (r_idx > heap->size) return -1;
+  MaxHeapNode* node = max_heap_peek(heap);  
 
-  return r_idx;
+  if (node != NULL) {
+    printf("Max: %d\n\n", node->data);
+    return;
+  }
 }
 
-/**
- * Get the left child of a given node
- *
- * @param: heap -> The heap to check (Only used for getting the size)
- * @param: idx -> The index of the current node
- * @returns: The left child index in the heap or -1 if it is out of bounds
- */
+void test_build_heap() {
+  printf("==================\n");
+  printf("|| Build Heap   ||\n"); 
+  printf("==================\n\n");
+
+  uint16_t nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64 };
+  MaxHeap heap = max_heap_build(nums, LENGTH(nums, uint16_t)); 
 
-int16_t left_child_idx(MaxHeap* heap, uint16_t idx) {
-  uint16_t l_idx = (idx * 2) + 1;
+  print_heap(&heap); 
+
+  printf("Drained: "); 
+  while (heap.size > 0) {
+    printf("%d, ", extract_max(&heap)); 
+  }
 
-  if (l_idx > heap->size) return -1; 
+  printf("\n\n"); 
 
-  return l_idx;
+  max_heap_free(&heap); 
 }
 
-/**
- * Get the parent of a given node 
- *
- * @param: idx -> The current nodes index in the heap 
- * @returns: an int representing the idx of the parent or -1 if the division produces out of bounds errors
- */
+void test_handles() {
+  printf("==================\n");
+  printf("|| Handles      ||\n"); 
+  printf("==================\n\n");
 
-int16_t parent_idx(uint16_t idx) {
-  
-  int16_t p_idx = (idx) / 2;  
+  IndexedMaxHeap heap = indexed_max_heap_initialize(); 
+  uint16_t nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64 };
+  size_t handles[LENGTH(nums, uint16_t)]; 
 
-  if (p_idx < 0) return -1; 
+  for (size_t i = 0; i < LENGTH(nums, uint16_t); i++) {
+    handles[i] = indexed_max_heap_insert(&heap, nums[i]); 
+  }
 
-  return p_idx;
-}
+  print_indexed_heap(&heap); 
 
-/**
- * Insert into the heap 
- *
- * @param: heap -> The heap struct to insert into (The actual heap exits in heap->heap)
- * @param: node_data -> The ndoe data to insert 
- */
+  printf("Increase 27 -> 500\n"); 
+  indexed_max_heap_promote(&heap, handles[2], 500); 
+  print_indexed_heap(&heap); 
 
-void insert(MaxHeap* heap, uint16_t node_data) {
-  
-  if (heap == NULL) {
-    DEBUG_PRINT("Error - The heap is not provided or has not yet been instantiated\n\n", NULL);
-    return; 
-  }
+  printf("Decrease 463 -> 10\n"); 
+  indexed_max_heap_demote(&heap, handles[4], 10); 
+  print_indexed_heap(&heap); 
 
-  if (heap->size == heap->capacity) {
-    DEBUG_PRINT("TODO - Add resize function\n", NULL); 
-    DEBUG_PRINT("Error: Cannot add another element as the heap is full\n\n", NULL); 
-    return;
-  }
+  printf("Delete 200 by handle\n"); 
+  indexed_max_heap_delete(&heap, handles[6]); 
+  print_indexed_heap(&heap); 
 
-  Node** h = heap->heap; 
+  printf("Handle for 200 still in heap: %s\n", indexed_max_heap_contains(&heap, handles[6]) ? "true" : "false"); 
+  printf("Increase with a smaller key rejected: %s\n", indexed_max_heap_promote(&heap, handles[0], 1) ? "false" : "true"); 
 
+  printf("Drained: "); 
+  uint16_t max; 
+  while (heap.size > 0) {
+    indexed_max_heap_extract(&heap, &max); 
+    printf("%d, ", max); 
+  }
 
-  h[heap->size] = initialize_node(node_data); 
+  printf("\n\n"); 
 
-  uint16_t c_idx = heap->size;
-  int16_t p_idx = parent_idx(c_idx);
+  indexed_max_heap_free(&heap); 
+}
 
-  if (p_idx == -1) {
-    heap->size += 1; 
-    return;
-  } 
+void test_growth() {
+  printf("==================\n");
+  printf("|| Growth       ||\n"); 
+  printf("==================\n\n");
+
+  MaxHeap heap = max_heap_initialize(); 
+  size_t n = 100000; 
 
-  Node* current = h[c_idx];
-  Node* parent = h[p_idx]; 
+  max_heap_reserve(&heap, n); 
+  size_t reserved = heap.capacity; 
 
-  while(current->data > parent->data) {
-    swap(h, c_idx, p_idx); 
+  for (size_t i = 0; i < n; i++) {
+    max_heap_insert(&heap, (uint16_t) ((i * 7919) % 65536)); 
+  }
 
-    c_idx = p_idx; 
-    p_idx = parent_idx(p_idx);
+  printf("Inserted %zu nodes, capacity after reserve: %zu, capacity now: %zu\n", heap.size, reserved, heap.capacity); 
 
-    if (p_idx == -1) break;
+  int32_t prev = extract_max(&heap); 
+  bool ordered = true; 
 
-    current = h[c_idx];
-    parent = h[p_idx];
+  while (heap.size > 0) {
+    int32_t current = extract_max(&heap); 
+    if (current > prev) ordered = false; 
+    prev = current; 
   }
 
-  heap->size += 1; 
+  printf("Drained in order: %s\n", ordered ? "true" : "false"); 
 
+  max_heap_shrink_to_fit(&heap); 
+  printf("Capacity after shrink_to_fit: %zu\n\n", heap.capacity); 
+
+  max_heap_free(&heap); 
 }
 
-/** 
- *  NOTE: When dealing with non-trivial Nodes (i.e nodes that contain more than an integer) you must free the node outside of this method 
- *
- * Extract the max element -> This is/ should be the root of the heap 
- *
- * @param: heap -> The heap to extract from
- * @returns: The max element (root of the heap) or NULL if the heap is empty 
- */
+void test_custom_key() {
+  printf("==================\n");
+  printf("|| Custom Key   ||\n"); 
+  printf("==================\n\n");
 
-int16_t extract_max(MaxHeap* heap) {
-  
-  if (heap->size <= 0) {
-    DEBUG_PRINT("Trying to extract from the heap when there are no nodes\n", NULL);
-    return -1;
+  TaskHeap heap = task_heap_initialize(); 
+  uint16_t priorities[] = { 3, 9, 1, 7, 9, 4 };
+
+  for (size_t i = 0; i < LENGTH(priorities, uint16_t); i++) {
+    Task task = { .priority = priorities[i], .task_id = 100 + i }; 
+    task_heap_insert(&heap, task); 
   }
 
-  Node* max = heap->heap[0];
-  uint16_t node_data = max->data; 
-  swap(heap->heap, 0, heap->size - 1); 
-  free(heap->heap[heap->size - 1]);
-  heap->heap[heap->size - 1] = NULL; 
-  heap->size -= 1; 
+  Task task; 
+
+  while (task_heap_extract(&heap, &task)) {
+    printf("Task %u (priority %u)\n", task.task_id, task.priority); 
+  }
 
-  max_heapify(heap, 0);
+  printf("\n"); 
 
-  
-  return node_data; 
+  task_heap_free(&heap); 
 }
 
-/**
- * Delete an arbitrary node from the heap O(n)
- *
- * @param: heap -> The heap to delete from 
- * @param: node_data -> The data of the node to delete 
- */
+// Every node is no bigger than its parent 
 
-void delete_node(MaxHeap* heap, uint16_t node_data) {
+bool is_valid_heap(MaxHeap* heap) {
+  for (size_t i = 0; i < heap->size; i++) {
+    int64_t p_idx = heap_parent_idx(i, HEAP_ARITY); 
 
-  if (heap == NULL) {
-    DEBUG_PRINT("Error: Cannot delete from a null heap\n", NULL);
-    return;
+    if (p_idx != -1 && heap->heap[i].data > heap->heap[p_idx].data) return false; 
   }
 
-  if (heap->size == 0) {
-    DEBUG_PRINT("Error: Cannot delete from an empty heap\n", NULL);  
-    return; 
+  return true; 
+}
+
+// The same, and the position map points back at every node 
+
+bool is_valid_indexed_heap(IndexedMaxHeap* heap) {
+  for (size_t i = 0; i < heap->size; i++) {
+    int64_t p_idx = heap_parent_idx(i, HEAP_ARITY); 
+
+    if (p_idx != -1 && heap->heap[i].data > heap->heap[p_idx].data) return false; 
+    if (heap->positions[heap->heap[i].handle] != i) return false; 
   }
 
-  Queue q = initialize_queue(); 
-  enqueue(&q, 0);
-  Node* target_node = NULL;
-  int target_node_idx = -1;
+  return true; 
+}
 
-  while (q.size != 0 && target_node == NULL) {
-    int current_idx = dequeue(&q); 
+void test_build_parallel() {
+  printf("==================\n");
+  printf("|| Build Para.  ||\n"); 
+  printf("==================\n\n");
 
-    if (current_idx == -1) {
-      DEBUG_PRINT("Error: Queue returned -1\n", NULL);
-      break;
-    }
+  size_t sizes[] = { 0, 1, 9, 100, 4097, 100000 }; 
+  bool valid = true; 
 
-    if (current_idx >= heap->size) {
-      DEBUG_PRINT("Error: Delete node queue returned an index out of bounds\n", NULL); 
-      break; 
-    }
+  for (size_t s = 0; s < LENGTH(sizes, size_t); s++) {
+    uint16_t* data = (uint16_t*) malloc(sizeof(uint16_t) * (sizes[s] + 1)); 
+    uint32_t seed = 12345; 
 
-    Node* current = heap->heap[current_idx];
+    if (data == NULL) return; 
 
-    if (current->data == node_data) {
-      target_node = current; 
-      target_node_idx = current_idx;
-      break;
+    for (size_t i = 0; i < sizes[s]; i++) {
+      seed = seed * 1103515245 + 12345; 
+      data[i] = (uint16_t) (seed >> 16); 
     }
 
-    int left_idx = left_child_idx(heap, current_idx);
-    int right_idx = right_child_idx(heap, current_idx);
+    MaxHeap heap = max_heap_build_parallel(data, sizes[s], BUILD_THREADS); 
 
-    if (left_idx != -1) enqueue(&q, left_idx);
-    if (right_idx != -1) enqueue(&q, right_idx);
+    if (heap.size != sizes[s] || !is_valid_heap(&heap)) valid = false; 
 
+    max_heap_free(&heap); 
+    free(data); 
   }
 
-  free_queue(&q);
+#ifdef HEAP_PARALLEL
+  printf("Threads: %d\n", BUILD_THREADS); 
+#else
+  printf("Threads: 1 (HEAP_PARALLEL not defined, same subtrees built in turn)\n"); 
+#endif
+  printf("Valid heaps: %s\n\n", valid ? "true" : "false"); 
+}
 
-  if (target_node == NULL || target_node_idx == -1) {
-    DEBUG_PRINT("Node not found, thus no node has been deleted\n", NULL);
-    return;
-  }
+void test_insert_batch() {
+  printf("==================\n");
+  printf("|| Insert Batch ||\n"); 
+  printf("==================\n\n");
 
-  swap(heap->heap, target_node_idx, heap->size - 1);
-  free(target_node); 
-  heap->heap[heap->size - 1] = NULL; 
-  heap->size -= 1; 
+  uint16_t nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64 };
+  uint16_t burst[] = { 500, 1, 300, 45, 46 };
+  size_t handles[LENGTH(burst, uint16_t)]; 
+  MaxHeap heap = max_heap_initialize(); 
+  IndexedMaxHeap indexed = indexed_max_heap_initialize(); 
 
-  max_heapify(heap, target_node_idx);
- 
-}
+  max_heap_insert_batch(&heap, nums, LENGTH(nums, uint16_t)); 
+  print_heap(&heap); 
 
+  max_heap_insert_batch(&heap, burst, LENGTH(burst, uint16_t)); 
+  print_heap(&heap); 
 
+  printf("Valid: %s\n", is_valid_heap(&heap) ? "true" : "false"); 
 
-/**
- * ===================
- * || Queue Methods ||
- * ===================
- */
+  // An indexed heap hands back the handle of each node in the batch 
+  indexed_max_heap_insert_batch(&indexed, nums, LENGTH(nums, uint16_t), NULL); 
+  indexed_max_heap_insert_batch(&indexed, burst, LENGTH(burst, uint16_t), handles); 
 
-/**
- * Initialize the queue (This is a circular queue) 
- *
- * @returns: A new Circular Queue
- */
+  printf("Indexed valid: %s\n", is_valid_indexed_heap(&indexed) ? "true" : "false"); 
+  printf("Handle of 500 points at the root: %s\n", indexed.positions[handles[0]] == 0 ? "true" : "false"); 
 
-Queue initialize_queue() {
-  Queue q; 
-  int* queue = (int*) malloc(sizeof(int) * QUEUE_CAPACITY); 
-  
-  if (queue == NULL) {
-    DEBUG_PRINT("Error Allocating Memory for the queue data structure\n", NULL);    
-    exit(EXIT_FAILURE);
+  indexed_max_heap_free(&indexed); 
+
+  // Lots of batches of different sizes on top of each other 
+  uint32_t seed = 12345; 
+  bool valid = true; 
+
+  for (size_t b = 1; b < 300; b += 7) {
+    uint16_t batch[300]; 
+
+    for (size_t i = 0; i < b; i++) {
+      seed = seed * 1103515245 + 12345; 
+      batch[i] = (uint16_t) (seed >> 16); 
+    }
+
+    max_heap_insert_batch(&heap, batch, b); 
+    if (!is_valid_heap(&heap)) valid = false; 
   }
 
-  q.queue = queue; 
-  q.size = 0; 
-  q.front = 0;
-  q.rear = -1;
-  q.capacity = QUEUE_CAPACITY;
+  printf("Valid after %zu nodes of batches: %s\n", heap.size, valid ? "true" : "false"); 
 
-  return q; 
-}
+  // A freed heap has no slots at all, growing has to start from somewhere 
+  max_heap_free(&heap); 
+  bool refilled = max_heap_insert_batch(&heap, nums, LENGTH(nums, uint16_t)); 
 
-/**
- * Free the queue
- *
- * @param: The queue to free 
- */
+  max_heap_free(&heap); 
+  refilled = refilled && max_heap_insert(&heap, 7) && heap.size == 1; 
 
-void free_queue(Queue* q) {
-  if (q == NULL) {
-    DEBUG_PRINT("Attempt to free a NULL queue\n\n", NULL);
-    return; 
-  } 
+  printf("Batch and insert after free: %s\n\n", refilled ? "true" : "false"); 
 
-  free(q->queue); 
-  q = NULL;
+  max_heap_free(&heap); 
 }
 
-/**
- * Enqueue a node in the queue 
- *
- * @param: q -> The queue to enqueue within 
- * @param: x -> The node to enqueue 
- */
+int compare_uint16(const void* a, const void* b) {
+  return (int) *(const uint16_t*) a - (int) *(const uint16_t*) b; 
+}
 
-void enqueue(Queue* q, int x) {
+void test_heapsort() {
+  printf("==================\n");
+  printf("|| Heapsort     ||\n"); 
+  printf("==================\n\n");
 
-  if (q == NULL) {
-    DEBUG_PRINT("Error: Attempting to enqueue into a NULL queue\n", NULL); 
-    return;
-  }
+  uint16_t nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64 };
+  uint16_t partial[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64 };
 
-  if (q->size == q->capacity) {
-    DEBUG_PRINT("Error: Attempting to enqueue when the queue is at capacity. Please dequeue some nodes\n", NULL); 
-    return;
-  }
+  max_heap_heapsort(nums, LENGTH(nums, uint16_t)); 
+  max_heap_partial_sort(partial, LENGTH(partial, uint16_t), 3); 
 
-  q->rear = ((q->rear + 1) % q->capacity); 
-  q->queue[q->rear] = x; 
-  q->size += 1; 
-  
-}
+  printf("Heapsort: "); 
+  for (size_t i = 0; i < LENGTH(nums, uint16_t); i++) printf("%d, ", nums[i]); 
 
-/**
- * Dequeue a node from the queue 
- *
- * @param: q -> The queue to dequeue from 
- * @returns: A node from the front of the queue (if it exists) or NULL if there are no Nodes in the queue  
- */
+  printf("\nLowest 3: "); 
+  for (size_t i = 0; i < 3; i++) printf("%d, ", partial[i]); 
+  printf("\n"); 
 
-int dequeue(Queue* q) {
+  // Every size and k against qsort 
+  size_t sizes[] = { 0, 1, 2, 3, 10, 1000, 100001 }; 
+  bool matched = true; 
 
-  if (q == NULL) {
-    DEBUG_PRINT("Error: Attempting to dequeue from a NULL queue\n", NULL); 
-    return -1;
-  }
+  for (size_t s = 0; s < LENGTH(sizes, size_t); s++) {
+    size_t n = sizes[s]; 
+    uint16_t* expected = (uint16_t*) malloc(sizeof(uint16_t) * (n + 1)); 
+    uint16_t* sorted = (uint16_t*) malloc(sizeof(uint16_t) * (n + 1)); 
+    uint16_t* first_k = (uint16_t*) malloc(sizeof(uint16_t) * (n + 1)); 
+    uint32_t seed = 12345; 
+    size_t k = n / 3 + 1; 
 
-  if (q->size == 0 || q->rear == -1) {
-    DEBUG_PRINT("Error: The queue is empty so cannot dequeue a node\n", NULL);
-    return -1;
-  }
+    if (expected == NULL || sorted == NULL || first_k == NULL) return; 
+
+    for (size_t i = 0; i < n; i++) {
+      seed = seed * 1103515245 + 12345; 
+      expected[i] = sorted[i] = first_k[i] = (uint16_t) (seed >> 16); 
+    }
+
+    qsort(expected, n, sizeof(uint16_t), compare_uint16); 
+    max_heap_heapsort(sorted, n); 
+    max_heap_partial_sort(first_k, n, k); 
 
-  int x = q->queue[q->front];
-  q->front = ((q->front + 1) % q->capacity);
-  q->size -= 1; 
+    for (size_t i = 0; i < n; i++) {
+      if (sorted[i] != expected[i]) matched = false; 
+      if (i < k && first_k[i] != expected[i]) matched = false; 
+    }
 
-  if (q->size == 0) {
-    q->front = 0;  
-    q->rear = -1; 
+    free(expected); 
+    free(sorted); 
+    free(first_k); 
   }
- 
-  return x;
 
+  printf("Matches qsort: %s\n\n", matched ? "true" : "false"); 
 }
 
-void print_heap(MaxHeap* heap) {
-  Node** h = heap->heap;  
+void run_tests() {
+  MaxHeap heap = max_heap_initialize();
 
-  printf("[");
-  for (int i = 0; i < heap->size; i++) {
-    if (h[i] == NULL) {
-      printf("%d is null in heap\n", i); 
-      continue; 
-    }
-    printf("%u, ", h[i]->data);  
-  }
+  test_insertion(&heap);
 
-  printf("]\n");
+  test_extract_max(&heap);
+
+  test_peek(&heap);
+
+  test_deletion(&heap);
+
+  max_heap_free(&heap);
+
+  test_build_heap();
+
+  test_handles();
+
+  test_growth();
+
+  test_custom_key();
+
+  test_build_parallel();
+
+  test_insert_batch();
+
+  test_heapsort();
 
 }
 
 /**
- * ===========
- * || Tests ||
- * ===========
+ * ================
+ * || Benchmarks ||
+ * ================
  */
 
-void test_insertion(MaxHeap* heap) {
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9; 
+}
+
+void bench_push_pop() {
   printf("==================\n");
-  printf("|| Insertion    ||\n"); 
+  printf("|| Push/ Pop    ||\n"); 
   printf("==================\n\n");
 
-  int nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64 };
-  
-  for (int i = 0; i < (sizeof(nums) / sizeof(int)); i++) {
-    printf("Adding node: %d\n", nums[i]); 
-    insert(heap, nums[i]); 
-    print_heap(heap); 
+  printf("Heap arity: %d\n", HEAP_ARITY); 
+
+  MaxHeap heap = max_heap_initialize(); 
+  struct timespec start, end; 
+  uint32_t seed = 12345; 
+  uint64_t checksum = 0; 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    seed = seed * 1103515245 + 12345; 
+    max_heap_insert(&heap, (uint16_t) (seed >> 16)); 
   }
 
-  print_heap(heap); 
-  printf("\n");
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double push_time = elapsed_seconds(start, end); 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+
+  while (heap.size > 0) {
+    checksum += extract_max(&heap); 
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double pop_time = elapsed_seconds(start, end); 
+
+  printf("%d pushes: %.2f Mops/s\n", BENCHMARK_SIZE, BENCHMARK_SIZE / push_time / 1e6); 
+  printf("%d pops:   %.2f Mops/s\n", BENCHMARK_SIZE, BENCHMARK_SIZE / pop_time / 1e6); 
+  printf("Heap memory: %zu bytes per node (checksum %lu)\n\n", sizeof(MaxHeapNode), (unsigned long) checksum); 
+
+  max_heap_free(&heap); 
 }
 
-void test_deletion(MaxHeap* heap) {
+void bench_build_heap() {
   printf("==================\n");
-  printf("|| Deletion     ||\n"); 
+  printf("|| Build Heap   ||\n"); 
   printf("==================\n\n");
 
+  uint16_t* data = (uint16_t*) malloc(sizeof(uint16_t) * BENCHMARK_SIZE); 
+  struct timespec start, end; 
+  uint32_t seed = 12345; 
 
-  int nums[] = { 38, 40, 64, 16 };
+  if (data == NULL) return; 
 
-  for (int i = 0; i < LENGTH(nums, int); i++) {
-    delete_node(heap, nums[i]); 
-    printf("\n");
-    print_heap(heap); 
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    seed = seed * 1103515245 + 12345; 
+    data[i] = (uint16_t) (seed >> 16); 
   }
 
-  printf("\n");
-  
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+
+  MaxHeap inserted = max_heap_initialize(); 
+  max_heap_reserve(&inserted, BENCHMARK_SIZE); 
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    max_heap_insert(&inserted, data[i]); 
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double insert_time = elapsed_seconds(start, end); 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  MaxHeap built = max_heap_build(data, BENCHMARK_SIZE); 
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double build_time = elapsed_seconds(start, end); 
+
+  printf("Insert loop of %d nodes: %.2f ms\n", BENCHMARK_SIZE, insert_time * 1e3); 
+  printf("build_heap of %d nodes:  %.2f ms\n", BENCHMARK_SIZE, build_time * 1e3); 
+  printf("Same root: %s\n\n", max_heap_peek(&inserted)->data == max_heap_peek(&built)->data ? "true" : "false"); 
+
+  max_heap_free(&inserted); 
+  max_heap_free(&built); 
+  free(data); 
 }
 
-void test_extract_max(MaxHeap* heap) {
+// A queue of 8x BENCHMARK_SIZE nodes built serially and in parallel, then a burst of BENCHMARK_SIZE more added by insert() and insert_batch() 
+
+void bench_bulk_load() {
   printf("==================\n");
-  printf("|| Extract Max  ||\n"); 
+  printf("|| Bulk Load    ||\n"); 
   printf("==================\n\n");
 
-  for (int i = 0; i < 2; i++) {
-    printf("Before: "); 
-    print_heap(heap);
-    int16_t data = extract_max(heap); 
-    printf("Extracted: %d", data); 
-    printf("\nAfter: ");
-    print_heap(heap);
-    printf("\n");
+  size_t n = BENCHMARK_SIZE * 8; 
+  uint16_t* data = (uint16_t*) malloc(sizeof(uint16_t) * n); 
+  struct timespec start, end; 
+  uint32_t seed = 12345; 
+
+  if (data == NULL) return; 
+
+  for (size_t i = 0; i < n; i++) {
+    seed = seed * 1103515245 + 12345; 
+    data[i] = (uint16_t) (seed >> 16); 
   }
 
-  printf("\n");
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  MaxHeap serial = max_heap_build(data, n); 
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double serial_time = elapsed_seconds(start, end); 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  MaxHeap parallel = max_heap_build_parallel(data, n, BUILD_THREADS); 
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double parallel_time = elapsed_seconds(start, end); 
+
+  // The burst goes on top of the built heaps, one with insert() one with insert_batch() 
+  max_heap_reserve(&serial, n + BENCHMARK_SIZE); 
+  max_heap_reserve(&parallel, n + BENCHMARK_SIZE); 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) max_heap_insert(&serial, data[i]); 
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double insert_time = elapsed_seconds(start, end); 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  max_heap_insert_batch(&parallel, data, BENCHMARK_SIZE); 
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double batch_time = elapsed_seconds(start, end); 
+
+  printf("build of %zu nodes:          %.2f ms\n", n, serial_time * 1e3); 
+#ifdef HEAP_PARALLEL
+  printf("build_parallel, %d threads:  %.2f ms\n", BUILD_THREADS, parallel_time * 1e3); 
+#else
+  printf("build_parallel, 1 thread:    %.2f ms (define HEAP_PARALLEL for threads)\n", parallel_time * 1e3); 
+#endif
+  printf("%d inserts:             %.2f ms\n", BENCHMARK_SIZE, insert_time * 1e3); 
+  printf("insert_batch of %d:     %.2f ms\n", BENCHMARK_SIZE, batch_time * 1e3); 
+  printf("Same root: %s\n\n", max_heap_peek(&serial)->data == max_heap_peek(&parallel)->data ? "true" : "false"); 
+
+  max_heap_free(&serial); 
+  max_heap_free(&parallel); 
+  free(data); 
 }
 
-void test_peek(MaxHeap* heap) {
+// Sort BENCHMARK_SIZE values with qsort and heapsort, then take the lowest k with partial_sort against a full qsort 
+
+void bench_sort() {
   printf("==================\n");
-  printf("|| Peek         ||\n"); 
+  printf("|| Sort         ||\n"); 
   printf("==================\n\n");
 
-  Node* node = peek(heap);  
+  uint16_t* data = (uint16_t*) malloc(sizeof(uint16_t) * BENCHMARK_SIZE); 
+  uint16_t* work = (uint16_t*) malloc(sizeof(uint16_t) * BENCHMARK_SIZE); 
+  size_t ks[] = { 10, 1000, 100000 }; 
+  struct timespec start, end; 
+  uint32_t seed = 12345; 
 
-  if (node != NULL) {
-    printf("Max: %d\n\n", node->data);
-    return;
+  if (data == NULL || work == NULL) return; 
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    seed = seed * 1103515245 + 12345; 
+    data[i] = (uint16_t) (seed >> 16); 
   }
-}
 
-void test_build_heap() {
-  
+  memcpy(work, data, sizeof(uint16_t) * BENCHMARK_SIZE); 
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  qsort(work, BENCHMARK_SIZE, sizeof(uint16_t), compare_uint16); 
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double qsort_time = elapsed_seconds(start, end); 
+
+  memcpy(work, data, sizeof(uint16_t) * BENCHMARK_SIZE); 
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  max_heap_heapsort(work, BENCHMARK_SIZE); 
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+
+  printf("qsort of %d values:     %.2f ms\n", BENCHMARK_SIZE, qsort_time * 1e3); 
+  printf("heapsort of %d values:  %.2f ms\n", BENCHMARK_SIZE, elapsed_seconds(start, end) * 1e3); 
+
+  for (size_t i = 0; i < LENGTH(ks, size_t); i++) {
+    memcpy(work, data, sizeof(uint16_t) * BENCHMARK_SIZE); 
+    clock_gettime(CLOCK_MONOTONIC, &start); 
+    max_heap_partial_sort(work, BENCHMARK_SIZE, ks[i]); 
+    clock_gettime(CLOCK_MONOTONIC, &end); 
+
+    printf("partial_sort, k = %-6zu  %.2f ms\n", ks[i], elapsed_seconds(start, end) * 1e3); 
+  }
+
+  printf("\n"); 
+
+  free(data); 
+  free(work); 
 }
 
-void run_tests() {
-  MaxHeap heap = initialize_heap();
+// Steady state queue: hold BENCHMARK_SIZE nodes and push a new node then pop the top each round (Scheduler/ timer style)
+// Each round is a sift up and a sift down, so both directions count when comparing HEAP_ARITY settings
 
-  test_insertion(&heap);
+void bench_mixed() {
+  printf("==================\n");
+  printf("|| Mixed        ||\n"); 
+  printf("==================\n\n");
 
-  test_extract_max(&heap);
+  MaxHeap heap = max_heap_initialize(); 
+  struct timespec start, end; 
+  uint32_t seed = 12345; 
+  uint64_t checksum = 0; 
 
-  test_peek(&heap);
+  max_heap_reserve(&heap, BENCHMARK_SIZE + 1); 
 
-  test_deletion(&heap);
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    seed = seed * 1103515245 + 12345; 
+    max_heap_insert(&heap, (uint16_t) (seed >> 16)); 
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    seed = seed * 1103515245 + 12345; 
+    max_heap_insert(&heap, (uint16_t) (seed >> 16)); 
+    checksum += extract_max(&heap); 
+  }
 
-  free_heap(&heap);
+  clock_gettime(CLOCK_MONOTONIC, &end); 
 
+  printf("Heap arity: %d\n", HEAP_ARITY); 
+  printf("%d push + pop pairs on a %d node heap: %.2f Mops/s (checksum %lu)\n\n", BENCHMARK_SIZE, BENCHMARK_SIZE, BENCHMARK_SIZE / elapsed_seconds(start, end) / 1e6, (unsigned long) checksum); 
+
+  max_heap_free(&heap); 
+}
+
+void run_benchmarks() {
+  bench_push_pop(); 
+  bench_build_heap(); 
+  bench_mixed(); 
+  bench_bulk_load(); 
+  bench_sort(); 
 }
 
 /** 
@@ -631,5 +778,8 @@ void run_tests() {
 
 int main() {
   run_tests(); 
+
+  if (RUN_BENCHMARKS) run_benchmarks(); 
+
   return 0;
 }
@@ -2,12 +2,16 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 
-#define INITIAL_HEAP_CAPACITY 20 
-#define QUEUE_CAPACITY 50
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define LENGTH(arr, dt) (sizeof(arr) / sizeof(dt))
 #define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
 
 #ifdef DEBUG
 #define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
@@ -15,236 +19,176 @@
 #define DEBUG_PRINT(fmt, ...)
 #endif
 
-//  NOTE: There could be more in the Node struct 
-//  NOTE: This is just here to treat each item in a heap as a Node rather than just having an array of integers 
+//  NOTE: The heap is generated by DEFINE_HEAP in heaps/heap.h, see heaps/max-heap/max-heap.c for a custom key example
 
-typedef struct {
-  uint16_t data; 
-} Node;
+#include "../heap.h"
 
-typedef struct {
-  uint16_t size; 
-  uint16_t capacity; 
-  Node** heap; 
-} MinHeap; 
+#define MIN_HEAP_HIGHER(a, b) ((a) < (b))
 
-typedef struct {
-  int* queue;
-  uint16_t front;
-  int16_t rear; 
-  uint16_t size; 
-  uint16_t capacity;
-} Queue;
-
-// Setup/ Teardown Methods 
-
-MinHeap initialize_heap();
-Node* initialize_node(uint16_t node_data); 
-
-// Heap Operations 
-
-MinHeap build_heap(Node** arr);
-void min_heapify(MinHeap* heap, uint16_t idx);
-void insert(MinHeap* heap, uint16_t node_data); 
-void delete(MinHeap* heap, uint16_t node_data);
-int16_t right_child_idx(MinHeap* heap, uint16_t idx); 
-int16_t left_child_idx(MinHeap* heap, uint16_t idx); 
-int16_t parent_idx(uint16_t idx); 
-void swap(Node** heap, uint16_t i, uint16_t j); 
-Node* peek(MinHeap* heap);
-void print_heap(MinHeap* heap); 
-
-// Queue Utility
-Queue initialize_queue(); 
-void free_queue(Queue* q);
-void enqueue(Queue* q, int x); 
-int dequeue(Queue* q);
+DEFINE_HEAP(MinHeap, min_heap, uint16_t, MIN_HEAP_HIGHER)
 
-MinHeap initialize_heap() {
-  MinHeap h;  
-  Node** heap = (Node**) malloc(sizeof(Node*) * INITIAL_HEAP_CAPACITY);
+// A min ordering heapsort puts the largest key first, which is the order top_k_sorted(...) hands the keys back in 
 
-  if (heap == NULL) {
-    DEBUG_PRINT("Error allocating memory for the heap\n", NULL);
-    exit(EXIT_FAILURE);
-  }
+DEFINE_HEAP_SORT(min_heap, uint16_t, MIN_HEAP_HIGHER)
 
-  h.heap = heap; 
-  h.size = 0; 
-  h.capacity = INITIAL_HEAP_CAPACITY; 
+// With handles for decrease key/ delete by handle (Dijkstra style use) 
 
-  return h;
-}
+DEFINE_INDEXED_HEAP(IndexedMinHeap, indexed_min_heap, uint16_t, MIN_HEAP_HIGHER)
 
-Node* initialize_node(uint16_t node_data) {
-  Node* n = (Node*) malloc(sizeof(Node));  
+// Only used to benchmark the top-K selector against the old MaxHeap + extract_max() drain 
 
-  if (n == NULL) {
-    DEBUG_PRINT("Error allocating memory for Node: %d", node_data);
-    exit(EXIT_FAILURE);
-  }
+#define MAX_HEAP_HIGHER(a, b) ((a) > (b))
 
-  n->data = node_data;
-  return n; 
-}
+DEFINE_HEAP(MaxHeap, max_heap, uint16_t, MAX_HEAP_HIGHER)
 
-void free_heap(MinHeap* heap) {
+// Keep the K largest keys of a stream - The root of the min heap is the smallest of them so anything not above it can be rejected 
 
-  if (heap == NULL || heap->size == 0) {
-    DEBUG_PRINT("Trying to free NULL or EMPTY heap\n", NULL);
-    return;
-  }
+typedef struct {
+  size_t k; 
+  MinHeap heap; 
+} TopK; 
 
-  for (int i = 0; i < heap->size; i++) {
-    DEBUG_PRINT("Freeing Node: %d\n", heap->heap[i]->data); 
-    free(heap->heap[i]);
-  }
+int32_t extract_min(MinHeap* heap);
+void print_heap(MinHeap* heap); 
 
-  DEBUG_PRINT("All Nodes found have been freed\n\n", NULL);
+TopK top_k_initialize(size_t k); 
+void top_k_free(TopK* top); 
+bool top_k_offer(TopK* top, uint16_t key); 
+size_t top_k_offer_batch(TopK* top, const uint16_t* keys, size_t n); 
+size_t top_k_sorted(TopK* top, uint16_t* out); 
 
-  free(heap->heap);
-  heap->heap = NULL; 
-  heap = NULL; 
+int32_t extract_min(MinHeap* heap) {
+  uint16_t node_data; 
 
-}
+  if (!min_heap_extract(heap, &node_data)) return -1; 
 
-void swap(Node** heap, uint16_t i, uint16_t j) {
-  Node* temp = heap[i]; 
-  heap[i] = heap[j];
-  heap[j] = temp;
+  return node_data;
 }
 
-int16_t left_child_idx(MinHeap* heap, uint16_t idx) {
-  uint16_t l_idx = (idx * 2) + 1;  
-
-  if (l_idx >= heap->size) return -1; 
+void print_heap(MinHeap* heap) {
 
-  return l_idx; 
-}
+  if (heap == NULL || heap->size == 0) {
+    printf("No heap to print\n");
+    return;
+  }
 
-int16_t right_child_idx(MinHeap* heap, uint16_t idx) {
-  uint16_t r_idx = (idx * 2) + 2;  
+  printf("[");
 
-  if (r_idx >= heap->size) return -1; 
+  for (size_t i = 0; i < heap->size; i++) {
+    printf("%u, ", heap->heap[i].data); 
+  }
 
-  return r_idx; 
+  printf("]\n");
 }
 
-int16_t parent_idx(uint16_t idx) {
-  uint16_t p_idx = (idx / 2); 
+void print_indexed_heap(IndexedMinHeap* heap) {
+  printf("[");
 
-  if (p_idx < 0) return -1;
+  for (size_t i = 0; i < heap->size; i++) {
+    printf("%u, ", heap->heap[i].data); 
+  }
 
-  return p_idx; 
+  printf("]\n");
 }
 
-void min_heapify(MinHeap* heap, uint16_t idx) {
-
-  if (heap == NULL) return; 
-  if (idx >= heap->size || idx < 0) return;
-
-  int16_t l_idx = left_child_idx(heap, idx);
-  int16_t r_idx = right_child_idx(heap, idx); 
-  uint16_t min_idx = idx; 
+/**
+ * ===========
+ * || Top K ||
+ * ===========
+ */
 
-  Node* right = r_idx == -1 ? NULL : heap->heap[r_idx];
-  Node* left = l_idx == -1 ? NULL : heap->heap[l_idx];
-  Node* min = heap->heap[min_idx];
+// The heap gets all K slots up front and never grows past them 
 
-  if (left != NULL && left->data < min->data) {
-    min_idx = l_idx;  
-    min = heap->heap[min_idx];
-  }
+TopK top_k_initialize(size_t k) {
+  TopK top = { .k = k, .heap = min_heap_initialize() }; 
 
-  if (right != NULL && right->data < min->data) {
-    min_idx = r_idx;  
-    min = heap->heap[min_idx];
+  if (!min_heap_reserve(&top.heap, k)) {
+    DEBUG_PRINT("Error: Could not reserve %zu slots for the top K\n", k); 
+    exit(EXIT_FAILURE); 
   }
 
-  if (min_idx != idx) {
-    swap(heap->heap, idx, min_idx); 
-    min_heapify(heap, min_idx);
-  }
-  
+  return top; 
 }
 
-void insert(MinHeap* heap, uint16_t node_data) {
-
-  if (heap == NULL) return;  
-  if (heap->size == heap->capacity) return; 
-
-  Node* new_node = initialize_node(node_data);
-  heap->heap[heap->size] = new_node; 
-
-  int16_t p_idx = parent_idx(heap->size);
-  uint16_t c_idx = heap->size; 
-
-  if (p_idx == -1) {
-    heap->size += 1; 
-    return;
-  }
+void top_k_free(TopK* top) {
+  if (top == NULL) return; 
 
-  Node* parent = heap->heap[p_idx];
-  Node* current = heap->heap[c_idx];
-
-  while (parent->data > current->data) {
-    swap(heap->heap, c_idx, p_idx); 
+  min_heap_free(&top->heap); 
+}
 
-    c_idx = p_idx; 
-    p_idx = parent_idx(p_idx);
+// Offer one key, false if it was rejected. Once the heap is full a rejection is a single compare against the root 
 
-    if (p_idx == -1) break;
+bool top_k_offer(TopK* top, uint16_t key) {
+  if (top == NULL || top->k == 0) return false; 
 
-    current = heap->heap[c_idx];
-    parent = heap->heap[p_idx];
+  MinHeap* heap = &top->heap; 
 
+  if (heap->size < top->k) {
+    min_heap_insert(heap, key); 
+    return true; 
   }
 
-  heap->size += 1; 
+  if (key <= heap->heap[0].data) return false; 
+
+  // Overwrite the root rather than extract + insert, one sift down instead of a sift down and a sift up 
+  min_heap_replace_top(heap, key, NULL); 
 
+  return true; 
 }
 
-//
+// Offer n keys, returns how many were taken. Keys are compared against the root 8 at a time with SSE2 and 
+// only a block with something above the root touches the heap - in a long stream that is almost never 
 
-int16_t extract_min(MinHeap* heap) {
+size_t top_k_offer_batch(TopK* top, const uint16_t* keys, size_t n) {
+  if (top == NULL || keys == NULL) return 0; 
 
-  if (heap == NULL || heap->size == 0) return -1;
+  size_t taken = 0; 
+  size_t i = 0; 
 
-  Node* min = heap->heap[0];
-  int16_t node_data = min->data;
-  swap(heap->heap, 0, heap->size - 1);
+  // Fill the heap first, there is no root to filter against until it's full 
+  while (i < n && top->heap.size < top->k) {
+    taken += top_k_offer(top, keys[i]); 
+    i++; 
+  }
 
-  free(heap->heap[heap->size -1]);
-  heap->heap[heap->size - 1] = NULL;
+#ifdef __SSE2__
+  // SSE2 only has a signed 16 bit compare, flipping the top bit of both sides makes it order unsigned keys 
+  const __m128i flip = _mm_set1_epi16((short) 0x8000); 
 
-  heap->size -= 1;
+  for (; i + 8 <= n && top->k > 0; i += 8) {
+    __m128i threshold = _mm_set1_epi16((short) (top->heap.heap[0].data ^ 0x8000)); 
+    __m128i block = _mm_xor_si128(_mm_loadu_si128((const __m128i*) &keys[i]), flip); 
 
-  min_heapify(heap, 0);
- 
-  return node_data;
+    if (_mm_movemask_epi8(_mm_cmpgt_epi16(block, threshold)) == 0) continue; 
 
-}
+    for (size_t j = i; j < i + 8; j++) {
+      taken += top_k_offer(top, keys[j]); 
+    }
+  }
+#endif
 
-Node* peek(MinHeap* heap) {
-  if (heap->size == 0) return NULL; 
+  for (; i < n; i++) {
+    taken += top_k_offer(top, keys[i]); 
+  }
 
-  return heap->heap[0];
+  return taken; 
 }
 
-void print_heap(MinHeap* heap) {
+// Write the kept keys into out largest first, returns how many were written. The heap is left as it was 
 
-  if (heap == NULL || heap->size == 0) {
-    printf("No heap to print\n");
-    return;
-  }
+size_t top_k_sorted(TopK* top, uint16_t* out) {
+  if (top == NULL || out == NULL) return 0; 
 
-  printf("[");
+  size_t n = top->heap.size; 
 
-  for (int i = 0; i < heap->size; i++) {
-    printf("%u, ", heap->heap[i]->data); 
+  for (size_t i = 0; i < n; i++) {
+    out[i] = top->heap.heap[i].data; 
   }
 
-  printf("]\n");
+  // Sort the copy in place, no second heap to allocate 
+  min_heap_heapsort(out, n); 
+
+  return n; 
 }
 
 /**
@@ -262,7 +206,7 @@ void test_insertion(MinHeap* heap) {
   
   for (int i = 0; i < (sizeof(nums) / sizeof(int)); i++) {
     printf("Adding node: %d\n", nums[i]); 
-    insert(heap, nums[i]); 
+    min_heap_insert(heap, nums[i]); 
     print_heap(heap); 
   }
 
@@ -280,7 +224,7 @@ void test_extract_max(MinHeap* heap) {
   for (int i = 0; i < 2; i++) {
     printf("Before: "); 
     print_heap(heap);
-    int16_t data = extract_min(heap); 
+    int32_t data = extract_min(heap); 
     printf("Extracted: %d", data); 
     printf("\nAfter: ");
     print_heap(heap);
@@ -295,7 +239,7 @@ void test_peek(MinHeap* heap) {
   printf("|| Peek         ||\n"); 
   printf("==================\n\n");
 
-  Node* node = peek(heap);  
+  MinHeapNode* node = min_heap_peek(heap);  
 
   if (node != NULL) {
     printf("Min: %d\n\n", node->data);
@@ -304,11 +248,162 @@ void test_peek(MinHeap* heap) {
 }
 
 void test_build_heap() {
-  
+  printf("==================\n");
+  printf("|| Build Heap   ||\n"); 
+  printf("==================\n\n");
+
+  uint16_t nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64 };
+  MinHeap heap = min_heap_build(nums, LENGTH(nums, uint16_t)); 
+
+  print_heap(&heap); 
+
+  printf("Drained: "); 
+  while (heap.size > 0) {
+    printf("%d, ", extract_min(&heap)); 
+  }
+
+  printf("\n\n"); 
+
+  min_heap_free(&heap); 
+}
+
+void test_handles() {
+  printf("==================\n");
+  printf("|| Handles      ||\n"); 
+  printf("==================\n\n");
+
+  IndexedMinHeap heap = indexed_min_heap_initialize(); 
+  uint16_t nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64 };
+  size_t handles[LENGTH(nums, uint16_t)]; 
+
+  for (size_t i = 0; i < LENGTH(nums, uint16_t); i++) {
+    handles[i] = indexed_min_heap_insert(&heap, nums[i]); 
+  }
+
+  print_indexed_heap(&heap); 
+
+  printf("Decrease 463 -> 1\n"); 
+  indexed_min_heap_promote(&heap, handles[4], 1); 
+  print_indexed_heap(&heap); 
+
+  printf("Increase 27 -> 500\n"); 
+  indexed_min_heap_demote(&heap, handles[2], 500); 
+  print_indexed_heap(&heap); 
+
+  printf("Delete 40 by handle\n"); 
+  indexed_min_heap_delete(&heap, handles[7]); 
+  print_indexed_heap(&heap); 
+
+  printf("Handle for 40 still in heap: %s\n", indexed_min_heap_contains(&heap, handles[7]) ? "true" : "false"); 
+  printf("Decrease with a larger key rejected: %s\n", indexed_min_heap_promote(&heap, handles[0], 1000) ? "false" : "true"); 
+
+  printf("Drained: "); 
+  uint16_t min; 
+  while (heap.size > 0) {
+    indexed_min_heap_extract(&heap, &min); 
+    printf("%d, ", min); 
+  }
+
+  printf("\n\n"); 
+
+  indexed_min_heap_free(&heap); 
+}
+
+void test_growth() {
+  printf("==================\n");
+  printf("|| Growth       ||\n"); 
+  printf("==================\n\n");
+
+  MinHeap heap = min_heap_initialize(); 
+  size_t n = 100000; 
+
+  min_heap_reserve(&heap, n); 
+  size_t reserved = heap.capacity; 
+
+  for (size_t i = 0; i < n; i++) {
+    min_heap_insert(&heap, (uint16_t) ((i * 7919) % 65536)); 
+  }
+
+  printf("Inserted %zu nodes, capacity after reserve: %zu, capacity now: %zu\n", heap.size, reserved, heap.capacity); 
+
+  int32_t prev = extract_min(&heap); 
+  bool ordered = true; 
+
+  while (heap.size > 0) {
+    int32_t current = extract_min(&heap); 
+    if (current < prev) ordered = false; 
+    prev = current; 
+  }
+
+  printf("Drained in order: %s\n", ordered ? "true" : "false"); 
+
+  min_heap_shrink_to_fit(&heap); 
+  printf("Capacity after shrink_to_fit: %zu\n\n", heap.capacity); 
+
+  min_heap_free(&heap); 
+}
+
+void test_top_k() {
+  printf("==================\n");
+  printf("|| Top K        ||\n"); 
+  printf("==================\n\n");
+
+  uint16_t nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64, 1, 2, 3, 500, 4, 5, 6, 7, 8, 9, 10 };
+  uint16_t sorted[5]; 
+  TopK top = top_k_initialize(5); 
+
+  for (size_t i = 0; i < LENGTH(nums, uint16_t); i++) {
+    top_k_offer(&top, nums[i]); 
+  }
+
+  size_t n = top_k_sorted(&top, sorted); 
+
+  printf("Top 5: "); 
+  for (size_t i = 0; i < n; i++) printf("%d, ", sorted[i]); 
+  printf("\n"); 
+
+  top_k_free(&top); 
+
+  // The batch (SIMD) path has to keep exactly the same keys as offering them one at a time 
+  size_t stream_size = 100003; 
+  size_t k = 100; 
+  uint16_t* stream = (uint16_t*) malloc(sizeof(uint16_t) * stream_size); 
+  uint16_t* one = (uint16_t*) malloc(sizeof(uint16_t) * k); 
+  uint16_t* batch = (uint16_t*) malloc(sizeof(uint16_t) * k); 
+  uint32_t seed = 12345; 
+  bool same = true; 
+
+  if (stream == NULL || one == NULL || batch == NULL) return; 
+
+  for (size_t i = 0; i < stream_size; i++) {
+    seed = seed * 1103515245 + 12345; 
+    stream[i] = (uint16_t) (seed >> 16); 
+  }
+
+  TopK singles = top_k_initialize(k); 
+  TopK batched = top_k_initialize(k); 
+
+  for (size_t i = 0; i < stream_size; i++) top_k_offer(&singles, stream[i]); 
+  top_k_offer_batch(&batched, stream, stream_size); 
+
+  top_k_sorted(&singles, one); 
+  top_k_sorted(&batched, batch); 
+
+  for (size_t i = 0; i < k; i++) {
+    if (one[i] != batch[i]) same = false; 
+  }
+
+  printf("Batch matches single offers: %s\n\n", same ? "true" : "false"); 
+
+  top_k_free(&singles); 
+  top_k_free(&batched); 
+  free(stream); 
+  free(one); 
+  free(batch); 
 }
 
 void run_tests() {
-  MinHeap heap = initialize_heap();
+  MinHeap heap = min_heap_initialize();
 
   test_insertion(&heap);
 
@@ -316,11 +411,227 @@ void run_tests() {
 
   test_peek(&heap);
 
-  free_heap(&heap);
+  min_heap_free(&heap);
+
+  test_build_heap();
+
+  test_handles();
+
+  test_growth();
+
+  test_top_k();
 
 }
 
+/**
+ * ================
+ * || Benchmarks ||
+ * ================
+ */
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9; 
+}
+
+void bench_push_pop() {
+  printf("==================\n");
+  printf("|| Push/ Pop    ||\n"); 
+  printf("==================\n\n");
+
+  printf("Heap arity: %d\n", HEAP_ARITY); 
+
+  MinHeap heap = min_heap_initialize(); 
+  struct timespec start, end; 
+  uint32_t seed = 12345; 
+  uint64_t checksum = 0; 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    seed = seed * 1103515245 + 12345; 
+    min_heap_insert(&heap, (uint16_t) (seed >> 16)); 
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double push_time = elapsed_seconds(start, end); 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+
+  while (heap.size > 0) {
+    checksum += extract_min(&heap); 
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double pop_time = elapsed_seconds(start, end); 
+
+  printf("%d pushes: %.2f Mops/s\n", BENCHMARK_SIZE, BENCHMARK_SIZE / push_time / 1e6); 
+  printf("%d pops:   %.2f Mops/s\n", BENCHMARK_SIZE, BENCHMARK_SIZE / pop_time / 1e6); 
+  printf("Heap memory: %zu bytes per node (checksum %lu)\n\n", sizeof(MinHeapNode), (unsigned long) checksum); 
+
+  min_heap_free(&heap); 
+}
+
+void bench_build_heap() {
+  printf("==================\n");
+  printf("|| Build Heap   ||\n"); 
+  printf("==================\n\n");
+
+  uint16_t* data = (uint16_t*) malloc(sizeof(uint16_t) * BENCHMARK_SIZE); 
+  struct timespec start, end; 
+  uint32_t seed = 12345; 
+
+  if (data == NULL) return; 
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    seed = seed * 1103515245 + 12345; 
+    data[i] = (uint16_t) (seed >> 16); 
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+
+  MinHeap inserted = min_heap_initialize(); 
+  min_heap_reserve(&inserted, BENCHMARK_SIZE); 
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    min_heap_insert(&inserted, data[i]); 
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double insert_time = elapsed_seconds(start, end); 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+  MinHeap built = min_heap_build(data, BENCHMARK_SIZE); 
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double build_time = elapsed_seconds(start, end); 
+
+  printf("Insert loop of %d nodes: %.2f ms\n", BENCHMARK_SIZE, insert_time * 1e3); 
+  printf("build_heap of %d nodes:  %.2f ms\n", BENCHMARK_SIZE, build_time * 1e3); 
+  printf("Same root: %s\n\n", min_heap_peek(&inserted)->data == min_heap_peek(&built)->data ? "true" : "false"); 
+
+  min_heap_free(&inserted); 
+  min_heap_free(&built); 
+  free(data); 
+}
+
+// Steady state queue: hold BENCHMARK_SIZE nodes and push a new node then pop the top each round (Scheduler/ timer style)
+// Each round is a sift up and a sift down, so both directions count when comparing HEAP_ARITY settings
+
+void bench_mixed() {
+  printf("==================\n");
+  printf("|| Mixed        ||\n"); 
+  printf("==================\n\n");
+
+  MinHeap heap = min_heap_initialize(); 
+  struct timespec start, end; 
+  uint32_t seed = 12345; 
+  uint64_t checksum = 0; 
+
+  min_heap_reserve(&heap, BENCHMARK_SIZE + 1); 
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    seed = seed * 1103515245 + 12345; 
+    min_heap_insert(&heap, (uint16_t) (seed >> 16)); 
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    seed = seed * 1103515245 + 12345; 
+    min_heap_insert(&heap, (uint16_t) (seed >> 16)); 
+    checksum += extract_min(&heap); 
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+
+  printf("Heap arity: %d\n", HEAP_ARITY); 
+  printf("%d push + pop pairs on a %d node heap: %.2f Mops/s (checksum %lu)\n\n", BENCHMARK_SIZE, BENCHMARK_SIZE, BENCHMARK_SIZE / elapsed_seconds(start, end) / 1e6, (unsigned long) checksum); 
+
+  min_heap_free(&heap); 
+}
+
+// Top 100 of a 10 million key stream: one offer at a time, the SIMD batch and the old insert everything into a MaxHeap and drain 
+
+void bench_top_k() {
+  printf("==================\n");
+  printf("|| Top K        ||\n"); 
+  printf("==================\n\n");
+
+  size_t stream_size = BENCHMARK_SIZE * 10; 
+  size_t k = 100; 
+  uint16_t* stream = (uint16_t*) malloc(sizeof(uint16_t) * stream_size); 
+  uint16_t* result = (uint16_t*) malloc(sizeof(uint16_t) * k); 
+  struct timespec start, end; 
+  uint32_t seed = 12345; 
+  uint64_t checksums[3] = { 0, 0, 0 }; 
+
+  if (stream == NULL || result == NULL) return; 
+
+  for (size_t i = 0; i < stream_size; i++) {
+    seed = seed * 1103515245 + 12345; 
+    stream[i] = (uint16_t) (seed >> 16); 
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+
+  TopK singles = top_k_initialize(k); 
+  for (size_t i = 0; i < stream_size; i++) top_k_offer(&singles, stream[i]); 
+  top_k_sorted(&singles, result); 
+
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double single_time = elapsed_seconds(start, end); 
+
+  for (size_t i = 0; i < k; i++) checksums[0] += result[i]; 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+
+  TopK batched = top_k_initialize(k); 
+  top_k_offer_batch(&batched, stream, stream_size); 
+  top_k_sorted(&batched, result); 
+
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double batch_time = elapsed_seconds(start, end); 
+
+  for (size_t i = 0; i < k; i++) checksums[1] += result[i]; 
+
+  clock_gettime(CLOCK_MONOTONIC, &start); 
+
+  MaxHeap drained = max_heap_initialize(); 
+  for (size_t i = 0; i < stream_size; i++) max_heap_insert(&drained, stream[i]); 
+  for (size_t i = 0; i < k; i++) max_heap_extract(&drained, &result[i]); 
+
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  double drain_time = elapsed_seconds(start, end); 
+
+  for (size_t i = 0; i < k; i++) checksums[2] += result[i]; 
+
+#ifdef __SSE2__
+  printf("SSE2 prefilter: on\n"); 
+#else
+  printf("SSE2 prefilter: off (scalar fallback)\n"); 
+#endif
+  printf("Top %zu of %zu keys, offer():         %.2f Mkeys/s\n", k, stream_size, stream_size / single_time / 1e6); 
+  printf("Top %zu of %zu keys, offer_batch():   %.2f Mkeys/s\n", k, stream_size, stream_size / batch_time / 1e6); 
+  printf("Top %zu of %zu keys, MaxHeap drain:   %.2f Mkeys/s\n", k, stream_size, stream_size / drain_time / 1e6); 
+  printf("Same keys: %s\n\n", checksums[0] == checksums[2] && checksums[1] == checksums[2] ? "true" : "false"); 
+
+  top_k_free(&singles); 
+  top_k_free(&batched); 
+  max_heap_free(&drained); 
+  free(stream); 
+  free(result); 
+}
+
+void run_benchmarks() {
+  bench_push_pop(); 
+  bench_build_heap(); 
+  bench_mixed(); 
+  bench_top_k(); 
+}
+
 int main() {
   run_tests();
+
+  if (RUN_BENCHMARKS) run_benchmarks(); 
+
   return 0;
 }
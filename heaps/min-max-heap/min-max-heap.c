@@ -0,0 +1,678 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#define LENGTH(arr, dt) (sizeof(arr) / sizeof(dt))
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: Only the index helpers come from heaps/heap.h - A min-max heap is always binary so they're called with an arity of 2
+//  NOTE: Even levels (root = level 0) are min levels, odd levels are max levels
+
+#include "../heap.h"
+
+#define MIN_MAX_ARITY 2
+
+typedef struct {
+  size_t size;
+  size_t capacity;
+  uint16_t* heap;
+} MinMaxHeap;
+
+MinMaxHeap min_max_heap_initialize();
+void min_max_heap_free(MinMaxHeap* heap);
+bool min_max_heap_reserve(MinMaxHeap* heap, size_t capacity);
+MinMaxHeap min_max_heap_build(const uint16_t* data, size_t n);
+bool min_max_heap_insert(MinMaxHeap* heap, uint16_t data);
+int32_t peek_min(MinMaxHeap* heap);
+int32_t peek_max(MinMaxHeap* heap);
+int32_t extract_min(MinMaxHeap* heap);
+int32_t extract_max(MinMaxHeap* heap);
+void print_heap(MinMaxHeap* heap);
+
+/**
+ * =====================
+ * || Level helpers   ||
+ * =====================
+ */
+
+/**
+ * Check if a node sits on a min level
+ * The level of idx is floor(log2(idx + 1)) which is the index of the highest set bit of idx + 1
+ *
+ * @param: idx -> The index of the node
+ * @returns: true if the node is on an even (min) level
+ */
+
+static inline bool is_min_level(size_t idx) {
+  return ((63 - __builtin_clzll((unsigned long long) idx + 1)) & 1) == 0;
+}
+
+/**
+ * Compare two values with the ordering of a level - Smaller wins on a min level, larger wins on a max level
+ *
+ * @param: a -> The value that might belong higher
+ * @param: b -> The value to compare against
+ * @param: min_level -> The ordering to use
+ * @returns: true if a belongs above b
+ */
+
+static inline bool level_higher(uint16_t a, uint16_t b, bool min_level) {
+  return min_level ? a < b : a > b;
+}
+
+/**
+ * =====================
+ * || Program methods ||
+ * =====================
+ */
+
+MinMaxHeap min_max_heap_initialize() {
+  MinMaxHeap heap;
+  heap.heap = (uint16_t*) malloc(sizeof(uint16_t) * INITIAL_HEAP_CAPACITY);
+
+  if (heap.heap == NULL) {
+    DEBUG_PRINT("Error Allocating memory for the heap\n\n", NULL);
+    exit(EXIT_FAILURE);
+  }
+
+  heap.size = 0;
+  heap.capacity = INITIAL_HEAP_CAPACITY;
+
+  return heap;
+}
+
+void min_max_heap_free(MinMaxHeap* heap) {
+  if (heap == NULL) return;
+
+  free(heap->heap);
+  heap->heap = NULL;
+  heap->size = 0;
+  heap->capacity = 0;
+}
+
+/**
+ * Grow the heap so it holds at least capacity values
+ *
+ * @param: heap -> The heap to grow
+ * @param: capacity -> The number of values the heap should fit
+ * @returns: false if the memory could not be allocated
+ */
+
+bool min_max_heap_reserve(MinMaxHeap* heap, size_t capacity) {
+  if (heap == NULL) return false;
+  if (capacity <= heap->capacity) return true;
+  if (capacity > SIZE_MAX / sizeof(uint16_t)) return false;
+
+  uint16_t* resized = (uint16_t*) realloc(heap->heap, sizeof(uint16_t) * capacity);
+
+  if (resized == NULL) {
+    DEBUG_PRINT("Error reallocating the heap to %zu slots\n", capacity);
+    return false;
+  }
+
+  heap->heap = resized;
+  heap->capacity = capacity;
+
+  return true;
+}
+
+/**
+ * Make room for one more value - Grows by HEAP_GROWTH_FACTOR from at least INITIAL_HEAP_CAPACITY so a freed heap
+ * (capacity 0) can be inserted into again
+ *
+ * @param: heap -> The heap to grow
+ * @returns: false if the memory could not be allocated
+ */
+
+static inline bool min_max_heap_make_room(MinMaxHeap* heap) {
+  if (heap->size < heap->capacity) return true;
+  if (heap->size == SIZE_MAX) return false;
+
+  size_t needed = heap->size + 1;
+  size_t capacity = heap->capacity < INITIAL_HEAP_CAPACITY ? INITIAL_HEAP_CAPACITY : heap->capacity;
+
+  while (capacity < needed) {
+    if (capacity > SIZE_MAX / HEAP_GROWTH_FACTOR) {
+      capacity = needed;
+      break;
+    }
+
+    capacity *= HEAP_GROWTH_FACTOR;
+  }
+
+  return min_max_heap_reserve(heap, capacity);
+}
+
+/**
+ * Move the value at idx up through the grandparents on its own kind of level
+ * A value only ever has to be compared with its grandparent as the parent is on the opposite kind of level
+ *
+ * @param: heap -> The heap to sift in
+ * @param: idx -> The index of the value to move
+ * @param: min_level -> The kind of level the value is moving through
+ */
+
+static void push_up_levels(MinMaxHeap* heap, size_t idx, bool min_level) {
+  uint16_t* h = heap->heap;
+  uint16_t current = h[idx];
+
+  while (idx > 2) {
+    size_t g_idx = heap_parent_idx(heap_parent_idx(idx, MIN_MAX_ARITY), MIN_MAX_ARITY);
+
+    if (!level_higher(current, h[g_idx], min_level)) break;
+
+    h[idx] = h[g_idx];
+    idx = g_idx;
+  }
+
+  h[idx] = current;
+}
+
+/**
+ * Sift a newly placed value up
+ * First decide whether it belongs on min or max levels by comparing it with its parent, then push it up the grandparents
+ *
+ * @param: heap -> The heap to sift in
+ * @param: idx -> The index of the new value
+ */
+
+static void push_up(MinMaxHeap* heap, size_t idx) {
+  int64_t p_idx = heap_parent_idx(idx, MIN_MAX_ARITY);
+  bool min_level = is_min_level(idx);
+
+  if (p_idx == -1) return;
+
+  uint16_t* h = heap->heap;
+
+  // On a min level but bigger than the max parent (or the other way round) so it belongs on the parents levels
+  if (level_higher(h[p_idx], h[idx], min_level)) {
+    uint16_t temp = h[idx];
+    h[idx] = h[p_idx];
+    h[p_idx] = temp;
+    push_up_levels(heap, p_idx, !min_level);
+    return;
+  }
+
+  push_up_levels(heap, idx, min_level);
+}
+
+/**
+ * Sift the value at idx down
+ * The value is compared with the highest of its children and grandchildren (smallest on a min level, largest on a max level)
+ * When that is a grandchild the value may now be on the wrong side of the grandchild's parent so they are swapped and it carries on down
+ *
+ * @param: heap -> The heap to sift in
+ * @param: idx -> The index of the value to move
+ */
+
+static void trickle_down(MinMaxHeap* heap, size_t idx) {
+  uint16_t* h = heap->heap;
+  bool min_level = is_min_level(idx);
+
+  while (true) {
+    int64_t first_idx = heap_first_child_idx(idx, heap->size, MIN_MAX_ARITY);
+
+    if (first_idx == -1) return;
+
+    size_t last_idx = heap_last_child_idx(idx, heap->size, MIN_MAX_ARITY);
+    size_t highest_idx = first_idx;
+
+    for (size_t c_idx = first_idx; c_idx <= last_idx; c_idx++) {
+      if (level_higher(h[c_idx], h[highest_idx], min_level)) highest_idx = c_idx;
+
+      int64_t g_first = heap_first_child_idx(c_idx, heap->size, MIN_MAX_ARITY);
+
+      if (g_first == -1) continue;
+
+      size_t g_last = heap_last_child_idx(c_idx, heap->size, MIN_MAX_ARITY);
+
+      for (size_t g_idx = g_first; g_idx <= g_last; g_idx++) {
+        if (level_higher(h[g_idx], h[highest_idx], min_level)) highest_idx = g_idx;
+      }
+    }
+
+    // Every grandchild index is after the last child
+    bool is_grandchild = highest_idx > last_idx;
+
+    if (!level_higher(h[highest_idx], h[idx], min_level)) return;
+
+    uint16_t temp = h[idx];
+    h[idx] = h[highest_idx];
+    h[highest_idx] = temp;
+
+    if (!is_grandchild) return;
+
+    size_t p_idx = heap_parent_idx(highest_idx, MIN_MAX_ARITY);
+
+    if (level_higher(h[p_idx], h[highest_idx], min_level)) {
+      temp = h[p_idx];
+      h[p_idx] = h[highest_idx];
+      h[highest_idx] = temp;
+    }
+
+    idx = highest_idx;
+  }
+}
+
+/**
+ * Build a min-max heap from an array in O(n) - Same idea as Floyd's build for the plain heaps
+ * Every parent from the last one back to the root is trickled down
+ *
+ * @param: data -> The values to copy in
+ * @param: n -> The number of values
+ * @returns: The built heap
+ */
+
+MinMaxHeap min_max_heap_build(const uint16_t* data, size_t n) {
+  MinMaxHeap heap = min_max_heap_initialize();
+
+  if (data == NULL || n == 0) return heap;
+
+  if (!min_max_heap_reserve(&heap, n)) {
+    DEBUG_PRINT("Error: Could not allocate a heap for %zu nodes\n", n);
+    return heap;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    heap.heap[i] = data[i];
+  }
+
+  heap.size = n;
+
+  for (size_t i = n / 2; i > 0; i--) {
+    trickle_down(&heap, i - 1);
+  }
+
+  return heap;
+}
+
+/**
+ * Insert a value O(log n)
+ *
+ * @param: heap -> The heap to insert into
+ * @param: data -> The value to insert
+ * @returns: false if the heap could not grow
+ */
+
+bool min_max_heap_insert(MinMaxHeap* heap, uint16_t data) {
+  if (heap == NULL) return false;
+
+  if (!min_max_heap_make_room(heap)) {
+    DEBUG_PRINT("Error: Cannot add another element as the heap could not grow\n\n", NULL);
+    return false;
+  }
+
+  heap->heap[heap->size] = data;
+  heap->size += 1;
+
+  push_up(heap, heap->size - 1);
+
+  return true;
+}
+
+/**
+ * Find the index of the max value - It's one of the roots two children (or the root itself if it has none)
+ *
+ * @param: heap -> The heap to look in
+ * @returns: The index of the max value, only valid when the heap is not empty
+ */
+
+static size_t max_idx(MinMaxHeap* heap) {
+  if (heap->size == 1) return 0;
+  if (heap->size == 2) return 1;
+
+  return heap->heap[1] >= heap->heap[2] ? 1 : 2;
+}
+
+/**
+ * Remove the value at idx by moving the last value into its place and trickling it down
+ * Only used for the min (root) and max positions where the last value can never need to move up
+ *
+ * @param: heap -> The heap to remove from
+ * @param: idx -> The index to remove
+ * @returns: The removed value
+ */
+
+static uint16_t remove_at(MinMaxHeap* heap, size_t idx) {
+  uint16_t data = heap->heap[idx];
+
+  heap->size -= 1;
+
+  if (idx < heap->size) {
+    heap->heap[idx] = heap->heap[heap->size];
+    trickle_down(heap, idx);
+  }
+
+  return data;
+}
+
+int32_t peek_min(MinMaxHeap* heap) {
+  if (heap == NULL || heap->size == 0) return -1;
+
+  return heap->heap[0];
+}
+
+int32_t peek_max(MinMaxHeap* heap) {
+  if (heap == NULL || heap->size == 0) return -1;
+
+  return heap->heap[max_idx(heap)];
+}
+
+/**
+ * Extract the min value O(log n)
+ *
+ * @param: heap -> The heap to extract from
+ * @returns: The min value or -1 if the heap is empty
+ */
+
+int32_t extract_min(MinMaxHeap* heap) {
+  if (heap == NULL || heap->size == 0) {
+    DEBUG_PRINT("Trying to extract from the heap when there are no nodes\n", NULL);
+    return -1;
+  }
+
+  return remove_at(heap, 0);
+}
+
+/**
+ * Extract the max value O(log n)
+ *
+ * @param: heap -> The heap to extract from
+ * @returns: The max value or -1 if the heap is empty
+ */
+
+int32_t extract_max(MinMaxHeap* heap) {
+  if (heap == NULL || heap->size == 0) {
+    DEBUG_PRINT("Trying to extract from the heap when there are no nodes\n", NULL);
+    return -1;
+  }
+
+  return remove_at(heap, max_idx(heap));
+}
+
+void print_heap(MinMaxHeap* heap) {
+
+  if (heap == NULL || heap->size == 0) {
+    printf("No heap to print\n");
+    return;
+  }
+
+  printf("[");
+
+  for (size_t i = 0; i < heap->size; i++) {
+    printf("%u, ", heap->heap[i]);
+  }
+
+  printf("]\n");
+}
+
+/**
+ * ===========
+ * || Tests ||
+ * ===========
+ */
+
+/**
+ * Walk every node and check it against its descendants' levels - A min level node must be <= every descendant, a max level node >=
+ * Checking the children and grandchildren of every node is enough as the property chains down
+ */
+
+bool is_valid(MinMaxHeap* heap) {
+  for (size_t idx = 0; idx < heap->size; idx++) {
+    bool min_level = is_min_level(idx);
+    int64_t first_idx = heap_first_child_idx(idx, heap->size, MIN_MAX_ARITY);
+
+    if (first_idx == -1) continue;
+
+    size_t last_idx = heap_last_child_idx(idx, heap->size, MIN_MAX_ARITY);
+
+    for (size_t c_idx = first_idx; c_idx <= last_idx; c_idx++) {
+      if (level_higher(heap->heap[c_idx], heap->heap[idx], min_level)) return false;
+
+      int64_t g_first = heap_first_child_idx(c_idx, heap->size, MIN_MAX_ARITY);
+
+      if (g_first == -1) continue;
+
+      size_t g_last = heap_last_child_idx(c_idx, heap->size, MIN_MAX_ARITY);
+
+      for (size_t g_idx = g_first; g_idx <= g_last; g_idx++) {
+        if (level_higher(heap->heap[g_idx], heap->heap[idx], min_level)) return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+void test_insertion(MinMaxHeap* heap) {
+  printf("==================\n");
+  printf("|| Insertion    ||\n");
+  printf("==================\n\n");
+
+  int nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64 };
+
+  for (size_t i = 0; i < LENGTH(nums, int); i++) {
+    printf("Adding node: %d\n", nums[i]);
+    min_max_heap_insert(heap, nums[i]);
+    print_heap(heap);
+  }
+
+  printf("Valid: %s\n\n", is_valid(heap) ? "true" : "false");
+}
+
+void test_peek(MinMaxHeap* heap) {
+  printf("==================\n");
+  printf("|| Peek         ||\n");
+  printf("==================\n\n");
+
+  printf("Min: %d\n", peek_min(heap));
+  printf("Max: %d\n\n", peek_max(heap));
+}
+
+void test_extract(MinMaxHeap* heap) {
+  printf("==================\n");
+  printf("|| Extract      ||\n");
+  printf("==================\n\n");
+
+  while (heap->size > 0) {
+    printf("Extracted min: %d", extract_min(heap));
+    if (heap->size > 0) printf(", max: %d", extract_max(heap));
+    printf("\n");
+    print_heap(heap);
+  }
+
+  printf("\n");
+}
+
+void test_build_heap() {
+  printf("==================\n");
+  printf("|| Build Heap   ||\n");
+  printf("==================\n\n");
+
+  uint16_t nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64 };
+  MinMaxHeap heap = min_max_heap_build(nums, LENGTH(nums, uint16_t));
+
+  print_heap(&heap);
+  printf("Valid: %s\n", is_valid(&heap) ? "true" : "false");
+
+  printf("Drained from the max end: ");
+  while (heap.size > 0) {
+    printf("%d, ", extract_max(&heap));
+  }
+
+  printf("\n\n");
+
+  min_max_heap_free(&heap);
+}
+
+// Keep the largest WINDOW values seen - When the heap is full drop the min, the max end is still there to read at any point
+
+void test_bounded_window() {
+  printf("==================\n");
+  printf("|| Bounded      ||\n");
+  printf("==================\n\n");
+
+  size_t window = 1000;
+  MinMaxHeap heap = min_max_heap_initialize();
+  uint32_t seed = 12345;
+  bool valid = true;
+
+  min_max_heap_reserve(&heap, window + 1);
+
+  for (size_t i = 0; i < 100000; i++) {
+    seed = seed * 1103515245 + 12345;
+    min_max_heap_insert(&heap, (uint16_t) (seed >> 16));
+
+    if (heap.size > window) extract_min(&heap);
+    if (i % 10000 == 0 && !is_valid(&heap)) valid = false;
+  }
+
+  int32_t prev = extract_min(&heap);
+  bool ordered = true;
+
+  while (heap.size > 0) {
+    int32_t current = extract_min(&heap);
+    if (current < prev) ordered = false;
+    prev = current;
+  }
+
+  printf("Valid throughout: %s\n", valid ? "true" : "false");
+  printf("Drained in order: %s\n\n", ordered ? "true" : "false");
+
+  min_max_heap_free(&heap);
+}
+
+void test_insert_after_free() {
+  printf("==================\n");
+  printf("|| After Free   ||\n");
+  printf("==================\n\n");
+
+  MinMaxHeap heap = min_max_heap_initialize();
+  min_max_heap_free(&heap);
+
+  bool inserted = true;
+  for (uint16_t i = 0; i < 100; i++) {
+    if (!min_max_heap_insert(&heap, i)) inserted = false;
+  }
+
+  printf("Insert after free: %s\n", inserted ? "true" : "false");
+  printf("Min: %d, Max: %d, Valid: %s\n\n", peek_min(&heap), peek_max(&heap), is_valid(&heap) ? "true" : "false");
+
+  min_max_heap_free(&heap);
+}
+
+void run_tests() {
+  MinMaxHeap heap = min_max_heap_initialize();
+
+  test_insertion(&heap);
+
+  test_peek(&heap);
+
+  test_extract(&heap);
+
+  min_max_heap_free(&heap);
+
+  test_build_heap();
+
+  test_bounded_window();
+
+  test_insert_after_free();
+
+}
+
+/**
+ * ================
+ * || Benchmarks ||
+ * ================
+ */
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+void bench_push_pop() {
+  printf("==================\n");
+  printf("|| Push/ Pop    ||\n");
+  printf("==================\n\n");
+
+  MinMaxHeap heap = min_max_heap_initialize();
+  struct timespec start, end;
+  uint32_t seed = 12345;
+  uint64_t checksum = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    seed = seed * 1103515245 + 12345;
+    min_max_heap_insert(&heap, (uint16_t) (seed >> 16));
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double push_time = elapsed_seconds(start, end);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  // Alternate ends so both extract paths are timed
+  while (heap.size > 0) {
+    checksum += extract_min(&heap);
+    if (heap.size > 0) checksum += extract_max(&heap);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double pop_time = elapsed_seconds(start, end);
+
+  printf("%d pushes: %.2f Mops/s\n", BENCHMARK_SIZE, BENCHMARK_SIZE / push_time / 1e6);
+  printf("%d pops:   %.2f Mops/s\n", BENCHMARK_SIZE, BENCHMARK_SIZE / pop_time / 1e6);
+  printf("Heap memory: %zu bytes per value (checksum %lu)\n\n", sizeof(uint16_t), (unsigned long) checksum);
+
+  min_max_heap_free(&heap);
+}
+
+void bench_build_heap() {
+  printf("==================\n");
+  printf("|| Build Heap   ||\n");
+  printf("==================\n\n");
+
+  uint16_t* data = (uint16_t*) malloc(sizeof(uint16_t) * BENCHMARK_SIZE);
+  struct timespec start, end;
+  uint32_t seed = 12345;
+
+  if (data == NULL) return;
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = (uint16_t) (seed >> 16);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  MinMaxHeap built = min_max_heap_build(data, BENCHMARK_SIZE);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  printf("build of %d values: %.2f ms (min %d, max %d)\n\n", BENCHMARK_SIZE, elapsed_seconds(start, end) * 1e3, peek_min(&built), peek_max(&built));
+
+  min_max_heap_free(&built);
+  free(data);
+}
+
+void run_benchmarks() {
+  bench_push_pop();
+  bench_build_heap();
+}
+
+int main() {
+  run_tests();
+
+  if (RUN_BENCHMARKS) run_benchmarks();
+
+  return 0;
+}
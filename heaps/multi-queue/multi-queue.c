@@ -0,0 +1,489 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+
+#define LENGTH(arr, dt) (sizeof(arr) / sizeof(dt))
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: Compile with -pthread - gcc -O2 -pthread -o multi-queue multi-queue.c
+//  NOTE: A relaxed concurrent max priority queue - Lots of small MaxHeaps each behind their own lock
+
+// Heaps per thread - More heaps means fewer lock collisions but pops stray further from the true max
+#define QUEUES_PER_THREAD 2
+
+#define CACHE_LINE 64
+
+// A pop that finds both sampled heaps empty tries again this many times before scanning every heap
+#define EMPTY_RETRIES 8
+
+#define MAX_THREADS 64
+
+#include "../heap.h"
+
+#define MAX_HEAP_HIGHER(a, b) ((a) > (b))
+
+DEFINE_HEAP(MaxHeap, max_heap, uint16_t, MAX_HEAP_HIGHER)
+
+#define EMPTY_TOP -1
+
+/**
+ * One heap of the MultiQueue
+ * top is a copy of the heap's max (EMPTY_TOP when empty) that is only written under the lock but can be read without it,
+ * so a pop can compare two heaps without locking either. Each queue sits on its own cache lines so locking one doesn't
+ * bounce the line holding its neighbour
+ */
+
+typedef struct {
+  pthread_mutex_t lock;
+  _Atomic int32_t top;
+  MaxHeap heap;
+} __attribute__((aligned(CACHE_LINE))) LockedQueue;
+
+/**
+ * The MultiQueue (Rihani, Sanders and Dementiev) - QUEUES_PER_THREAD * threads heaps
+ *
+ * - Push puts the value in a random heap
+ * - Pop samples two random heaps and takes from the one with the bigger top
+ *
+ * Relaxation: a pop isn't guaranteed to return the max, but the rank of what it returns (how many bigger values are
+ * still queued) is O(queue_count) on average and O(queue_count log queue_count) with high probability, and it doesn't
+ * grow with the number of values. A value can't be skipped forever - the heap it is in will keep getting sampled
+ * Emptiness: a pop only returns -1 after a full scan saw every heap empty
+ */
+
+typedef struct {
+  size_t queue_count;
+  LockedQueue* queues;
+} MultiQueue;
+
+// The global lock baseline - One MaxHeap behind one mutex
+
+typedef struct {
+  pthread_mutex_t lock;
+  MaxHeap heap;
+} MutexHeap;
+
+MultiQueue multi_queue_initialize(size_t threads);
+void multi_queue_free(MultiQueue* queue);
+void multi_queue_push(MultiQueue* queue, uint16_t data, uint64_t* rng);
+int32_t multi_queue_pop(MultiQueue* queue, uint64_t* rng);
+
+/**
+ * =====================
+ * || Program methods ||
+ * =====================
+ */
+
+// xorshift64 - Each thread keeps its own state so picking a heap never touches shared memory
+
+static inline uint64_t next_random(uint64_t* state) {
+  uint64_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+
+  return x;
+}
+
+MultiQueue multi_queue_initialize(size_t threads) {
+  MultiQueue queue;
+
+  if (threads == 0) threads = 1;
+
+  queue.queue_count = threads * QUEUES_PER_THREAD;
+  queue.queues = (LockedQueue*) aligned_alloc(CACHE_LINE, sizeof(LockedQueue) * queue.queue_count);
+
+  if (queue.queues == NULL) {
+    DEBUG_PRINT("Error Allocating memory for the multi queue\n\n", NULL);
+    exit(EXIT_FAILURE);
+  }
+
+  for (size_t i = 0; i < queue.queue_count; i++) {
+    pthread_mutex_init(&queue.queues[i].lock, NULL);
+    atomic_init(&queue.queues[i].top, EMPTY_TOP);
+    queue.queues[i].heap = max_heap_initialize();
+  }
+
+  return queue;
+}
+
+void multi_queue_free(MultiQueue* queue) {
+  if (queue == NULL || queue->queues == NULL) return;
+
+  for (size_t i = 0; i < queue->queue_count; i++) {
+    pthread_mutex_destroy(&queue->queues[i].lock);
+    max_heap_free(&queue->queues[i].heap);
+  }
+
+  free(queue->queues);
+  queue->queues = NULL;
+  queue->queue_count = 0;
+}
+
+// Refresh the cached top after the heap changed - Caller holds the lock
+
+static inline void publish_top(LockedQueue* q) {
+  int32_t top = q->heap.size > 0 ? q->heap.heap[0].data : EMPTY_TOP;
+  atomic_store_explicit(&q->top, top, memory_order_relaxed);
+}
+
+/**
+ * Push a value into a random heap - If its lock is taken try another rather than wait
+ *
+ * @param: queue -> The queue to push to
+ * @param: data -> The value to push
+ * @param: rng -> The calling thread's random state
+ */
+
+void multi_queue_push(MultiQueue* queue, uint16_t data, uint64_t* rng) {
+  while (true) {
+    LockedQueue* q = &queue->queues[next_random(rng) % queue->queue_count];
+
+    if (pthread_mutex_trylock(&q->lock) != 0) continue;
+
+    max_heap_insert(&q->heap, data);
+    publish_top(q);
+
+    pthread_mutex_unlock(&q->lock);
+    return;
+  }
+}
+
+/**
+ * Pop with every heap checked in turn - Only used once sampling keeps finding empty heaps
+ * Blocks on each lock so an empty result really means every heap was seen empty
+ */
+
+static int32_t pop_scan(MultiQueue* queue) {
+  for (size_t i = 0; i < queue->queue_count; i++) {
+    LockedQueue* q = &queue->queues[i];
+
+    if (atomic_load_explicit(&q->top, memory_order_relaxed) == EMPTY_TOP) continue;
+
+    pthread_mutex_lock(&q->lock);
+
+    uint16_t data;
+    bool found = q->heap.size > 0 && max_heap_extract(&q->heap, &data);
+    publish_top(q);
+
+    pthread_mutex_unlock(&q->lock);
+
+    if (found) return data;
+  }
+
+  // The cached tops can lag behind a push in flight so check each heap under its lock before saying empty
+  for (size_t i = 0; i < queue->queue_count; i++) {
+    LockedQueue* q = &queue->queues[i];
+
+    pthread_mutex_lock(&q->lock);
+
+    uint16_t data;
+    bool found = q->heap.size > 0 && max_heap_extract(&q->heap, &data);
+    publish_top(q);
+
+    pthread_mutex_unlock(&q->lock);
+
+    if (found) return data;
+  }
+
+  return -1;
+}
+
+/**
+ * Pop a value close to the max - Compare the cached tops of two random heaps and pop from the bigger
+ * If the chosen heap is locked or turned out to be empty, sample again
+ *
+ * @param: queue -> The queue to pop from
+ * @param: rng -> The calling thread's random state
+ * @returns: The popped value or -1 if every heap was empty
+ */
+
+int32_t multi_queue_pop(MultiQueue* queue, uint64_t* rng) {
+  size_t empty = 0;
+
+  while (empty < EMPTY_RETRIES) {
+    LockedQueue* a = &queue->queues[next_random(rng) % queue->queue_count];
+    LockedQueue* b = &queue->queues[next_random(rng) % queue->queue_count];
+
+    int32_t a_top = atomic_load_explicit(&a->top, memory_order_relaxed);
+    int32_t b_top = atomic_load_explicit(&b->top, memory_order_relaxed);
+
+    LockedQueue* q = a_top >= b_top ? a : b;
+
+    if (a_top == EMPTY_TOP && b_top == EMPTY_TOP) {
+      empty += 1;
+      continue;
+    }
+
+    if (pthread_mutex_trylock(&q->lock) != 0) continue;
+
+    uint16_t data;
+    bool found = q->heap.size > 0 && max_heap_extract(&q->heap, &data);
+    publish_top(q);
+
+    pthread_mutex_unlock(&q->lock);
+
+    if (found) return data;
+
+    empty += 1;
+  }
+
+  return pop_scan(queue);
+}
+
+/**
+ * ===========
+ * || Tests ||
+ * ===========
+ */
+
+// Single threaded: every value pushed comes back out once, and the pops are close to the max (mean rank error)
+
+void test_rank_error() {
+  printf("==================\n");
+  printf("|| Rank Error   ||\n");
+  printf("==================\n\n");
+
+  size_t threads = 4;
+  size_t n = 100000;
+  size_t pops = 1000;
+  MultiQueue queue = multi_queue_initialize(threads);
+  uint32_t* counts = (uint32_t*) calloc(UINT16_MAX + 1, sizeof(uint32_t));
+  uint64_t rng = 88172645463325252ULL;
+  uint32_t seed = 12345;
+  uint64_t total_rank = 0;
+  size_t worst_rank = 0;
+
+  if (counts == NULL) return;
+
+  for (size_t i = 0; i < n; i++) {
+    seed = seed * 1103515245 + 12345;
+    uint16_t value = (uint16_t) (seed >> 16);
+    multi_queue_push(&queue, value, &rng);
+    counts[value] += 1;
+  }
+
+  // The rank of a pop is how many queued values were strictly bigger than it
+  for (size_t i = 0; i < pops; i++) {
+    int32_t value = multi_queue_pop(&queue, &rng);
+    size_t rank = 0;
+
+    for (uint32_t key = value + 1; key <= UINT16_MAX; key++) rank += counts[key];
+
+    counts[value] -= 1;
+    total_rank += rank;
+    if (rank > worst_rank) worst_rank = rank;
+  }
+
+  size_t remaining = 0;
+  bool matched = true;
+
+  while (true) {
+    int32_t value = multi_queue_pop(&queue, &rng);
+
+    if (value == -1) break;
+    if (counts[value] == 0) matched = false; else counts[value] -= 1;
+
+    remaining += 1;
+  }
+
+  printf("%zu heaps, mean rank error over %zu pops: %.2f, worst: %zu\n", queue.queue_count, pops, (double) total_rank / pops, worst_rank);
+  printf("Every value came out once: %s\n\n", matched && remaining == n - pops ? "true" : "false");
+
+  free(counts);
+  multi_queue_free(&queue);
+}
+
+typedef struct {
+  MultiQueue* queue;
+  size_t pushes;
+  uint64_t sum;
+  uint64_t seed;
+} ProducerArgs;
+
+void* producer(void* arg) {
+  ProducerArgs* args = (ProducerArgs*) arg;
+  uint64_t rng = args->seed;
+
+  for (size_t i = 0; i < args->pushes; i++) {
+    uint16_t value = (uint16_t) next_random(&rng);
+    multi_queue_push(args->queue, value, &rng);
+    args->sum += value;
+  }
+
+  return NULL;
+}
+
+// Several threads push at once, then everything is drained - the sums have to match
+
+void test_concurrent_push() {
+  printf("==================\n");
+  printf("|| Concurrent   ||\n");
+  printf("==================\n\n");
+
+  size_t threads = 8;
+  MultiQueue queue = multi_queue_initialize(threads);
+  pthread_t ids[8];
+  ProducerArgs args[8];
+  uint64_t pushed = 0, popped = 0;
+  uint64_t rng = 12345;
+
+  for (size_t t = 0; t < threads; t++) {
+    args[t] = (ProducerArgs) { .queue = &queue, .pushes = 10000, .sum = 0, .seed = 0x9E3779B97F4A7C15ULL * (t + 1) };
+    pthread_create(&ids[t], NULL, producer, &args[t]);
+  }
+
+  for (size_t t = 0; t < threads; t++) {
+    pthread_join(ids[t], NULL);
+    pushed += args[t].sum;
+  }
+
+  int32_t value;
+
+  while ((value = multi_queue_pop(&queue, &rng)) != -1) popped += value;
+
+  printf("Pushed and popped the same values: %s\n\n", pushed == popped ? "true" : "false");
+
+  multi_queue_free(&queue);
+}
+
+void run_tests() {
+  test_rank_error();
+
+  test_concurrent_push();
+
+}
+
+/**
+ * ================
+ * || Benchmarks ||
+ * ================
+ */
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+typedef struct {
+  MultiQueue* multi;
+  MutexHeap* mutex;
+  size_t ops;
+  uint64_t seed;
+  uint64_t checksum;
+} WorkerArgs;
+
+// Scheduler style: each op pops a task and pushes a new one
+
+void* multi_worker(void* arg) {
+  WorkerArgs* args = (WorkerArgs*) arg;
+  uint64_t rng = args->seed;
+
+  for (size_t i = 0; i < args->ops; i++) {
+    int32_t value = multi_queue_pop(args->multi, &rng);
+    if (value != -1) args->checksum += value;
+    multi_queue_push(args->multi, (uint16_t) next_random(&rng), &rng);
+  }
+
+  return NULL;
+}
+
+void* mutex_worker(void* arg) {
+  WorkerArgs* args = (WorkerArgs*) arg;
+  uint64_t rng = args->seed;
+
+  for (size_t i = 0; i < args->ops; i++) {
+    uint16_t value;
+    uint16_t next = (uint16_t) next_random(&rng);
+
+    pthread_mutex_lock(&args->mutex->lock);
+    if (max_heap_extract(&args->mutex->heap, &value)) args->checksum += value;
+    max_heap_insert(&args->mutex->heap, next);
+    pthread_mutex_unlock(&args->mutex->lock);
+  }
+
+  return NULL;
+}
+
+// Run threads workers over a queue prefilled with BENCHMARK_SIZE values and return the pop + push pairs per second
+
+double run_workers(size_t threads, bool use_multi) {
+  pthread_t ids[MAX_THREADS];
+  WorkerArgs args[MAX_THREADS];
+  MultiQueue multi = multi_queue_initialize(threads);
+  MutexHeap mutex;
+  struct timespec start, end;
+  uint64_t rng = 12345;
+
+  pthread_mutex_init(&mutex.lock, NULL);
+  mutex.heap = max_heap_initialize();
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    uint16_t value = (uint16_t) next_random(&rng);
+    if (use_multi) multi_queue_push(&multi, value, &rng); else max_heap_insert(&mutex.heap, value);
+  }
+
+  size_t ops = BENCHMARK_SIZE / threads;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (size_t t = 0; t < threads; t++) {
+    args[t] = (WorkerArgs) { .multi = &multi, .mutex = &mutex, .ops = ops, .seed = 0x9E3779B97F4A7C15ULL * (t + 1), .checksum = 0 };
+    pthread_create(&ids[t], NULL, use_multi ? multi_worker : mutex_worker, &args[t]);
+  }
+
+  for (size_t t = 0; t < threads; t++) pthread_join(ids[t], NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  multi_queue_free(&multi);
+  max_heap_free(&mutex.heap);
+  pthread_mutex_destroy(&mutex.lock);
+
+  return ops * threads / elapsed_seconds(start, end) / 1e6;
+}
+
+void bench_scaling() {
+  printf("==================\n");
+  printf("|| Scaling      ||\n");
+  printf("==================\n\n");
+
+  size_t thread_counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+  printf("%d pop + push pairs split over the threads (Mops/s)\n", BENCHMARK_SIZE);
+  printf("Threads | MultiQueue | Mutex MaxHeap\n");
+
+  for (size_t i = 0; i < LENGTH(thread_counts, size_t); i++) {
+    size_t threads = thread_counts[i];
+    double multi = run_workers(threads, true);
+    double mutex = run_workers(threads, false);
+
+    printf("%7zu | %10.2f | %13.2f\n", threads, multi, mutex);
+  }
+
+  printf("\n");
+}
+
+void run_benchmarks() {
+  bench_scaling();
+}
+
+int main() {
+  run_tests();
+
+  if (RUN_BENCHMARKS) run_benchmarks();
+
+  return 0;
+}
@@ -0,0 +1,635 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#define LENGTH(arr, dt) (sizeof(arr) / sizeof(dt))
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+// Nodes are carved out of chunks this big, a chunk is only returned to malloc when the pool is freed
+#define POOL_CHUNK_SIZE 4096
+
+//  NOTE: The MinHeap is only here to benchmark against, the IndexedMinHeap (which has decrease key) to test against
+
+#include "../heap.h"
+
+#define MIN_HEAP_HIGHER(a, b) ((a) < (b))
+
+DEFINE_HEAP(MinHeap, min_heap, uint16_t, MIN_HEAP_HIGHER)
+DEFINE_INDEXED_HEAP(IndexedMinHeap, indexed_min_heap, uint16_t, MIN_HEAP_HIGHER)
+
+/**
+ * A pairing heap node - A node keeps its left most child and the next sibling to its right
+ * prev is the left sibling, or the parent for a left most child - decrease_key needs it to cut the node out in O(1)
+ */
+
+typedef struct PairingNode {
+  uint16_t data;
+  struct PairingNode* child;
+  struct PairingNode* sibling;
+  struct PairingNode* prev;
+} PairingNode;
+
+typedef struct PoolChunk {
+  struct PoolChunk* next;
+  PairingNode nodes[POOL_CHUNK_SIZE];
+} PoolChunk;
+
+/**
+ * A pool of nodes shared by any number of heaps
+ * Freed nodes go on a free list (threaded through sibling) and are handed out again before a new chunk is carved up
+ * Heaps that get melded together must share a pool
+ */
+
+typedef struct {
+  PoolChunk* chunks;
+  size_t chunk_used;
+  PairingNode* free_list;
+} NodePool;
+
+typedef struct {
+  size_t size;
+  PairingNode* root;
+  NodePool* pool;
+} PairingHeap;
+
+NodePool pool_initialize();
+void pool_free(NodePool* pool);
+PairingHeap pairing_heap_initialize(NodePool* pool);
+void pairing_heap_free(PairingHeap* heap);
+PairingNode* pairing_heap_insert(PairingHeap* heap, uint16_t data);
+int32_t peek_min(PairingHeap* heap);
+int32_t extract_min(PairingHeap* heap);
+bool decrease_key(PairingHeap* heap, PairingNode* node, uint16_t data);
+bool meld(PairingHeap* into, PairingHeap* from);
+
+/**
+ * =====================
+ * || Node Pool       ||
+ * =====================
+ */
+
+NodePool pool_initialize() {
+  NodePool pool = { .chunks = NULL, .chunk_used = POOL_CHUNK_SIZE, .free_list = NULL };
+
+  return pool;
+}
+
+void pool_free(NodePool* pool) {
+  if (pool == NULL) return;
+
+  PoolChunk* chunk = pool->chunks;
+
+  while (chunk != NULL) {
+    PoolChunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+
+  pool->chunks = NULL;
+  pool->chunk_used = POOL_CHUNK_SIZE;
+  pool->free_list = NULL;
+}
+
+/**
+ * Get a node from the pool - The free list first, then the current chunk, then a new chunk
+ *
+ * @param: pool -> The pool to take from
+ * @returns: An uninitialised node or NULL if a new chunk could not be allocated
+ */
+
+static PairingNode* pool_alloc(NodePool* pool) {
+  if (pool->free_list != NULL) {
+    PairingNode* node = pool->free_list;
+    pool->free_list = node->sibling;
+    return node;
+  }
+
+  if (pool->chunk_used == POOL_CHUNK_SIZE) {
+    PoolChunk* chunk = (PoolChunk*) malloc(sizeof(PoolChunk));
+
+    if (chunk == NULL) {
+      DEBUG_PRINT("Error Allocating a new chunk for the node pool\n", NULL);
+      return NULL;
+    }
+
+    chunk->next = pool->chunks;
+    pool->chunks = chunk;
+    pool->chunk_used = 0;
+  }
+
+  PairingNode* node = &pool->chunks->nodes[pool->chunk_used];
+  pool->chunk_used += 1;
+
+  return node;
+}
+
+static void pool_release(NodePool* pool, PairingNode* node) {
+  node->sibling = pool->free_list;
+  pool->free_list = node;
+}
+
+/**
+ * =====================
+ * || Program methods ||
+ * =====================
+ */
+
+PairingHeap pairing_heap_initialize(NodePool* pool) {
+  PairingHeap heap = { .size = 0, .root = NULL, .pool = pool };
+
+  return heap;
+}
+
+/**
+ * Hand every node back to the pool - Walks the tree with the sibling list so there's no recursion
+ *
+ * @param: heap -> The heap to empty
+ */
+
+void pairing_heap_free(PairingHeap* heap) {
+  if (heap == NULL) return;
+
+  PairingNode* stack = heap->root;
+
+  // Treat the children of each popped node as more siblings to visit
+  while (stack != NULL) {
+    PairingNode* node = stack;
+    stack = node->sibling;
+
+    if (node->child != NULL) {
+      PairingNode* last = node->child;
+      while (last->sibling != NULL) last = last->sibling;
+      last->sibling = stack;
+      stack = node->child;
+    }
+
+    pool_release(heap->pool, node);
+  }
+
+  heap->root = NULL;
+  heap->size = 0;
+}
+
+/**
+ * Link two trees - The larger root becomes the left most child of the smaller one O(1)
+ *
+ * @param: a -> The root of the first tree
+ * @param: b -> The root of the second tree
+ * @returns: The root of the linked tree
+ */
+
+static PairingNode* link(PairingNode* a, PairingNode* b) {
+  if (a == NULL) return b;
+  if (b == NULL) return a;
+
+  if (b->data < a->data) {
+    PairingNode* temp = a;
+    a = b;
+    b = temp;
+  }
+
+  b->prev = a;
+  b->sibling = a->child;
+  if (a->child != NULL) a->child->prev = b;
+  a->child = b;
+
+  a->sibling = NULL;
+  a->prev = NULL;
+
+  return a;
+}
+
+/**
+ * Insert a value O(1)
+ *
+ * @param: heap -> The heap to insert into
+ * @param: data -> The value to insert
+ * @returns: The node, which stays valid as a handle for decrease_key until it is extracted, or NULL if the pool is out of memory
+ */
+
+PairingNode* pairing_heap_insert(PairingHeap* heap, uint16_t data) {
+  if (heap == NULL) return NULL;
+
+  PairingNode* node = pool_alloc(heap->pool);
+
+  if (node == NULL) return NULL;
+
+  node->data = data;
+  node->child = NULL;
+  node->sibling = NULL;
+  node->prev = NULL;
+
+  heap->root = link(heap->root, node);
+  heap->size += 1;
+
+  return node;
+}
+
+int32_t peek_min(PairingHeap* heap) {
+  if (heap == NULL || heap->root == NULL) return -1;
+
+  return heap->root->data;
+}
+
+/**
+ * Meld two heaps O(1) - Link the roots, from is left empty
+ *
+ * @param: into -> The heap that ends up with every node
+ * @param: from -> The heap to empty into it, must use the same pool
+ * @returns: false if the heaps use different pools
+ */
+
+bool meld(PairingHeap* into, PairingHeap* from) {
+  if (into == NULL || from == NULL) return false;
+
+  if (into->pool != from->pool) {
+    DEBUG_PRINT("Error: Only heaps that share a pool can be melded\n", NULL);
+    return false;
+  }
+
+  into->root = link(into->root, from->root);
+  into->size += from->size;
+
+  from->root = NULL;
+  from->size = 0;
+
+  return true;
+}
+
+/**
+ * Combine a list of siblings into one tree with the two pass pairing
+ * First pass links them in pairs left to right, second pass links the pairs right to left
+ * The first pass reverses the pairs onto a list through prev so the second pass can walk back without recursion
+ *
+ * @param: first -> The left most sibling
+ * @returns: The root of the combined tree
+ */
+
+static PairingNode* merge_pairs(PairingNode* first) {
+  PairingNode* pairs = NULL;
+
+  while (first != NULL) {
+    PairingNode* a = first;
+    PairingNode* b = a->sibling;
+
+    first = b != NULL ? b->sibling : NULL;
+
+    a->sibling = NULL;
+    if (b != NULL) b->sibling = NULL;
+
+    PairingNode* pair = link(a, b);
+    pair->prev = pairs;
+    pairs = pair;
+  }
+
+  PairingNode* root = NULL;
+
+  while (pairs != NULL) {
+    PairingNode* next = pairs->prev;
+    root = link(pairs, root);
+    pairs = next;
+  }
+
+  return root;
+}
+
+/**
+ * Extract the min value O(log n) amortised
+ *
+ * @param: heap -> The heap to extract from
+ * @returns: The min value or -1 if the heap is empty
+ */
+
+int32_t extract_min(PairingHeap* heap) {
+  if (heap == NULL || heap->root == NULL) {
+    DEBUG_PRINT("Trying to extract from the heap when there are no nodes\n", NULL);
+    return -1;
+  }
+
+  PairingNode* root = heap->root;
+  uint16_t data = root->data;
+
+  heap->root = merge_pairs(root->child);
+  heap->size -= 1;
+
+  pool_release(heap->pool, root);
+
+  return data;
+}
+
+/**
+ * Lower the value of a node - Cut it (and its subtree) out and link it with the root O(log n) amortised
+ *
+ * @param: heap -> The heap the node is in
+ * @param: node -> The handle returned by pairing_heap_insert(...)
+ * @param: data -> The new value
+ * @returns: false if the new value is larger than the old one
+ */
+
+bool decrease_key(PairingHeap* heap, PairingNode* node, uint16_t data) {
+  if (heap == NULL || node == NULL || data > node->data) return false;
+
+  node->data = data;
+
+  if (node == heap->root) return true;
+
+  // prev is the parent when the node is the left most child, otherwise the left sibling
+  if (node->prev->child == node) {
+    node->prev->child = node->sibling;
+  } else {
+    node->prev->sibling = node->sibling;
+  }
+
+  if (node->sibling != NULL) node->sibling->prev = node->prev;
+
+  node->sibling = NULL;
+  node->prev = NULL;
+
+  heap->root = link(heap->root, node);
+
+  return true;
+}
+
+/**
+ * ===========
+ * || Tests ||
+ * ===========
+ */
+
+void test_insert_extract(NodePool* pool) {
+  printf("==================\n");
+  printf("|| Extract Min  ||\n");
+  printf("==================\n\n");
+
+  PairingHeap heap = pairing_heap_initialize(pool);
+  uint16_t nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64 };
+
+  for (size_t i = 0; i < LENGTH(nums, uint16_t); i++) {
+    pairing_heap_insert(&heap, nums[i]);
+  }
+
+  printf("Min: %d\n", peek_min(&heap));
+
+  printf("Drained: ");
+  while (heap.size > 0) {
+    printf("%d, ", extract_min(&heap));
+  }
+
+  printf("\n\n");
+}
+
+void test_decrease_key(NodePool* pool) {
+  printf("==================\n");
+  printf("|| Decrease Key ||\n");
+  printf("==================\n\n");
+
+  PairingHeap heap = pairing_heap_initialize(pool);
+  uint16_t nums[] = { 38, 384, 27, 46, 463, 47, 200, 40, 64 };
+  PairingNode* handles[LENGTH(nums, uint16_t)];
+
+  for (size_t i = 0; i < LENGTH(nums, uint16_t); i++) {
+    handles[i] = pairing_heap_insert(&heap, nums[i]);
+  }
+
+  // Extract once so the root has a proper tree of children to cut from
+  printf("Extracted: %d\n", extract_min(&heap));
+
+  printf("Decrease 463 -> 1\n");
+  decrease_key(&heap, handles[4], 1);
+  printf("Decrease 200 -> 39\n");
+  decrease_key(&heap, handles[6], 39);
+  printf("Increase rejected: %s\n", decrease_key(&heap, handles[0], 1000) ? "false" : "true");
+
+  printf("Drained: ");
+  while (heap.size > 0) {
+    printf("%d, ", extract_min(&heap));
+  }
+
+  printf("\n\n");
+}
+
+void test_meld(NodePool* pool) {
+  printf("==================\n");
+  printf("|| Meld         ||\n");
+  printf("==================\n\n");
+
+  PairingHeap a = pairing_heap_initialize(pool);
+  PairingHeap b = pairing_heap_initialize(pool);
+  uint16_t evens[] = { 2, 40, 8, 16, 100 };
+  uint16_t odds[] = { 33, 1, 7, 99, 5 };
+
+  for (size_t i = 0; i < LENGTH(evens, uint16_t); i++) pairing_heap_insert(&a, evens[i]);
+  for (size_t i = 0; i < LENGTH(odds, uint16_t); i++) pairing_heap_insert(&b, odds[i]);
+
+  meld(&a, &b);
+
+  printf("Sizes after meld: %zu, %zu\n", a.size, b.size);
+
+  printf("Drained: ");
+  while (a.size > 0) {
+    printf("%d, ", extract_min(&a));
+  }
+
+  printf("\n\n");
+}
+
+// Random inserts and decrease_keys with the drain checked against the IndexedMinHeap
+// The keys start distinct so the one early extract takes the same node out of both heaps and every handle left is still live
+
+void test_matches_min_heap(NodePool* pool) {
+  printf("==================\n");
+  printf("|| Vs Min Heap  ||\n");
+  printf("==================\n\n");
+
+  PairingHeap heap = pairing_heap_initialize(pool);
+  IndexedMinHeap reference = indexed_min_heap_initialize();
+  size_t n = 10000;
+  PairingNode** nodes = (PairingNode**) malloc(sizeof(PairingNode*) * n);
+  size_t* handles = (size_t*) malloc(sizeof(size_t) * n);
+  uint32_t seed = 12345;
+  bool same = true;
+
+  if (nodes == NULL || handles == NULL) return;
+
+  for (size_t i = 0; i < n; i++) {
+    uint16_t key = (uint16_t) ((i * 7919) % 65536);
+    nodes[i] = pairing_heap_insert(&heap, key);
+    handles[i] = indexed_min_heap_insert(&reference, key);
+  }
+
+  // Extract once so decrease_key works on a tree that has been paired up
+  uint16_t first = 0;
+  indexed_min_heap_extract(&reference, &first);
+  if (extract_min(&heap) != first) same = false;
+
+  for (size_t i = 0; i < n / 2; i++) {
+    seed = seed * 1103515245 + 12345;
+    size_t j = (seed >> 8) % n;
+
+    if (!indexed_min_heap_contains(&reference, handles[j])) continue;
+
+    uint16_t key = reference.heap[reference.positions[handles[j]]].data / 2;
+    decrease_key(&heap, nodes[j], key);
+    indexed_min_heap_promote(&reference, handles[j], key);
+  }
+
+  while (reference.size > 0) {
+    uint16_t expected = 0;
+    indexed_min_heap_extract(&reference, &expected);
+    if (extract_min(&heap) != expected) same = false;
+  }
+
+  printf("Same order as the min heap: %s\n\n", same ? "true" : "false");
+
+  free(nodes);
+  free(handles);
+  indexed_min_heap_free(&reference);
+}
+
+void run_tests() {
+  NodePool pool = pool_initialize();
+
+  test_insert_extract(&pool);
+
+  test_decrease_key(&pool);
+
+  test_meld(&pool);
+
+  test_matches_min_heap(&pool);
+
+  pool_free(&pool);
+
+}
+
+/**
+ * ================
+ * || Benchmarks ||
+ * ================
+ */
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+void bench_push_pop() {
+  printf("==================\n");
+  printf("|| Push/ Pop    ||\n");
+  printf("==================\n\n");
+
+  NodePool pool = pool_initialize();
+  PairingHeap heap = pairing_heap_initialize(&pool);
+  struct timespec start, end;
+  uint32_t seed = 12345;
+  uint64_t checksum = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (size_t i = 0; i < BENCHMARK_SIZE; i++) {
+    seed = seed * 1103515245 + 12345;
+    pairing_heap_insert(&heap, (uint16_t) (seed >> 16));
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double push_time = elapsed_seconds(start, end);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while (heap.size > 0) {
+    checksum += extract_min(&heap);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double pop_time = elapsed_seconds(start, end);
+
+  printf("%d pushes: %.2f Mops/s\n", BENCHMARK_SIZE, BENCHMARK_SIZE / push_time / 1e6);
+  printf("%d pops:   %.2f Mops/s\n", BENCHMARK_SIZE, BENCHMARK_SIZE / pop_time / 1e6);
+  printf("Heap memory: %zu bytes per node (checksum %lu)\n\n", sizeof(PairingNode), (unsigned long) checksum);
+
+  pool_free(&pool);
+}
+
+// Merge QUEUES worker queues of QUEUE_SIZE values into one - meld() vs draining each MinHeap into the first
+
+void bench_meld() {
+  printf("==================\n");
+  printf("|| Meld         ||\n");
+  printf("==================\n\n");
+
+  size_t queues = 1000;
+  size_t queue_size = BENCHMARK_SIZE / queues;
+  NodePool pool = pool_initialize();
+  PairingHeap* pairing = (PairingHeap*) malloc(sizeof(PairingHeap) * queues);
+  MinHeap* heaps = (MinHeap*) malloc(sizeof(MinHeap) * queues);
+  struct timespec start, end;
+  uint32_t seed = 12345;
+
+  if (pairing == NULL || heaps == NULL) return;
+
+  for (size_t q = 0; q < queues; q++) {
+    pairing[q] = pairing_heap_initialize(&pool);
+    heaps[q] = min_heap_initialize();
+
+    for (size_t i = 0; i < queue_size; i++) {
+      seed = seed * 1103515245 + 12345;
+      pairing_heap_insert(&pairing[q], (uint16_t) (seed >> 16));
+      min_heap_insert(&heaps[q], (uint16_t) (seed >> 16));
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (size_t q = 1; q < queues; q++) {
+    meld(&pairing[0], &pairing[q]);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double meld_time = elapsed_seconds(start, end);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (size_t q = 1; q < queues; q++) {
+    uint16_t data;
+
+    while (heaps[q].size > 0) {
+      min_heap_extract(&heaps[q], &data);
+      min_heap_insert(&heaps[0], data);
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double drain_time = elapsed_seconds(start, end);
+
+  printf("Merging %zu queues of %zu values\n", queues, queue_size);
+  printf("Pairing heap meld:      %.3f ms\n", meld_time * 1e3);
+  printf("Min heap drain/ insert: %.3f ms\n", drain_time * 1e3);
+  printf("Same min: %s\n\n", peek_min(&pairing[0]) == min_heap_peek(&heaps[0])->data ? "true" : "false");
+
+  for (size_t q = 0; q < queues; q++) min_heap_free(&heaps[q]);
+
+  free(pairing);
+  free(heaps);
+  pool_free(&pool);
+}
+
+void run_benchmarks() {
+  bench_push_pop();
+  bench_meld();
+}
+
+int main() {
+  run_tests();
+
+  if (RUN_BENCHMARKS) run_benchmarks();
+
+  return 0;
+}
@@ -4,12 +4,19 @@
 #include <ctype.h>
 #include <string.h>
 
+#include "../../heaps/heap.h"
+
 // There are a fair few errors in this data structure regarding insert at idx and unshift - I will come back and edit this 
 // I believe I have confused myself by separating the ui methods and the utility methods which has elongated the code file unecessarily
 
 #define INITIAL_CAPACITY 5 
 #define LOAD_FACTOR_THRESHOLD 0.7
 #define GROWTH_FACTOR 0.5 
+#define INT_HIGHER(a, b) ((a) > (b))
+
+// int_list_heapsort(...) sorts the backing array in place, without allocating a heap 
+
+DEFINE_HEAP_SORT(int_list, int, INT_HIGHER)
 
 typedef struct {
   int* array; 
@@ -32,6 +39,7 @@ void loadFactor(ArrayList* arrayList);
 void isEmpty(ArrayList* arrayList); 
 void trimToSize(ArrayList* arrayList); 
 void reverse(ArrayList* arrayList); 
+void sort(ArrayList* arrayList); 
 void contains(ArrayList* arrayList); 
 void uiIsEmpty(ArrayList* arrayList); 
 void uiSublist(ArrayList* arrayList); 
@@ -129,6 +137,9 @@ void programLoop() {
       case 13 : 
         reverse(&arrayList);
         break; 
+      case 14 : 
+        sort(&arrayList);
+        break; 
       case 0 : 
         free(arrayList.array); 
         printf("Exiting the program...\n"); 
@@ -162,6 +173,7 @@ void printMenu() {
   printf("[11] Show if the array is empty\n"); 
   printf("[12] Show the index of an item\n"); 
   printf("[13] Reverse the array\n"); 
+  printf("[14] Sort the array\n"); 
   printf("[0] Exit the program\n\n"); 
 }
 
@@ -462,6 +474,23 @@ ArrayList clear(ArrayList arrayList) {
   return initializeArrayList();
 }
 
+// Sort the Array -> Ascending, in place, using the heapsort generated from heaps/heap.h
+
+void sort(ArrayList* arrayList) {
+  if(getIsEmpty(arrayList)) {
+    printf("Your array is currently empty\n\n"); 
+    return;
+  }
+
+  printf("Before:\n"); 
+  uiShow(arrayList);
+
+  int_list_heapsort(arrayList->array, arrayList->size); 
+
+  printf("After:\n"); 
+  uiShow(arrayList);
+}
+
 // Reverse the Array -> This reverals persists and is not a temporary clone
 
 void reverse(ArrayList* arrayList) {
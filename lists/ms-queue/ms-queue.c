@@ -0,0 +1,432 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DEBUG true
+#define RUN_BENCHMARKS true
+#define BENCHMARK_SIZE 1000000
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, ...) fprintf(stderr, fmt, __VA_ARGS__)
+#else
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+//  NOTE: The queue itself is in ms-queue.h, this file tests it and benchmarks it against the linked list behind a mutex
+//  NOTE: Build with gcc -O2 -pthread ms-queue.c
+
+#include "ms-queue.h"
+
+#define MAX_THREADS 64
+#define ROUND_SIZE 1000
+
+// Spin a little then give the core up - with fewer cores than threads the other side can't run until we do
+
+static inline void wait_for_other_side(int* spins) {
+  if (++*spins < 64) return;
+
+  *spins = 0;
+  sched_yield();
+}
+
+// How many nodes the queue has malloc'd so far (not counting the first dummy)
+
+size_t allocated_nodes(MsQueue* queue) {
+  size_t nodes = 0;
+
+  for (MsThread* thread = atomic_load(&queue->threads); thread != NULL; thread = thread->next_thread) {
+    for (MsChunk* chunk = thread->chunks; chunk != NULL; chunk = chunk->next) nodes += MS_QUEUE_POOL_BATCH;
+  }
+
+  return nodes;
+}
+
+/**
+ * ===================================
+ * ||             Tests             ||
+ * ===================================
+ */
+
+void test_single_thread() {
+  printf("==================\n");
+  printf("|| One Thread   ||\n");
+  printf("==================\n\n");
+
+  MsQueue queue;
+  if (!ms_queue_initialize(&queue)) return;
+
+  MsThread* thread = ms_queue_register(&queue);
+  if (thread == NULL) return;
+
+  int out;
+  bool matched = true;
+  int count = 10 * MS_QUEUE_POOL_BATCH;
+
+  printf("New queue is empty: %s\n", ms_queue_is_empty(&queue, thread) ? "true" : "false");
+
+  for (int i = 0; i < count; i++) ms_queue_enqueue(&queue, thread, i);
+  for (int i = 0; i < count; i++) {
+    if (!ms_queue_dequeue(&queue, thread, &out) || out != i) matched = false;
+  }
+
+  printf("%d items came out in FIFO order: %s\n", count, matched ? "true" : "false");
+  printf("Dequeue from empty fails: %s\n", ms_queue_dequeue(&queue, thread, &out) ? "false" : "true");
+
+  // One in one out - every node should come back round through limbo, so this shouldn't need any more chunks
+  size_t before = allocated_nodes(&queue);
+  matched = true;
+
+  for (int i = 0; i < BENCHMARK_SIZE; i++) {
+    ms_queue_enqueue(&queue, thread, i);
+    if (!ms_queue_dequeue(&queue, thread, &out) || out != i) matched = false;
+  }
+
+  printf("%d enqueue + dequeue pairs matched: %s, nodes malloc'd during them: %zu\n\n", BENCHMARK_SIZE,
+         matched ? "true" : "false", allocated_nodes(&queue) - before);
+
+  ms_queue_free(&queue);
+}
+
+typedef struct {
+  MsQueue* queue;
+  int id;
+  int producers;
+  int count;
+  _Atomic int* seen;
+  _Atomic int* remaining;
+  bool in_order;
+} TestContext;
+
+void* test_producer(void* arg) {
+  TestContext* context = (TestContext*) arg;
+  MsThread* thread = ms_queue_register(context->queue);
+
+  if (thread == NULL) return NULL;
+
+  for (int i = 0; i < context->count; i++) ms_queue_enqueue(context->queue, thread, context->id * context->count + i);
+
+  return NULL;
+}
+
+// Values from one producer have to come out in the order it put them in, whichever consumer gets them
+
+void* test_consumer(void* arg) {
+  TestContext* context = (TestContext*) arg;
+  MsThread* thread = ms_queue_register(context->queue);
+  int last[MAX_THREADS];
+  int spins = 0;
+  int out;
+
+  if (thread == NULL) return NULL;
+
+  for (int i = 0; i < context->producers; i++) last[i] = -1;
+  context->in_order = true;
+
+  while (atomic_load(context->remaining) > 0) {
+    if (!ms_queue_dequeue(context->queue, thread, &out)) {
+      wait_for_other_side(&spins);
+      continue;
+    }
+
+    int producer = out / context->count;
+    int sequence = out % context->count;
+
+    if (sequence <= last[producer]) context->in_order = false;
+    last[producer] = sequence;
+
+    atomic_fetch_add(&context->seen[out], 1);
+    atomic_fetch_sub(context->remaining, 1);
+  }
+
+  return NULL;
+}
+
+// 4 producers and 4 consumers, every value should come out exactly once and each producer's values in order
+
+void test_concurrent() {
+  printf("==================\n");
+  printf("|| Concurrent   ||\n");
+  printf("==================\n\n");
+
+  int pairs = 4;
+  int count = 100000;
+  MsQueue queue;
+  pthread_t threads[8];
+  TestContext contexts[8];
+  _Atomic int* seen = (_Atomic int*) calloc((size_t) pairs * count, sizeof(_Atomic int));
+  _Atomic int remaining = pairs * count;
+  bool exactly_once = true;
+  bool in_order = true;
+
+  if (seen == NULL || !ms_queue_initialize(&queue)) return;
+
+  for (int i = 0; i < pairs; i++) {
+    contexts[i] = (TestContext) { &queue, i, pairs, count, seen, &remaining, true };
+    contexts[pairs + i] = (TestContext) { &queue, i, pairs, count, seen, &remaining, true };
+    pthread_create(&threads[i], NULL, test_producer, &contexts[i]);
+    pthread_create(&threads[pairs + i], NULL, test_consumer, &contexts[pairs + i]);
+  }
+
+  for (int i = 0; i < 2 * pairs; i++) pthread_join(threads[i], NULL);
+
+  for (int i = 0; i < pairs * count; i++) {
+    if (atomic_load(&seen[i]) != 1) exactly_once = false;
+  }
+  for (int i = 0; i < pairs; i++) {
+    if (!contexts[pairs + i].in_order) in_order = false;
+  }
+
+  printf("4 producers, 4 consumers, every value exactly once: %s\n", exactly_once ? "true" : "false");
+  printf("Each producer's values came out in order: %s\n\n", in_order ? "true" : "false");
+
+  free(seen);
+  ms_queue_free(&queue);
+}
+
+typedef struct {
+  MsQueue* queue;
+  int rounds;
+  _Atomic int round;
+} RoundContext;
+
+void* round_producer(void* arg) {
+  RoundContext* context = (RoundContext*) arg;
+  MsThread* thread = ms_queue_register(context->queue);
+  int spins = 0;
+
+  if (thread == NULL) return NULL;
+
+  for (int round = 0; round < context->rounds; round++) {
+    while (atomic_load(&context->round) < round) wait_for_other_side(&spins);
+
+    for (int i = 0; i < ROUND_SIZE; i++) ms_queue_enqueue(context->queue, thread, i);
+  }
+
+  return NULL;
+}
+
+void* round_consumer(void* arg) {
+  RoundContext* context = (RoundContext*) arg;
+  MsThread* thread = ms_queue_register(context->queue);
+  int spins = 0;
+  int out;
+
+  if (thread == NULL) return NULL;
+
+  for (int round = 0; round < context->rounds; round++) {
+    for (int i = 0; i < ROUND_SIZE;) {
+      if (ms_queue_dequeue(context->queue, thread, &out)) {
+        i++;
+      } else {
+        wait_for_other_side(&spins);
+      }
+    }
+
+    atomic_store(&context->round, round + 1);
+  }
+
+  return NULL;
+}
+
+// One thread only enqueues, the other only dequeues, ROUND_SIZE items at a time. The nodes pile up on the consumer's
+// side and have to get back to the producer through the spare slots, otherwise the producer mallocs for every item
+
+void test_recycling() {
+  printf("==================\n");
+  printf("|| Recycling    ||\n");
+  printf("==================\n\n");
+
+  MsQueue queue;
+  RoundContext context = { &queue, BENCHMARK_SIZE / ROUND_SIZE, 0 };
+  pthread_t threads[2];
+
+  if (!ms_queue_initialize(&queue)) return;
+
+  pthread_create(&threads[0], NULL, round_consumer, &context);
+  pthread_create(&threads[1], NULL, round_producer, &context);
+  pthread_join(threads[0], NULL);
+  pthread_join(threads[1], NULL);
+
+  printf("Passed %d items %d at a time, nodes malloc'd: %zu\n\n", BENCHMARK_SIZE, ROUND_SIZE, allocated_nodes(&queue));
+
+  ms_queue_free(&queue);
+}
+
+void run_tests() {
+  test_single_thread();
+
+  test_concurrent();
+
+  test_recycling();
+
+}
+
+/**
+ * ===================================
+ * ||           Benchmarks          ||
+ * ===================================
+ */
+
+double elapsed_seconds(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// What the linked list gives you as a queue - insert at the tail, remove at the head, malloc/ free per node, one mutex
+
+typedef struct {
+  void* next;
+  int data;
+} Node;
+
+typedef struct {
+  pthread_mutex_t lock;
+  Node* head;
+  Node* tail;
+} MutexList;
+
+bool mutex_list_enqueue(MutexList* list, int data) {
+  Node* node = (Node*) malloc(sizeof(Node));
+  if (node == NULL) return false;
+
+  node->next = NULL;
+  node->data = data;
+
+  pthread_mutex_lock(&list->lock);
+  if (list->tail == NULL) {
+    list->head = node;
+  } else {
+    list->tail->next = node;
+  }
+  list->tail = node;
+  pthread_mutex_unlock(&list->lock);
+
+  return true;
+}
+
+bool mutex_list_dequeue(MutexList* list, int* out) {
+  pthread_mutex_lock(&list->lock);
+  Node* node = list->head;
+
+  if (node == NULL) {
+    pthread_mutex_unlock(&list->lock);
+    return false;
+  }
+
+  list->head = (Node*) node->next;
+  if (list->head == NULL) list->tail = NULL;
+  pthread_mutex_unlock(&list->lock);
+
+  *out = node->data;
+  free(node);
+
+  return true;
+}
+
+typedef struct {
+  MsQueue* ms;
+  MutexList* mutex;
+  int count;
+  bool producer;
+} BenchContext;
+
+void* bench_ms_worker(void* arg) {
+  BenchContext* context = (BenchContext*) arg;
+  MsThread* thread = ms_queue_register(context->ms);
+  int spins = 0;
+  int out;
+
+  if (thread == NULL) return NULL;
+
+  for (int i = 0; i < context->count;) {
+    bool done = context->producer ? ms_queue_enqueue(context->ms, thread, i) : ms_queue_dequeue(context->ms, thread, &out);
+
+    if (done) {
+      i++;
+    } else {
+      wait_for_other_side(&spins);
+    }
+  }
+
+  return NULL;
+}
+
+void* bench_mutex_worker(void* arg) {
+  BenchContext* context = (BenchContext*) arg;
+  int spins = 0;
+  int out;
+
+  for (int i = 0; i < context->count;) {
+    bool done = context->producer ? mutex_list_enqueue(context->mutex, i) : mutex_list_dequeue(context->mutex, &out);
+
+    if (done) {
+      i++;
+    } else {
+      wait_for_other_side(&spins);
+    }
+  }
+
+  return NULL;
+}
+
+// Half the threads produce and half consume, BENCHMARK_SIZE items in total. Returns millions of items a second
+
+double bench_run(void* (*worker)(void*), MsQueue* ms, MutexList* mutex, int thread_count) {
+  pthread_t threads[MAX_THREADS];
+  BenchContext contexts[MAX_THREADS];
+  int pairs = thread_count / 2;
+  struct timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < thread_count; i++) {
+    contexts[i] = (BenchContext) { ms, mutex, BENCHMARK_SIZE / pairs, i < pairs };
+    pthread_create(&threads[i], NULL, worker, &contexts[i]);
+  }
+  for (int i = 0; i < thread_count; i++) pthread_join(threads[i], NULL);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  return (double) (BENCHMARK_SIZE / pairs) * pairs / elapsed_seconds(start, end) / 1e6;
+}
+
+void bench_scaling() {
+  printf("==================\n");
+  printf("|| Scaling      ||\n");
+  printf("==================\n\n");
+
+  printf("Threads   MS Queue (M items/s)   Mutex List (M items/s)\n");
+
+  for (int thread_count = 2; thread_count <= MAX_THREADS; thread_count *= 2) {
+    MsQueue ms;
+    MutexList mutex = { .head = NULL, .tail = NULL };
+
+    if (!ms_queue_initialize(&ms)) return;
+    pthread_mutex_init(&mutex.lock, NULL);
+
+    double ms_rate = bench_run(bench_ms_worker, &ms, &mutex, thread_count);
+    double mutex_rate = bench_run(bench_mutex_worker, &ms, &mutex, thread_count);
+
+    printf("%-9d %-22.2f %.2f\n", thread_count, ms_rate, mutex_rate);
+
+    ms_queue_free(&ms);
+    pthread_mutex_destroy(&mutex.lock);
+  }
+
+  printf("\n");
+}
+
+void run_benchmarks() {
+  bench_scaling();
+}
+
+int main() {
+  run_tests();
+
+  if (RUN_BENCHMARKS) run_benchmarks();
+
+  return 0;
+}
@@ -0,0 +1,465 @@
+/**
+ * *-------------------------------------*
+ * * Lock Free Linked Queue (ms-queue.h) *
+ * *-------------------------------------*
+ *
+ * The Michael-Scott queue - the linked list from lists/linked-list used as a FIFO that any number of threads can
+ * enqueue to and dequeue from without a lock. The nodes have the linked list's layout (next, then data), only next is
+ * atomic. The list always starts with a dummy node, so head and tail are never NULL and an enqueue and a dequeue only
+ * meet when the queue is empty:
+ *
+ * - Enqueue -> CAS the new node onto tail->next, then CAS tail forward to it. If tail->next is already set another
+ *              enqueue is half way through, so we swing tail forward for it and try again
+ * - Dequeue -> Read the value out of head->next and CAS head forward to it. The old dummy is dropped and head->next
+ *              becomes the new dummy
+ *
+ * A dequeue can still be reading a node another thread has just dequeued, so nodes are reclaimed by epoch:
+ *
+ * - Every operation runs inside ms_queue_enter(...)/ms_queue_exit(...), which announce the global epoch the thread saw
+ * - A dequeued node is retired into its thread's limbo list for the global epoch at the time
+ * - The global epoch only moves on from e once every thread inside an operation has announced e, so by the time it
+ *   reaches e + 2 nobody can still hold a node retired in e and the limbo list goes back to the thread's free list
+ *
+ * Unlike the Treiber stack's hazard pointers there's nothing to publish per node, and as nodes are never reused while
+ * someone could be looking at them there's no ABA problem and no tag on head/tail.
+ *
+ * Every thread that uses a queue calls ms_queue_register(...) once and passes the handle it gets back to enqueue/dequeue.
+ * The handle holds that thread's announced epoch, its limbo lists and its free list:
+ *
+ * - Enqueue takes a node from the thread's own free list, so the common case never touches shared memory
+ * - A thread that only dequeues ends up with all the nodes. Past 2 * MS_QUEUE_POOL_BATCH it parks a batch in one of
+ *   the queue's spare slots, and a thread that runs dry takes a batch from a spare slot before it mallocs a new chunk.
+ *   A slot is only ever filled with a CAS from NULL and emptied with an exchange, so neither side needs a lock
+ *
+ * Nodes are only given back to the OS by ms_queue_free(...), once no thread is using the queue.
+ *
+ * Compile with -pthread (sched_yield).
+ */
+
+#ifndef MS_QUEUE_H
+#define MS_QUEUE_H
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef MS_QUEUE_POOL_BATCH
+#define MS_QUEUE_POOL_BATCH 256
+#endif
+
+// Batches of free nodes that can be waiting to move from dequeuing threads to enqueuing ones
+#ifndef MS_QUEUE_SPARE_SLOTS
+#define MS_QUEUE_SPARE_SLOTS 8
+#endif
+
+// Try to move the global epoch on every time a thread has retired this many nodes
+#ifndef MS_QUEUE_EPOCH_INTERVAL
+#define MS_QUEUE_EPOCH_INTERVAL 64
+#endif
+
+// Limbo lists per thread - nodes retired in epoch e wait in limbo[e % 3] until the global epoch reaches e + 2
+#define MS_QUEUE_EPOCHS 3
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+#ifndef DEBUG_PRINT
+#define DEBUG_PRINT(fmt, ...)
+#endif
+
+typedef struct MsNode {
+  _Atomic(struct MsNode*) next;
+  int data;
+} MsNode;
+
+typedef struct MsChunk {
+  struct MsChunk* next;
+  MsNode nodes[MS_QUEUE_POOL_BATCH];
+} MsChunk;
+
+/**
+ * One per thread per queue. Only the owning thread writes to it, other threads only read epoch/ active while trying
+ * to move the global epoch on.
+ *
+ * - epoch -> The global epoch this thread saw when it last entered an operation
+ * - active -> Whether the thread is inside an operation right now
+ * - limbo -> Dequeued nodes waiting for the global epoch to move two past limbo_epoch (linked through next)
+ * - free_list -> Nodes for this thread's enqueues (linked through next)
+ * - chunks -> Every chunk this thread malloc'd, freed along with the queue
+ */
+
+typedef struct MsThread {
+  _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t epoch;
+  _Atomic bool active;
+  MsNode* limbo[MS_QUEUE_EPOCHS];
+  MsNode* limbo_tail[MS_QUEUE_EPOCHS];
+  size_t limbo_count[MS_QUEUE_EPOCHS];
+  uint64_t limbo_epoch[MS_QUEUE_EPOCHS];
+  size_t retired_since_advance;
+  MsNode* free_list;
+  size_t free_count;
+  MsChunk* chunks;
+  struct MsThread* next_thread;
+} MsThread;
+
+typedef struct {
+  _Alignas(CACHE_LINE_SIZE) _Atomic(MsNode*) head;
+  _Alignas(CACHE_LINE_SIZE) _Atomic(MsNode*) tail;
+  _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t epoch;
+  _Atomic(MsThread*) threads;
+  _Alignas(CACHE_LINE_SIZE) _Atomic(MsNode*) spare[MS_QUEUE_SPARE_SLOTS];
+  MsNode* first_dummy;
+} MsQueue;
+
+static inline bool ms_queue_initialize(MsQueue* queue) {
+  MsNode* dummy = (MsNode*) malloc(sizeof(MsNode));
+
+  if (dummy == NULL) {
+    DEBUG_PRINT("Error Allocating memory for the queue\n\n", NULL);
+    return false;
+  }
+
+  atomic_init(&dummy->next, NULL);
+  dummy->data = 0;
+
+  atomic_init(&queue->head, dummy);
+  atomic_init(&queue->tail, dummy);
+  atomic_init(&queue->epoch, 0);
+  atomic_init(&queue->threads, NULL);
+  for (int i = 0; i < MS_QUEUE_SPARE_SLOTS; i++) atomic_init(&queue->spare[i], NULL);
+
+  // The first dummy isn't part of any chunk, it gets dequeued and reused like any other node but is freed on its own
+  queue->first_dummy = dummy;
+
+  return true;
+}
+
+/**
+ * Frees every node, chunk and thread handle. No thread can be using the queue (or its handles) any more
+ *
+ * @param: queue -> The queue to free
+ */
+
+static inline void ms_queue_free(MsQueue* queue) {
+  MsThread* thread = atomic_load(&queue->threads);
+
+  while (thread != NULL) {
+    MsThread* next_thread = thread->next_thread;
+    MsChunk* chunk = thread->chunks;
+
+    while (chunk != NULL) {
+      MsChunk* next = chunk->next;
+      free(chunk);
+      chunk = next;
+    }
+
+    free(thread);
+    thread = next_thread;
+  }
+
+  free(queue->first_dummy);
+
+  atomic_store(&queue->head, NULL);
+  atomic_store(&queue->tail, NULL);
+  atomic_store(&queue->threads, NULL);
+  for (int i = 0; i < MS_QUEUE_SPARE_SLOTS; i++) atomic_store(&queue->spare[i], NULL);
+  queue->first_dummy = NULL;
+}
+
+/**
+ * Gives the calling thread its handle for this queue. Call once per thread, the handle lives until ms_queue_free(...)
+ *
+ * @param: queue -> The queue the thread is going to use
+ */
+
+static inline MsThread* ms_queue_register(MsQueue* queue) {
+  MsThread* thread = (MsThread*) aligned_alloc(CACHE_LINE_SIZE, sizeof(MsThread));
+
+  if (thread == NULL) {
+    DEBUG_PRINT("Error Allocating memory for a thread handle\n\n", NULL);
+    return NULL;
+  }
+
+  atomic_init(&thread->epoch, 0);
+  atomic_init(&thread->active, false);
+  for (int i = 0; i < MS_QUEUE_EPOCHS; i++) {
+    thread->limbo[i] = NULL;
+    thread->limbo_tail[i] = NULL;
+    thread->limbo_count[i] = 0;
+    thread->limbo_epoch[i] = 0;
+  }
+  thread->retired_since_advance = 0;
+  thread->free_list = NULL;
+  thread->free_count = 0;
+  thread->chunks = NULL;
+
+  // The thread list only ever grows so a plain CAS push is safe here
+  MsThread* head = atomic_load(&queue->threads);
+  do {
+    thread->next_thread = head;
+  } while (!atomic_compare_exchange_weak(&queue->threads, &head, thread));
+
+  return thread;
+}
+
+// Move limbo[i] onto the front of the free list in one go
+
+static inline void ms_queue_release_limbo(MsThread* thread, int i) {
+  if (thread->limbo_count[i] == 0) return;
+
+  atomic_store_explicit(&thread->limbo_tail[i]->next, thread->free_list, memory_order_relaxed);
+  thread->free_list = thread->limbo[i];
+  thread->free_count += thread->limbo_count[i];
+
+  thread->limbo[i] = NULL;
+  thread->limbo_tail[i] = NULL;
+  thread->limbo_count[i] = 0;
+}
+
+/**
+ * Announces the global epoch before touching any node. Storing active and then epoch (both seq_cst) means a thread
+ * trying to move the epoch on either sees us as inactive - and we then read its new epoch - or sees what we announced.
+ * Also frees up any limbo list that's now two epochs old
+ *
+ * @param: queue -> The queue about to be used
+ * @param: thread -> The calling thread's handle
+ */
+
+static inline void ms_queue_enter(MsQueue* queue, MsThread* thread) {
+  atomic_store(&thread->active, true);
+
+  uint64_t epoch = atomic_load(&queue->epoch);
+  atomic_store(&thread->epoch, epoch);
+
+  for (int i = 0; i < MS_QUEUE_EPOCHS; i++) {
+    if (thread->limbo_count[i] > 0 && thread->limbo_epoch[i] + 2 <= epoch) ms_queue_release_limbo(thread, i);
+  }
+}
+
+static inline void ms_queue_exit(MsThread* thread) {
+  atomic_store_explicit(&thread->active, false, memory_order_release);
+}
+
+// Move the global epoch on if every thread inside an operation has already seen it
+
+static inline void ms_queue_try_advance(MsQueue* queue) {
+  uint64_t epoch = atomic_load(&queue->epoch);
+
+  for (MsThread* other = atomic_load(&queue->threads); other != NULL; other = other->next_thread) {
+    if (atomic_load(&other->active) && atomic_load(&other->epoch) != epoch) return;
+  }
+
+  atomic_compare_exchange_strong(&queue->epoch, &epoch, epoch + 1);
+}
+
+/**
+ * Puts a node nobody can reach from the queue any more into limbo. It's tagged with the global epoch read after it
+ * was unlinked, so only threads that entered before that epoch could still be holding it
+ *
+ * @param: queue -> The queue the node came out of
+ * @param: thread -> The calling thread's handle
+ * @param: node -> The unlinked node
+ */
+
+static inline void ms_queue_retire(MsQueue* queue, MsThread* thread, MsNode* node) {
+  uint64_t epoch = atomic_load(&queue->epoch);
+  int i = (int) (epoch % MS_QUEUE_EPOCHS);
+
+  // Whatever is left in this list was retired three or more epochs ago
+  if (thread->limbo_epoch[i] != epoch) {
+    ms_queue_release_limbo(thread, i);
+    thread->limbo_epoch[i] = epoch;
+  }
+
+  atomic_store_explicit(&node->next, thread->limbo[i], memory_order_relaxed);
+  if (thread->limbo[i] == NULL) thread->limbo_tail[i] = node;
+  thread->limbo[i] = node;
+  thread->limbo_count[i]++;
+
+  if (++thread->retired_since_advance >= MS_QUEUE_EPOCH_INTERVAL) {
+    thread->retired_since_advance = 0;
+    ms_queue_try_advance(queue);
+  }
+}
+
+// Refill an empty free list - a batch from a spare slot if there is one, otherwise a new chunk
+
+static inline bool ms_queue_refill(MsQueue* queue, MsThread* thread) {
+  for (int i = 0; i < MS_QUEUE_SPARE_SLOTS; i++) {
+    if (atomic_load_explicit(&queue->spare[i], memory_order_relaxed) == NULL) continue;
+
+    MsNode* batch = atomic_exchange_explicit(&queue->spare[i], NULL, memory_order_acquire);
+
+    if (batch != NULL) {
+      thread->free_list = batch;
+      thread->free_count = MS_QUEUE_POOL_BATCH;
+      return true;
+    }
+  }
+
+  MsChunk* chunk = (MsChunk*) malloc(sizeof(MsChunk));
+
+  if (chunk == NULL) {
+    DEBUG_PRINT("Error Allocating memory for a chunk of nodes\n\n", NULL);
+    return false;
+  }
+
+  for (int i = 0; i < MS_QUEUE_POOL_BATCH; i++) {
+    atomic_init(&chunk->nodes[i].next, i + 1 < MS_QUEUE_POOL_BATCH ? &chunk->nodes[i + 1] : NULL);
+  }
+
+  chunk->next = thread->chunks;
+  thread->chunks = chunk;
+  thread->free_list = &chunk->nodes[0];
+  thread->free_count = MS_QUEUE_POOL_BATCH;
+
+  return true;
+}
+
+// Park MS_QUEUE_POOL_BATCH nodes in an empty spare slot. If every slot is full the thread just keeps them
+
+static inline void ms_queue_spill(MsQueue* queue, MsThread* thread) {
+  for (int i = 0; i < MS_QUEUE_SPARE_SLOTS; i++) {
+    if (atomic_load_explicit(&queue->spare[i], memory_order_relaxed) != NULL) continue;
+
+    MsNode* batch = thread->free_list;
+    MsNode* last = batch;
+
+    for (int j = 1; j < MS_QUEUE_POOL_BATCH; j++) last = atomic_load_explicit(&last->next, memory_order_relaxed);
+
+    MsNode* rest = atomic_load_explicit(&last->next, memory_order_relaxed);
+    atomic_store_explicit(&last->next, NULL, memory_order_relaxed);
+
+    MsNode* empty = NULL;
+    if (atomic_compare_exchange_strong_explicit(&queue->spare[i], &empty, batch, memory_order_release, memory_order_relaxed)) {
+      thread->free_list = rest;
+      thread->free_count -= MS_QUEUE_POOL_BATCH;
+      return;
+    }
+
+    // Someone filled it first, put the batch back together and try the next slot
+    atomic_store_explicit(&last->next, rest, memory_order_relaxed);
+  }
+}
+
+static inline MsNode* ms_queue_allocate(MsQueue* queue, MsThread* thread) {
+  if (thread->free_list == NULL && !ms_queue_refill(queue, thread)) return NULL;
+
+  MsNode* node = thread->free_list;
+  thread->free_list = atomic_load_explicit(&node->next, memory_order_relaxed);
+  thread->free_count--;
+
+  return node;
+}
+
+/**
+ * Never blocks and never fails unless a new chunk of nodes can't be malloc'd
+ *
+ * @param: queue -> The queue to add to
+ * @param: thread -> The calling thread's handle
+ * @param: data -> The item to enqueue
+ */
+
+static inline bool ms_queue_enqueue(MsQueue* queue, MsThread* thread, int data) {
+  MsNode* node = ms_queue_allocate(queue, thread);
+
+  if (node == NULL) {
+    DEBUG_PRINT("Error: Cannot enqueue as no node could be allocated\n\n", NULL);
+    return false;
+  }
+
+  node->data = data;
+  atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+
+  ms_queue_enter(queue, thread);
+
+  MsNode* tail;
+
+  while (true) {
+    tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    MsNode* next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail != atomic_load_explicit(&queue->tail, memory_order_acquire)) continue;
+
+    if (next == NULL) {
+      // Linking the node is what makes it part of the queue, release so a dequeue that sees it sees its data
+      if (atomic_compare_exchange_weak_explicit(&tail->next, &next, node, memory_order_release, memory_order_relaxed)) break;
+    } else {
+      // Another enqueue linked its node but hasn't moved tail yet - do it for them
+      atomic_compare_exchange_weak_explicit(&queue->tail, &tail, next, memory_order_release, memory_order_relaxed);
+    }
+  }
+
+  // Fine if this fails, someone else has already moved tail past our node
+  atomic_compare_exchange_strong_explicit(&queue->tail, &tail, node, memory_order_release, memory_order_relaxed);
+
+  ms_queue_exit(thread);
+
+  return true;
+}
+
+/**
+ * Returns false if the queue is empty
+ *
+ * @param: queue -> The queue to take from
+ * @param: thread -> The calling thread's handle
+ * @param: out -> Where to put the item
+ */
+
+static inline bool ms_queue_dequeue(MsQueue* queue, MsThread* thread, int* out) {
+  ms_queue_enter(queue, thread);
+
+  MsNode* head;
+  int data;
+
+  while (true) {
+    head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    MsNode* tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    MsNode* next = atomic_load_explicit(&head->next, memory_order_acquire);
+
+    if (head != atomic_load_explicit(&queue->head, memory_order_acquire)) continue;
+
+    if (head == tail) {
+      if (next == NULL) {
+        ms_queue_exit(thread);
+        return false;
+      }
+
+      // tail is lagging behind a half finished enqueue
+      atomic_compare_exchange_weak_explicit(&queue->tail, &tail, next, memory_order_release, memory_order_relaxed);
+      continue;
+    }
+
+    // Read before the CAS - once head moves on, next is the dummy and another dequeue can retire it
+    data = next->data;
+
+    if (atomic_compare_exchange_weak_explicit(&queue->head, &head, next, memory_order_acq_rel, memory_order_relaxed)) break;
+  }
+
+  ms_queue_retire(queue, thread, head);
+  ms_queue_exit(thread);
+
+  if (thread->free_count >= 2 * MS_QUEUE_POOL_BATCH) ms_queue_spill(queue, thread);
+
+  *out = data;
+
+  return true;
+}
+
+// A snapshot - another thread can enqueue or dequeue straight after
+
+static inline bool ms_queue_is_empty(MsQueue* queue, MsThread* thread) {
+  ms_queue_enter(queue, thread);
+
+  MsNode* head = atomic_load_explicit(&queue->head, memory_order_acquire);
+  bool empty = atomic_load_explicit(&head->next, memory_order_acquire) == NULL;
+
+  ms_queue_exit(thread);
+
+  return empty;
+}
+
+#endif